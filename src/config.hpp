@@ -56,11 +56,26 @@ public:
 
   uint32_t global_rate_limit;
   uint32_t per_client_rate_limit;
+  // loop 线程数，0 表示 CPU 核数
+  uint32_t threads;
+  // 长连接：空闲超时与单个连接最多处理的请求数，0 表示不限
+  uint32_t keep_alive_timeout_sec;
+  uint32_t max_keep_alive_requests;
+  // 静态站点缓存：启动时将 dist 读入内存，超过大小上限的文件仍从磁盘发送；定期检查变化并重新加载，0 表示不检查
+  bool static_cache;
+  uint32_t static_cache_max_file_kb;
+  uint32_t static_cache_refresh_sec;
 };
 
 inline void ServerConf::parse(const toml::basic_value<toml::type_config>& raw_toml_) {
   global_rate_limit = toml::find_or_default<uint32_t>(raw_toml_, "server", "global_rate_limit_per_sec");
   per_client_rate_limit = toml::find_or_default<uint32_t>(raw_toml_, "server", "per_client_rate_limit_per_sec");
+  threads = toml::find_or<uint32_t>(raw_toml_, "server", "threads", 1);
+  keep_alive_timeout_sec = toml::find_or<uint32_t>(raw_toml_, "server", "keep_alive_timeout_sec", 5);
+  max_keep_alive_requests = toml::find_or<uint32_t>(raw_toml_, "server", "max_keep_alive_requests", 1000);
+  static_cache = toml::find_or<bool>(raw_toml_, "server", "static_cache", false);
+  static_cache_max_file_kb = toml::find_or<uint32_t>(raw_toml_, "server", "static_cache_max_file_kb", 1024);
+  static_cache_refresh_sec = toml::find_or<uint32_t>(raw_toml_, "server", "static_cache_refresh_sec", 10);
 }
 
 using ServerConfPtr = std::shared_ptr<ServerConf>;
@@ -11,6 +11,8 @@ enum class FeInjectPos {
   PLUGIN_HEAD_PARTS,
   PLUGIN_AFTER_POST_CONTENT_PARTS,
   PLUGIN_AFTER_FOOTER_PARTS,
+  // 只在需要浏览器端高亮的页面上，注入到页脚之后
+  PLUGIN_CLIENT_HIGHLIGHT_PARTS,
 };
 
 inline std::string to_string(const FeInjectPos p) {
@@ -21,6 +23,8 @@ inline std::string to_string(const FeInjectPos p) {
       return "PLUGIN__AFTER_POST_CONTENT_PARTS";
     case FeInjectPos::PLUGIN_AFTER_FOOTER_PARTS:
       return "PLUGIN__AFTER_FOOTER_PARTS";
+    case FeInjectPos::PLUGIN_CLIENT_HIGHLIGHT_PARTS:
+      return "PLUGIN__CLIENT_HIGHLIGHT_PARTS";
     default:
       return "";
   }
@@ -37,6 +41,7 @@ public:
     render_ctx_[to_string(FeInjectPos::PLUGIN_HEAD_PARTS)] = inja::json::array();
     render_ctx_[to_string(FeInjectPos::PLUGIN_AFTER_POST_CONTENT_PARTS)] = inja::json::array();
     render_ctx_[to_string(FeInjectPos::PLUGIN_AFTER_FOOTER_PARTS)] = inja::json::array();
+    render_ctx_[to_string(FeInjectPos::PLUGIN_CLIENT_HIGHLIGHT_PARTS)] = inja::json::array();
   }
 
   ConfigPtr& with_config() {
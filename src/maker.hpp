@@ -6,12 +6,14 @@
 #include <inja/inja.hpp>
 #include <nlohmann/json.hpp>
 
+#include "absl/strings/str_replace.h"
 #include "absl/time/clock.h"
 #include "context.hpp"
 #include "parser/markdown.h"
 #include "plugin/plugins.hpp"
 #include "utils/time.hpp"
 #include "utils/guard.hpp"
+#include "utils/html_escape.hpp"
 
 namespace ling {
 
@@ -40,6 +42,8 @@ public:
   [[nodiscard]] std::string updated_at();
   [[nodiscard]] std::string id();
   [[nodiscard]] std::string html();
+  // 插件为本页设置的模板变量
+  [[nodiscard]] inja::json render_vars();
   [[nodiscard]] std::string html_file_name();
   [[nodiscard]] std::string file_path() {
     return file_path_.string();
@@ -64,6 +68,7 @@ protected:
   std::string title_;
   std::string updated_at_;
   std::string html_;
+  inja::json render_vars_;
 };
 
 using PostPtr = std::shared_ptr<Post>;
@@ -146,6 +151,16 @@ inline std::string Post::html() {
   return html_;
 }
 
+inline inja::json Post::render_vars() {
+  if (!render_vars_.is_null()) {
+    return render_vars_;
+  }
+  if (parser_ != nullptr) {
+    render_vars_ = parser_->render_vars();
+  }
+  return render_vars_.is_null() ? inja::json::object() : render_vars_;
+}
+
 inline std::string Post::html_file_name() {
   return fmt::format("{}.html", id());
 }
@@ -170,6 +185,7 @@ inline CachedPost::CachedPost(inja::json &j) {
   title_ = j["post_title"].get<std::string>();
   updated_at_ = j["post_updated_at"].get<std::string>();
   html_ = j["post_content_html"].get<std::string>();
+  render_vars_ = j.value("post_render_vars", inja::json::object());
   //
   is_page_ = j["is_page"].get<bool>();
 }
@@ -181,6 +197,7 @@ inline void CachedPost::to_json(inja::json &j) {
   j["post_title"] = title();
   j["post_updated_at"] = updated_at();
   j["post_content_html"] = html();
+  j["post_render_vars"] = render_vars();
   j["is_page"] = is_page_;
 }
 
@@ -468,6 +485,10 @@ inline bool Maker::generate() {
     render_ctx["title"] = post->title();
     render_ctx["updated_at"] = post->updated_at();
     render_ctx["post_content"] = post->html();
+    const auto render_vars = post->render_vars();
+    for (const auto& [key, value] : render_vars.items()) {
+      render_ctx[key] = value;
+    }
     //
     const path base_path = dist_path_ / (post->is_page() ? page_dir_ : post_dir_);
 
@@ -484,6 +505,9 @@ inline bool Maker::generate() {
     render_ctx.erase("title");
     render_ctx.erase("updated_at");
     render_ctx.erase("post_content");
+    for (const auto& [key, _] : render_vars.items()) {
+      render_ctx.erase(key);
+    }
   };
   for (const auto& post : parsed_posts_) {
     render_post(post);
@@ -596,10 +620,15 @@ inline void Maker::make_rss(Environment& env) const {
     site_url = site_url.substr(0, site_url.size() - 1);
   }
   std::string post_dir = post_dir_.string();
+  std::string title_buf;
   for (const auto& post : parsed_posts_) {
+    // 标题可能含 & < 等字符，需转义后才是合法的 xml 文本
+    title_buf.clear();
+    utils::html_escape(post->title(), title_buf);
+    // 正文中的 "]]>" 会提前结束 CDATA，需拆成两段
     render_ctx["posts"][post_idx] = {
-        {"title", post->title()},
-        {"desc", "<![CDATA[" + post->html() + "]]>"},
+        {"title", title_buf},
+        {"desc", "<![CDATA[" + absl::StrReplaceAll(post->html(), {{"]]>", "]]]]><![CDATA[>"}}) + "]]>"},
         {"pub_date", post->updated_at()},
         {"link", fmt::format("{0}/{1}/{2}", site_url, post_dir, post->html_file_name())},
     };
@@ -125,8 +125,8 @@ tags: 示例, markdown, C++
 */
 ParseResult Markdown::parse_metadata() {
   absl::string_view line_view;
-  while (true) {
-    line_view = utils::view_strip_empty(lines.at(last_line_idx));
+  while (last_line_idx < lines.size()) {
+    line_view = utils::view_strip_empty(lines[last_line_idx]);
     if (!line_view.empty()) {
       break;
     }
@@ -137,7 +137,10 @@ ParseResult Markdown::parse_metadata() {
   }
   do {
     last_line_idx++;
-    line_view = utils::view_strip_empty(lines.at(last_line_idx));
+    if (last_line_idx >= lines.size()) {  // 元信息部分没有结束标记
+      break;
+    }
+    line_view = utils::view_strip_empty(lines[last_line_idx]);
     if (line_view == "---") {
       break;
     }
@@ -162,7 +165,7 @@ ParseResult Markdown::parse_metadata() {
       spdlog::error("Illegal metadata, k: {}, v: {}", k, v);
     }
   } while (true);
-  if (line_view != "---") {
+  if (last_line_idx >= lines.size() || line_view != "---") {
     return ParseResult::make(2, 0);
   }
   return ParseResult::make(0, last_line_idx + 1);
@@ -205,17 +208,17 @@ ParseResult Markdown::parse_heading() {
 
 ParseResult Markdown::parse_blockquote() {
   size_t line_idx = last_line_idx;
-  auto& last_line = lines.at(line_idx);
+  const auto& last_line = lines.at(line_idx);
   //
   std::vector<std::string> block_quote_lines;
   block_quote_lines.push_back(last_line.substr(1, last_line.size() - 1));
   line_idx++;
   while (line_idx < lines.size()) {
-    last_line = lines.at(line_idx);
-    if (last_line[0] != '>') {
+    const auto& next_line = lines[line_idx];
+    if (next_line[0] != '>') {
       break;
     }
-    block_quote_lines.push_back(last_line.substr(1, last_line.size() - 1));
+    block_quote_lines.push_back(next_line.substr(1, next_line.size() - 1));
     line_idx++;
   }
   const auto block_quote = std::make_shared<BlockQuote>();
@@ -230,7 +233,7 @@ ParseResult Markdown::parse_blockquote() {
 
 ParseResult Markdown::parse_codeblock() {
   size_t line_idx = last_line_idx;
-  auto& last_line = lines.at(line_idx);
+  const auto& last_line = lines.at(line_idx);
   if (last_line.size() < 3 || last_line[1] != '`' || last_line[2] != '`') {
     return parse_paragraph();
   }
@@ -263,12 +266,12 @@ ParseResult Markdown::parse_codeblock() {
   bool valid_code_block = false;
   line_idx++;
   while (line_idx < lines.size()) {
-    last_line = lines.at(line_idx);
-    if (last_line.size() == 3 && last_line[0] == '`' && last_line[1] == '`' && last_line[2] == '`') {
+    const auto& next_line = lines[line_idx];
+    if (next_line.size() == 3 && next_line[0] == '`' && next_line[1] == '`' && next_line[2] == '`') {
       valid_code_block = true;
       break;
     }
-    code_lines.push_back(last_line);
+    code_lines.push_back(next_line);
     line_idx++;
   }
   if (!valid_code_block) {
@@ -350,7 +353,10 @@ ParseResult Markdown::parse_itemlist(int8_t level, size_t blank_prefix_length, c
 
   bool ret_status = true;
   do {
-    auto& last_line = lines.at(line_idx);
+    if (line_idx >= lines.size()) {  // 子列表已处理到文件末尾
+      break;
+    }
+    const auto& last_line = lines[line_idx];
     if (last_line.empty() || last_line.size() <= pos) {
       break;
     }
@@ -368,22 +374,22 @@ ParseResult Markdown::parse_itemlist(int8_t level, size_t blank_prefix_length, c
     if (line_idx >= lines.size()) {
       break;
     }
-    last_line = lines.at(line_idx);
-    if (last_line.empty()) {
+    const auto& next_line = lines[line_idx];
+    if (next_line.empty()) {
       break;
     }
     //
     size_t new_pos_start = 0;
-    while (last_line[new_pos_start] == ' ' || last_line[new_pos_start] == '\t') {
+    while (next_line[new_pos_start] == ' ' || next_line[new_pos_start] == '\t') {
       new_pos_start++;
     }
     //
     if (new_pos_start == blank_prefix_length) {  // 可能同层级
-      if (last_line[new_pos_start] != '-') {     // 非列表项
+      if (next_line[new_pos_start] != '-') {     // 非列表项
         break;
       }
     } else if (new_pos_start > blank_prefix_length) {
-      if (last_line[new_pos_start] == '-') {
+      if (next_line[new_pos_start] == '-') {
         auto child_item_list = std::make_shared<ItemList>();
         item_list->items.back().child = child_item_list;
         last_line_idx = line_idx;
@@ -413,7 +419,10 @@ ParseResult Markdown::parse_ordered_itemlist(int8_t level, size_t blank_prefix_l
   size_t line_idx = last_line_idx;
   bool ret_status = true;
   do {
-    auto& last_line = lines.at(line_idx);
+    if (line_idx >= lines.size()) {  // 子列表已处理到文件末尾
+      break;
+    }
+    const auto& last_line = lines[line_idx];
     item_list->is_ordered = true;
     item_list->items.emplace_back();
     if (const auto status = parse_paragraph(last_line.substr(pos + 2, last_line.size() - 2 - pos),
@@ -427,23 +436,23 @@ ParseResult Markdown::parse_ordered_itemlist(int8_t level, size_t blank_prefix_l
     if (line_idx >= lines.size()) {
       break;
     }
-    last_line = lines.at(line_idx);
-    if (last_line.empty()) {
+    const auto& next_line = lines[line_idx];
+    if (next_line.empty()) {
       break;
     }
     //
     size_t new_pos_start = 0;
-    while (last_line[new_pos_start] == ' ' || last_line[new_pos_start] == '\t') {
+    while (next_line[new_pos_start] == ' ' || next_line[new_pos_start] == '\t') {
       new_pos_start++;
     }
     //
     if (new_pos_start == blank_prefix_length) {                                          // 可能同层级
-      if (!Item::is_ordered_item(absl::string_view(last_line).substr(new_pos_start))) {  // 非有序列表项
+      if (!Item::is_ordered_item(absl::string_view(next_line).substr(new_pos_start))) {  // 非有序列表项
         break;
       }
     } else if (new_pos_start > blank_prefix_length) {  // 可能是子层级
-      auto is_ordered_item = Item::is_ordered_item(absl::string_view(last_line).substr(new_pos_start));
-      if (is_ordered_item || last_line[new_pos_start] == '-') {  // 有序或无序的列表项
+      auto is_ordered_item = Item::is_ordered_item(absl::string_view(next_line).substr(new_pos_start));
+      if (is_ordered_item || next_line[new_pos_start] == '-') {  // 有序或无序的列表项
         auto child_item_list = std::make_shared<ItemList>();
         child_item_list->is_ordered = is_ordered_item;
         item_list->items.back().child = child_item_list;
@@ -811,9 +820,12 @@ ParseResult Markdown::parse_table() {
     table_ptr->col_title_vec.emplace_back(col_title);
   }
   // 列对齐标记行
-  clear_line_view = utils::view_strip_empty(lines.at(last_line_idx + 1));
+  if (last_line_idx + 1 >= lines.size()) {
+    return parse_default();
+  }
+  clear_line_view = utils::view_strip_empty(lines[last_line_idx + 1]);
   line_len = clear_line_view.length();
-  if (clear_line_view[0] != '|' || clear_line_view[line_len - 1] != '|') {
+  if (line_len == 0 || clear_line_view[0] != '|' || clear_line_view[line_len - 1] != '|') {
     return parse_default();
   }
   end_idx = 1;
@@ -842,10 +854,10 @@ ParseResult Markdown::parse_table() {
   }
   // 表格内容
   last_line_idx += 2;
-  do {
-    clear_line_view = utils::view_strip_empty(lines.at(last_line_idx));
+  while (last_line_idx < lines.size()) {
+    clear_line_view = utils::view_strip_empty(lines[last_line_idx]);
     line_len = clear_line_view.length();
-    if (clear_line_view[0] != '|' || clear_line_view[line_len - 1] != '|') {
+    if (line_len == 0 || clear_line_view[0] != '|' || clear_line_view[line_len - 1] != '|') {
       break;
     }
     end_idx = 1;
@@ -867,7 +879,7 @@ ParseResult Markdown::parse_table() {
       break;
     }
     last_line_idx++;
-  } while (last_line_idx < lines.size());
+  }
   elements_.push_back(table_ptr);
   return ParseResult::make(0, last_line_idx);
 }
@@ -886,6 +898,16 @@ void Markdown::clear() {
   }
 }
 
+void Markdown::set_render_var(const std::string& key, const inja::json& value) {
+  std::lock_guard<std::mutex> guard(render_vars_mtx_);
+  render_vars_[key] = value;
+}
+
+inja::json Markdown::render_vars() {
+  std::lock_guard<std::mutex> guard(render_vars_mtx_);
+  return render_vars_;
+}
+
 std::string Markdown::to_html() {
   std::vector<std::string> lines;
   lines.reserve(elements_.size());
@@ -988,13 +1010,21 @@ std::string ItemList::to_html() {
 std::string CodeBlock::to_html() {
   const auto& ln = absl::AsciiStrToLower(lang_name);
   // 有点 trick，不优雅
-  if (ln == "text" || ln == "html" || ln == "xml") {
-    for (auto& line : lines) {
-      line = inja::htmlescape(line);
+  const bool need_escape = ln == "text" || ln == "html" || ln == "xml";
+  std::string html = fmt::format(R"(<pre class="language-{0}"><code>)", ln);
+  // 直接追加到同一个 buffer，不再逐行生成转义后的中间字符串
+  for (size_t idx = 0; idx < lines.size(); idx++) {
+    if (idx > 0) {
+      html.push_back('\n');
+    }
+    if (need_escape) {
+      utils::html_escape(lines[idx], html);
+    } else {
+      html.append(lines[idx]);
     }
   }
-  std::string class_name = fmt::format("language-{}", ln);
-  return fmt::format(R"(<pre class="{0}"><code>{1}</code></pre>)", class_name, absl::StrJoin(lines, "\n"));
+  html.append("</code></pre>");
+  return html;
 }
 
 std::string LatexBlock::to_html() {
@@ -11,6 +11,7 @@
  */
 
 #include <map>
+#include <mutex>
 #include <string>
 #include <utility>
 #include <vector>
@@ -18,6 +19,8 @@
 #include <absl/strings/str_join.h>
 #include <inja/inja.hpp>
 
+#include "utils/html_escape.hpp"
+
 namespace ling {
 
 using StrPair = std::pair<std::string, std::string>;
@@ -112,7 +115,7 @@ private:
 class InlineCode final : public InlineFragment {
 public:
   explicit InlineCode(std::string code = "") : InlineFragment(FragmentType::INLINE_CODE), code_(std::move(code)) {
-    code_ = inja::htmlescape(code_);
+    utils::html_escape_inplace(code_);
   }
   std::string to_html() override;
 
@@ -313,6 +316,10 @@ public:
     return metadata_;
   }
 
+  // 插件为本页设置的模板变量（如本页需要加载的前端脚本），渲染页面时并入模板上下文；插件可能并发执行，读写加锁
+  void set_render_var(const std::string& key, const inja::json& value);
+  inja::json render_vars();
+
 private:
   bool parse();
   ParseResult parse_metadata();
@@ -362,6 +369,9 @@ private:
   std::vector<std::shared_ptr<Element>> elements_;
   std::shared_ptr<Footnotes> footnotes_ptr_ = std::make_shared<Footnotes>();
   std::vector<std::shared_ptr<Paragraph>> paragraphs_;
+  //
+  std::mutex render_vars_mtx_;
+  inja::json render_vars_ = inja::json::object();
 };
 
 using MarkdownPtr = std::shared_ptr<Markdown>;
@@ -1,33 +1,67 @@
 #pragma once
 
-#include <cpr/api.h>
+#include <atomic>
+#include <thread>
+
+#include <cpr/cpr.h>
 #include <spdlog/spdlog.h>
+#include <tsl/robin_map.h>
 
 #include "plugin.h"
+#include "sidecar.hpp"
+#include "utils/artifact_cache.hpp"
+#include "utils/deadline.hpp"
+#include "utils/hash.hpp"
 #include "utils/helper.hpp"
+#include "utils/strings.hpp"
 
 namespace ling::plugin {
 
 // https://docs.mathjax.org/en/latest/server/examples.html
 
+// 一个待渲染的公式
+struct MathItem {
+  std::string tex;
+  bool is_block{false};
+};
+
 class BeMathJax final : public Plugin {
 public:
   bool init(ContextPtr& context_ptr) override;
   bool run(const MarkdownPtr& md_ptr) override;
   bool destroy() override;
+  Resources consumes() const override {
+    return RES_LATEX;
+  }
+  Resources produces() const override {
+    return RES_HTML;
+  }
 
 private:
-  static bool is_mathjax_installed();
+  static std::string mathjax_version();
   static bool install_mathjax();
-  static bool run_mathjax_render_server(uint32_t port);
+  // 缓存键：(MathJax 版本 + 渲染脚本, 块级/行内 + TeX 源码)
+  std::string cache_key(const MathItem& item) const;
+
+  // 批量渲染，返回结果与 items 一一对应，渲染失败的为空串；timed_out 为因超过截止时间而没有渲染的个数
+  std::vector<std::string> mathjax_svgs(const std::vector<MathItem>& items, size_t* timed_out);
+  bool render_batch(cpr::Session& session, const std::vector<MathItem>& items, size_t begin, size_t end,
+                    std::vector<std::string>& svgs, const utils::Deadline& deadline) const;
 
-  std::string mathjax_svg(const std::string& tex, bool is_block=false);
   uint32_t port_ {0};
+  std::string mathjax_version_;
+  std::string script_digest_;
+  // node 渲染服务，首次有公式未命中缓存时才启动
+  SidecarSpec sidecar_spec_;
+  uint32_t batch_size_ {64};
+  uint32_t timeout_ms_ {10000};
+  // 每个 session 复用一条 keep-alive 连接，其数量即同时在途的批次上限
+  std::vector<std::shared_ptr<cpr::Session>> sessions_;
 };
 
 static path MJS_FILE_PATH {"./.mathjax_server.mjs"};
 
-static std::string NODE_HTTP_SERVER_CODE = R"(const http = require('http');
+static std::string NODE_HTTP_SERVER_CODE = R"(import http from 'http';
 import MathJax from 'mathjax';
 await MathJax.init({
   loader: {load: ['input/tex', 'output/svg']}
@@ -35,30 +69,43 @@ await MathJax.init({
 
 const adaptor = MathJax.startup.adaptor;
 
-const server = http.createServer(async (request, response) => {
-    let url = new URL(`http://${process.env.HOST ?? 'localhost'}${request.url}`);
-    if (!url.searchParams.has("mathjax_tex")) {
-        response.writeHead(400, { 'Content-Type': 'application/json' });
-        response.end(JSON.stringify({
-            data: '请求缺少必要参数',
-        }));
+async function render(item) {
+  try {
+    const svg_view = await MathJax.tex2svgPromise(item.tex, {display: true});
+    return item.block ? adaptor.outerHTML(svg_view) : adaptor.innerHTML(svg_view);
+  } catch (err) {
+    console.error(item.tex, err);
+    return '';
+  }
+}
+
+// POST /batch {"items": [{"tex": "...", "block": true}]} => {"svgs": ["..."]}
+const server = http.createServer((request, response) => {
+    if (request.method !== 'POST' || request.url !== '/batch') {
+        response.writeHead(404, { 'Content-Type': 'application/json' });
+        response.end(JSON.stringify({ data: 'not found' }));
         return;
     }
-    let mathjax_tex = url.searchParams.get("mathjax_tex");
-    let with_outer = url.searchParams.get("with_outer");
-    console.log(mathjax_tex);
-    let svg_view = await MathJax.tex2svgPromise(mathjax_tex, {display: true});
-    if (with_outer == "true") {
-       svg_view = adaptor.outerHTML(svg_view);
-    } else {
-       svg_view = adaptor.innerHTML(svg_view);
-    }
-    console.log(svg_view);
-    response.writeHead(200, { 'Content-Type': 'application/json' });
-    response.end(JSON.stringify({
-        svg: svg_view,
-    }));
+    const chunks = [];
+    request.on('data', (chunk) => chunks.push(chunk));
+    request.on('end', async () => {
+        let items;
+        try {
+            items = JSON.parse(Buffer.concat(chunks).toString()).items;
+        } catch (err) {
+            items = undefined;
+        }
+        if (!Array.isArray(items)) {
+            response.writeHead(400, { 'Content-Type': 'application/json' });
+            response.end(JSON.stringify({ data: '请求缺少必要参数' }));
+            return;
+        }
+        const svgs = await Promise.all(items.map(render));
+        response.writeHead(200, { 'Content-Type': 'application/json' });
+        response.end(JSON.stringify({ svgs: svgs }));
+    });
 });
+server.keepAliveTimeout = 60 * 1000;
 let port = 8181;
 if (process.argv.length >= 3) {
     port = parseInt(process.argv[2]);
@@ -73,49 +120,109 @@ inline bool BeMathJax::init(ContextPtr& context_ptr) {
     spdlog::error("npm or jq has been installed");
     return false;
   }
-  if (!is_mathjax_installed()) {
+  mathjax_version_ = mathjax_version();
+  if (mathjax_version_.empty()) {
     spdlog::info("try to install mathjax");
-    if (!install_mathjax()) {
+    if (!install_mathjax() || (mathjax_version_ = mathjax_version()).empty()) {
       spdlog::error("failure to install mathjax");
       return false;
     }
   }
+  script_digest_ = utils::sha256_hex(NODE_HTTP_SERVER_CODE);
   auto& conf_ptr = context_ptr->with_config();
   port_ = toml::find_or<uint32_t>(conf_ptr->raw_toml_, "BeMathJax", "server_port", 8181);
-  auto status = run_mathjax_render_server(port_);
-  std::this_thread::sleep_for(std::chrono::seconds(5));
-  return status;
+  batch_size_ = std::max(1u, toml::find_or<uint32_t>(conf_ptr->raw_toml_, "BeMathJax", "batch_size", 64));
+  timeout_ms_ = toml::find_or<uint32_t>(conf_ptr->raw_toml_, "BeMathJax", "timeout_ms", 10000);
+  const auto max_inflight = std::max(1u, toml::find_or<uint32_t>(conf_ptr->raw_toml_, "BeMathJax", "max_inflight_batches", 4));
+  sidecar_spec_.name = "mathjax";
+  // 脚本摘要仅用于区分不同版本的脚本，使保温复用时不会误用旧进程
+  sidecar_spec_.argv = {"node", MJS_FILE_PATH.string(), std::to_string(port_), script_digest_.substr(0, 12)};
+  sidecar_spec_.port = port_;
+  sidecar_spec_.prepare = [] {
+    // 总是覆盖写入，避免残留的旧版本脚本与当前的批量协议不匹配
+    return utils::write_file_atomic(MJS_FILE_PATH, NODE_HTTP_SERVER_CODE);
+  };
+  const auto url = fmt::format("http://127.0.0.1:{}/batch", port_);
+  for (uint32_t idx = 0; idx < max_inflight; idx++) {
+    auto session = std::make_shared<cpr::Session>();
+    session->SetUrl(cpr::Url{url});
+    session->SetHeader(cpr::Header{{"Content-Type", utils::CONTENT_TYPE_JSON}});
+    session->SetConnectTimeout(cpr::ConnectTimeout{std::chrono::milliseconds(500)});
+    sessions_.push_back(session);
+  }
+  return true;
 }
 
-inline bool BeMathJax::run_mathjax_render_server(uint32_t port) {
-  if (!exists(MJS_FILE_PATH) && !utils::write_file(MJS_FILE_PATH, NODE_HTTP_SERVER_CODE)) {
-    spdlog::error("failure to write file {}", MJS_FILE_PATH.string());
-    return false;
-  }
-  const auto cmd = fmt::format("nohup node {} {} > /dev/null 2>&1 &", MJS_FILE_PATH.string(), port);
-  return system(cmd.c_str()) == 0;
+inline std::string BeMathJax::cache_key(const MathItem& item) const {
+  return utils::ArtifactCache::make_key("BeMathJax", mathjax_version_ + "+" + script_digest_,
+                                        (item.is_block ? "block\n" : "inline\n") + item.tex);
 }
 
-inline std::string BeMathJax::mathjax_svg(const std::string& tex, bool is_block) {
-  static std::string url = fmt::format("http://127.0.0.1:{}/", port_);
+inline bool BeMathJax::render_batch(cpr::Session& session, const std::vector<MathItem>& items, const size_t begin,
+                                    const size_t end, std::vector<std::string>& svgs,
+                                    const utils::Deadline& deadline) const {
+  nlohmann::json req;
+  auto& req_items = req["items"] = nlohmann::json::array();
+  for (size_t idx = begin; idx < end; idx++) {
+    req_items.push_back({{"tex", items[idx].tex}, {"block", items[idx].is_block}});
+  }
+  session.SetBody(cpr::Body{req.dump()});
   uint32_t retries = 0;
   do {
-    auto r = cpr::Get(cpr::Url{url},
-    cpr::Parameters{{"mathjax_tex", tex}, {"with_outer", is_block ? "true" : "false"}},
-    cpr::ConnectTimeout{std::chrono::milliseconds(500)},
-    cpr::Timeout{std::chrono::milliseconds{1000}});
+    session.SetTimeout(cpr::Timeout{deadline.timeout(std::chrono::milliseconds(timeout_ms_))});
+    auto r = session.Post();
     if (r.status_code == 200) {
-      auto j = nlohmann::json::parse(r.text);
-      if (j.contains("svg")) {
-        if (is_block) {
-          return "<p>" + j["svg"].get<std::string>() + "</p>";
+      const auto j = nlohmann::json::parse(r.text, nullptr, false);
+      if (!j.is_discarded() && j.contains("svgs") && j["svgs"].is_array() && j["svgs"].size() == end - begin) {
+        // 单个结果不是字符串时只算该公式失败
+        for (size_t idx = begin; idx < end; idx++) {
+          if (const auto& svg = j["svgs"][idx - begin]; svg.is_string()) {
+            svgs[idx] = svg.get<std::string>();
+          } else {
+            spdlog::warn("illegal mathjax result for: {}", items[idx].tex);
+          }
         }
-        return j["svg"].get<std::string>();
+        return true;
       }
     }
+    spdlog::warn("failure to render mathjax batch, status_code: {}, err msg: {}", r.status_code, r.error.message);
     retries++;
-  } while (retries < 3);
-  return "";
+  } while (retries < 3 && !deadline.expired());
+  return false;
+}
+
+inline std::vector<std::string> BeMathJax::mathjax_svgs(const std::vector<MathItem>& items, size_t* timed_out) {
+  std::vector<std::string> svgs(items.size());
+  const size_t batch_num = (items.size() + batch_size_ - 1) / batch_size_;
+  std::atomic_size_t next_batch {0};
+  std::atomic_size_t attempted_items {0};
+  std::atomic_size_t expired_items {0};
+  // 工作线程不继承 thread_local 的截止时间，这里显式传入
+  const auto deadline = utils::Deadline::current();
+  const auto worker = [&](cpr::Session& session) {
+    for (size_t b = next_batch++; b < batch_num && !deadline.expired(); b = next_batch++) {
+      const size_t begin = b * batch_size_;
+      const size_t end = std::min(items.size(), begin + batch_size_);
+      attempted_items += end - begin;
+      if (!render_batch(session, items, begin, end, svgs, deadline) && deadline.expired()) {
+        expired_items += end - begin;
+      }
+    }
+  };
+  const size_t worker_num = std::min(sessions_.size(), batch_num);
+  std::vector<std::thread> workers;
+  for (size_t idx = 1; idx < worker_num; idx++) {
+    workers.emplace_back(worker, std::ref(*sessions_[idx]));
+  }
+  if (worker_num > 0) {
+    worker(*sessions_[0]);
+  }
+  for (auto& w : workers) {
+    w.join();
+  }
+  // 截止时间到后没有开始渲染的批次也算超时
+  *timed_out = expired_items + (items.size() - attempted_items);
+  return svgs;
 }
 
 inline bool BeMathJax::run(const MarkdownPtr& md_ptr) {
@@ -126,11 +233,22 @@ inline bool BeMathJax::run(const MarkdownPtr& md_ptr) {
     spdlog::error("Init before run!");
     return false;
   }
-  for (auto& ele : md_ptr->elements()) {
-    if (ele == nullptr) {
-      continue;
+  // 先收集整篇文档的公式（去重），一次批量渲染后再回填
+  std::vector<MathItem> items;
+  tsl::robin_map<std::string, size_t> item_idx_m;
+  const auto item_of = [&](const std::string& tex, const bool is_block) {
+    auto key = (is_block ? "B" : "I") + tex;
+    if (const auto it = item_idx_m.find(key); it != item_idx_m.end()) {
+      return it->second;
     }
-    auto* latex_block = dynamic_cast<LatexBlock*>(ele.get());
+    items.push_back(MathItem{tex, is_block});
+    item_idx_m[key] = items.size() - 1;
+    return items.size() - 1;
+  };
+  std::vector<std::pair<std::shared_ptr<Element>*, size_t>> block_slots;
+  for (auto& ele : md_ptr->elements()) {
+    const auto cur = load_slot(ele);
+    auto* latex_block = dynamic_cast<LatexBlock*>(cur.get());
     if (latex_block == nullptr) {
       continue;
     }
@@ -138,48 +256,103 @@ inline bool BeMathJax::run(const MarkdownPtr& md_ptr) {
       spdlog::warn("empty latex math");
       continue;
     }
-    const auto svg = mathjax_svg(latex_block->content(), true);
-    if (svg.empty()) {
-      continue;
-    }
-    auto* svg_ele = new HtmlElement();
-    svg_ele->tag_name = "svg";
-    svg_ele->html = svg;
-    ele.reset(svg_ele);
+    block_slots.emplace_back(&ele, item_of(latex_block->content(), true));
   }
+  std::vector<std::pair<std::shared_ptr<InlineFragment>*, size_t>> inline_slots;
   for (auto& p : md_ptr->paragraphs()) {
     for (auto& block : p->blocks) {
-      if (block->type_ != FragmentType::LATEX) {
+      const auto cur = load_slot(block);
+      if (cur->type_ != FragmentType::LATEX) {
         continue;
       }
-      auto* inline_latex = dynamic_cast<InlineLatex*>(block.get());
+      auto* inline_latex = dynamic_cast<InlineLatex*>(cur.get());
       if (inline_latex->content().empty()) {
         continue;
       }
-      const auto svg = mathjax_svg(inline_latex->content());
-      if (svg.empty()) {
-        continue;
+      inline_slots.emplace_back(&block, item_of(inline_latex->content(), false));
+    }
+  }
+  if (items.empty()) {
+    return true;
+  }
+  // 命中缓存的公式无需再经过 node 渲染
+  std::vector<std::string> svgs(items.size());
+  std::vector<MathItem> missed_items;
+  std::vector<size_t> missed_idx;
+  std::vector<std::string> missed_keys;
+  auto& cache = utils::ArtifactCache::singleton();
+  for (size_t idx = 0; idx < items.size(); idx++) {
+    auto key = cache_key(items[idx]);
+    if (cache.get("BeMathJax", key, svgs[idx])) {
+      continue;
+    }
+    missed_items.push_back(items[idx]);
+    missed_idx.push_back(idx);
+    missed_keys.push_back(std::move(key));
+  }
+  if (!missed_items.empty()) {
+    if (!SidecarManager::singleton().ensure_started(sidecar_spec_)) {
+      spdlog::error("failure to start mathjax render server");
+    } else {
+      size_t timed_out = 0;
+      const auto rendered = mathjax_svgs(missed_items, &timed_out);
+      size_t failed = 0;
+      for (size_t idx = 0; idx < rendered.size(); idx++) {
+        if (rendered[idx].empty()) {
+          failed++;
+          continue;
+        }
+        svgs[missed_idx[idx]] = rendered[idx];
+        cache.put("BeMathJax", missed_keys[idx], rendered[idx]);
+      }
+      if (timed_out > 0) {
+        utils::report_timeout(fmt::format("{} formulas", timed_out));
+      }
+      if (failed > timed_out) {
+        spdlog::warn("failure to render {} formulas", failed - timed_out);
       }
-      auto* text_block = new Text(FragmentType::PLAIN, svg);
-      block.reset(text_block);
     }
   }
+  for (const auto& [slot, idx] : block_slots) {
+    if (svgs[idx].empty()) {
+      continue;
+    }
+    auto* svg_ele = new HtmlElement();
+    svg_ele->tag_name = "svg";
+    svg_ele->html = "<p>" + svgs[idx] + "</p>";
+    replace_slot(*slot, svg_ele);
+  }
+  for (const auto& [slot, idx] : inline_slots) {
+    if (svgs[idx].empty()) {
+      continue;
+    }
+    replace_slot(*slot, new Text(FragmentType::PLAIN, svgs[idx]));
+  }
   return true;
 }
 
 inline bool BeMathJax::destroy() {
-  const auto server_pid = utils::get_cmd_stdout(R"(ps aux | grep "node ./.mathjax_server.mjs" | grep -v "grep" | awk -F' ' '{print $2}')");
-  spdlog::debug("BeMathJax server id: {}", server_pid);
-  auto status = system(fmt::format("kill -9 {}", server_pid).c_str()) == 0;
+  sessions_.clear();
+  SidecarManager::singleton().release(sidecar_spec_.name);
+  // node 启动时已加载脚本，保温复用时也不再需要该文件
   if (exists(MJS_FILE_PATH)) {
-    status = status && std::filesystem::remove(MJS_FILE_PATH);
+    std::filesystem::remove(MJS_FILE_PATH);
   }
-  return status;
+  return true;
 }
 
-inline bool BeMathJax::is_mathjax_installed() {
-  const auto query_result = utils::get_cmd_stdout("npm query '#mathjax' | jq '.[] | select(.name  | type == \"string\") | .name'");
-  return query_result == "\"mathjax\"\n";
+// 未安装时返回空串
+inline std::string BeMathJax::mathjax_version() {
+  auto version = utils::get_cmd_stdout("npm query '#mathjax' | jq -r '.[] | select(.name == \"mathjax\") | .version'");
+  while (!version.empty() && std::isspace(static_cast<unsigned char>(version.back()))) {
+    version.pop_back();
+  }
+  // 非版本号输出（如报错信息）视为未安装
+  if (version.empty() || !std::isdigit(static_cast<unsigned char>(version.front())) ||
+      version.find('\n') != std::string::npos) {
+    return "";
+  }
+  return version;
 }
 
 inline bool BeMathJax::install_mathjax() {
@@ -188,4 +361,4 @@ inline bool BeMathJax::install_mathjax() {
 
 static PluginRegister<BeMathJax> bemathjax_register_ {"BeMathjax"};
 
-}
\ No newline at end of file
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "lazy_load.hpp"
 #include "plugin.h"
 
 #include <fmt/core.h>
@@ -23,7 +24,44 @@ inline bool Giscus::init(ContextPtr& context_ptr) {
   if (!Plugin::init(context_ptr)) {
     return false;
   }
-  auto tpl = R"(<div class="comment">
+  auto repo = toml::find_or_default<std::string>(conf_toml, "giscus", "repo");
+  auto repo_id = toml::find_or_default<std::string>(conf_toml, "giscus", "repo_id");
+  auto category = toml::find_or_default<std::string>(conf_toml, "giscus", "category");
+  auto category_id = toml::find_or_default<std::string>(conf_toml, "giscus", "category_id");
+  // 默认懒加载：读者滚动到评论区附近时才加载 giscus 的脚本与 iframe
+  auto lazy = toml::find_or<bool>(conf_toml, "giscus", "lazy", true);
+  std::string html;
+  if (lazy) {
+    auto tpl = R"(<div class="comment" id="giscus-container"
+        data-src="https://giscus.app/client.js"
+        data-repo="{}"
+        data-repo-id="{}"
+        data-category="{}"
+        data-category-id="{}"
+        data-mapping="pathname"
+        data-strict="0"
+        data-reactions-enabled="1"
+        data-emit-metadata="0"
+        data-input-position="top"
+        data-theme="light"
+        data-lang="zh-CN">
+    </div>)";
+    // giscus 从 script 标签上读取 data-* 配置
+    auto load_fn = R"(function (container) {
+    var script = document.createElement('script');
+    Array.prototype.forEach.call(container.attributes, function (attr) {
+      if (attr.name.indexOf('data-') === 0 && attr.name !== 'data-src') {
+        script.setAttribute(attr.name, attr.value);
+      }
+    });
+    script.src = container.getAttribute('data-src');
+    script.crossOrigin = 'anonymous';
+    script.async = true;
+    container.appendChild(script);
+  })";
+    html = fmt::format(tpl, repo, repo_id, category, category_id) + lazy_load_script("giscus-container", load_fn);
+  } else {
+    auto tpl = R"(<div class="comment">
      <script src="https://giscus.app/client.js"
         data-repo="{}"
         data-repo-id="{}"
@@ -41,11 +79,8 @@ inline bool Giscus::init(ContextPtr& context_ptr) {
         async>
       </script>
     </div>)";
-  auto repo = toml::find_or_default<std::string>(conf_toml, "giscus", "repo");
-  auto repo_id = toml::find_or_default<std::string>(conf_toml, "giscus", "repo_id");
-  auto category = toml::find_or_default<std::string>(conf_toml, "giscus", "category");
-  auto category_id = toml::find_or_default<std::string>(conf_toml, "giscus", "category_id");
-  auto html = fmt::format(tpl, repo, repo_id, category, category_id);
+    html = fmt::format(tpl, repo, repo_id, category, category_id);
+  }
   //
   auto& render_ctx = context_ptr->with_render_ctx();
   render_ctx[to_string(FeInjectPos::PLUGIN_AFTER_POST_CONTENT_PARTS)].emplace_back(html);
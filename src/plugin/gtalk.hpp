@@ -1,5 +1,6 @@
 #pragma once
 
+#include "lazy_load.hpp"
 #include "plugin.h"
 
 #include <fmt/format.h>
@@ -31,11 +32,9 @@ inline bool Gtalk::init(ContextPtr& context_ptr) {
   auto owner = toml::find_or_default<std::string>(conf_toml, "gtalk", "owner");
   auto admin = toml::find_or_default<std::string>(conf_toml, "gtalk", "admin");
   //
-  auto css_part = R"(<link rel="stylesheet" href="https://unpkg.com/gitalk/dist/gitalk.css">)";
-  auto js_part = fmt::format(R"(<div class="comment">
-<div id="gitalk-container"></div>
-<script defer src="https://unpkg.com/gitalk/dist/gitalk.min.js"></script>
-const gitalk = new Gitalk({
+  // 默认懒加载：读者滚动到评论区附近时才加载 gitalk 的样式与脚本
+  auto lazy = toml::find_or<bool>(conf_toml, "gtalk", "lazy", true);
+  auto gitalk_init = fmt::format(R"(new Gitalk({{
   clientID: '{}',
   clientSecret: '{}',
   repo: '{}',
@@ -43,12 +42,44 @@ const gitalk = new Gitalk({
   admin: ['{}'],
   id: location.pathname,
   distractionFreeMode: false
-});
-gitalk.render('gitalk-container');
-</div>)", client_id, client_secret, repo, owner, admin);
+}}))", client_id, client_secret, repo, owner, admin);
+  std::string css_part;
+  std::string js_part;
+  if (lazy) {
+    auto load_fn = fmt::format(R"(function (container) {{
+    var css = document.createElement('link');
+    css.rel = 'stylesheet';
+    css.href = container.getAttribute('data-href');
+    document.head.appendChild(css);
+    var script = document.createElement('script');
+    script.src = container.getAttribute('data-src');
+    script.onload = function () {{
+      {}.render(container);
+    }};
+    document.body.appendChild(script);
+  }})", gitalk_init);
+    js_part = R"(<div class="comment">
+<div id="gitalk-container" data-href="https://unpkg.com/gitalk/dist/gitalk.css"
+  data-src="https://unpkg.com/gitalk/dist/gitalk.min.js"></div>
+</div>)" + lazy_load_script("gitalk-container", load_fn);
+  } else {
+    css_part = R"(<link rel="stylesheet" href="https://unpkg.com/gitalk/dist/gitalk.css">)";
+    // defer 脚本在 DOMContentLoaded 之前执行完毕
+    js_part = fmt::format(R"(<div class="comment">
+<div id="gitalk-container"></div>
+<script defer src="https://unpkg.com/gitalk/dist/gitalk.min.js"></script>
+<script>
+window.addEventListener('DOMContentLoaded', function () {{
+  {}.render('gitalk-container');
+}});
+</script>
+</div>)", gitalk_init);
+  }
   //
   auto& render_ctx = context_ptr->with_render_ctx();
-  render_ctx[to_string(FeInjectPos::PLUGIN_HEAD_PARTS)].emplace_back(css_part);
+  if (!css_part.empty()) {
+    render_ctx[to_string(FeInjectPos::PLUGIN_HEAD_PARTS)].emplace_back(css_part);
+  }
   render_ctx[to_string(FeInjectPos::PLUGIN_AFTER_POST_CONTENT_PARTS)].emplace_back(js_part);
   //
   return true;
@@ -1,14 +1,53 @@
 #pragma once
 
 #include "plugin.h"
+#include "utils/artifact_cache.hpp"
+#include "utils/highlighter.hpp"
 
 namespace ling::plugin {
 
 // https://highlightjs.org/
+// mode = "build"（默认）：构建时切分代码块，输出带 hljs-* class 的 <span>，页面只需内联一小段样式；
+//   构建时不支持的语言（如 java、javascript）仍由 highlight.js 高亮：含有这类代码块的文档设置模板变量 client_highlight，
+//   模板只在这些页面的页脚之后注入脚本，正文（也用于 RSS）中不含脚本
+// mode = "client"：沿用 highlight.js，在读者浏览器中高亮
+
+// 与 highlight.js 的 default 主题保持一致
+static std::string HIGHLIGHT_STYLE = R"(<style>
+pre code.hljs{display:block;overflow-x:auto;padding:1em}code.hljs{padding:3px 5px}
+.hljs{color:#444;background:#f3f3f3}
+.hljs-comment{color:#697070}.hljs-meta,.hljs-punctuation,.hljs-tag{color:#444a}
+.hljs-keyword,.hljs-section,.hljs-attr,.hljs-name,.hljs-selector-tag{font-weight:700}
+.hljs-keyword,.hljs-section{color:#333}
+.hljs-attr,.hljs-literal,.hljs-number,.hljs-variable{color:#880000}
+.hljs-string,.hljs-built_in,.hljs-title{color:#397300}
+.hljs-meta{color:#1f7199}
+</style>)";
+
+static std::string HIGHLIGHT_JS =
+    R"(<script src="https://cdnjs.cloudflare.com/ajax/libs/highlight.js/11.9.0/highlight.min.js"></script>
+<script>hljs.highlightAll();</script>)";
+
+// 无需高亮的纯文本，以及由其他插件渲染为图片的代码块
+inline bool needs_client_highlight(const std::string& lang_name) {
+  const auto ln = absl::AsciiStrToLower(lang_name);
+  return !ln.empty() && ln != "text" && ln != "txt" && ln != "plaintext" && ln != "plantuml" &&
+         ln != "plantuml-svg" && ln != "mermaid";
+}
 
 class Highlight final : public Plugin {
 public:
   bool init(ContextPtr& context_ptr) override;
+  bool run(const MarkdownPtr& md_ptr) override;
+  Resources consumes() const override {
+    return RES_CODE_BLOCK;
+  }
+  Resources produces() const override {
+    return RES_HTML;
+  }
+
+private:
+  bool build_time_ {true};
 };
 
 inline bool Highlight::init(ContextPtr& context_ptr) {
@@ -16,16 +55,63 @@ inline bool Highlight::init(ContextPtr& context_ptr) {
     return false;
   }
   auto& render_ctx = context_ptr->with_render_ctx();
+  const auto& raw_toml = context_ptr->with_config()->raw_toml_;
+  build_time_ = toml::find_or<std::string>(raw_toml, "highlight", "mode", "build") != "client";
+  if (build_time_) {
+    render_ctx[to_string(FeInjectPos::PLUGIN_HEAD_PARTS)].emplace_back(HIGHLIGHT_STYLE);
+    render_ctx[to_string(FeInjectPos::PLUGIN_CLIENT_HIGHLIGHT_PARTS)].emplace_back(HIGHLIGHT_JS);
+    return true;
+  }
   //
   auto css_part = R"(<link rel="stylesheet" href="https://cdnjs.cloudflare.com/ajax/libs/highlight.js/11.9.0/styles/default.min.css">)";
   render_ctx[to_string(FeInjectPos::PLUGIN_HEAD_PARTS)].emplace_back(css_part);
   //
-  auto js_part = R"(<script src="https://cdnjs.cloudflare.com/ajax/libs/highlight.js/11.9.0/highlight.min.js"></script>
-<script>hljs.highlightAll();</script>)";
-  render_ctx[to_string(FeInjectPos::PLUGIN_AFTER_FOOTER_PARTS)].emplace_back(js_part);
+  render_ctx[to_string(FeInjectPos::PLUGIN_AFTER_FOOTER_PARTS)].emplace_back(HIGHLIGHT_JS);
+  return true;
+}
+
+inline bool Highlight::run(const MarkdownPtr& md_ptr) {
+  if (md_ptr == nullptr || !inited_) {
+    return false;
+  }
+  if (!build_time_) {
+    return true;
+  }
+  auto& cache = utils::ArtifactCache::singleton();
+  bool client_highlight = false;
+  for (auto& ele : md_ptr->elements()) {
+    const auto cur = load_slot(ele);
+    const auto* codeblock = dynamic_cast<CodeBlock*>(cur.get());
+    if (codeblock == nullptr) {
+      continue;
+    }
+    if (utils::find_highlight_lang(codeblock->lang_name) == nullptr) {
+      client_highlight = client_highlight || needs_client_highlight(codeblock->lang_name);
+      continue;
+    }
+    const auto ln = absl::AsciiStrToLower(codeblock->lang_name);
+    const auto code = absl::StrJoin(codeblock->lines, "\n");
+    // 版本号随高亮规则变化递增，使旧的缓存失效
+    const auto key = utils::ArtifactCache::make_key("Highlight", "2", ln + "\n" + code);
+    std::string html;
+    if (!cache.get("Highlight", key, html)) {
+      // data-highlighted 使同一页面加载的 highlight.js 跳过已高亮的代码块
+      html = fmt::format(R"(<pre class="language-{0}"><code class="hljs language-{0}" data-highlighted="yes">)", ln);
+      utils::highlight_code(ln, code, html);
+      html.append("</code></pre>");
+      cache.put("Highlight", key, html);
+    }
+    auto* html_ele = new HtmlElement();
+    html_ele->tag_name = "pre";
+    html_ele->html = std::move(html);
+    replace_slot(ele, html_ele);
+  }
+  if (client_highlight) {
+    md_ptr->set_render_var("client_highlight", true);
+  }
   return true;
 }
 
 static PluginRegister<Highlight> highlight_register_ {"Highlight"};
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+
+#include <fmt/format.h>
+
+namespace ling::plugin {
+
+// 评论等第三方组件的懒加载：容器接近视口时才调用 load_fn(container) 注入脚本，
+// 不支持 IntersectionObserver 的浏览器立即加载。脚本地址放在容器的 data-src/data-href 上，
+// 便于 Vendor 阶段识别与改写
+inline std::string lazy_load_script(const std::string& container_id, const std::string& load_fn) {
+  return fmt::format(R"(<script>
+(function () {{
+  var container = document.getElementById('{}');
+  if (!container) {{
+    return;
+  }}
+  var load = {};
+  if (!('IntersectionObserver' in window)) {{
+    load(container);
+    return;
+  }}
+  var observer = new IntersectionObserver(function (entries) {{
+    if (entries.some(function (e) {{ return e.isIntersecting; }})) {{
+      observer.disconnect();
+      load(container);
+    }}
+  }}, {{rootMargin: '400px 0px'}});
+  observer.observe(container);
+}})();
+</script>)",
+                     container_id, load_fn);
+}
+
+}  // namespace ling::plugin
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
+#include <mutex>
+#include <thread>
 #include <utility>
 
 #include <absl/hash/hash.h>
@@ -11,25 +14,110 @@
 #include <spdlog/spdlog.h>
 
 #include "parser/markdown.h"
+#include "utils/artifact_cache.hpp"
+#include "utils/deadline.hpp"
+#include "utils/hash.hpp"
 #include "utils/helper.hpp"
+#include "utils/subprocess.hpp"
 #include "plugin.h"
 
 namespace ling::plugin {
 
 using std::filesystem::path;
 
+static path MERMAID_WORKER_FILE_PATH {"./.mermaid_worker.mjs"};
+
+// 常驻的渲染 worker：浏览器只启动一次，同时渲染的图数量不超过 pool_size
+// 协议：stdin 每行一个 {"id": 0, "code": "..."}，stdout 每行一个 {"id": 0, "svg": "..."} 或 {"id": 0, "error": "..."}，
+// 启动就绪后先输出一行 {"ready": true}，stdin 关闭后退出
+static std::string MERMAID_WORKER_CODE = R"(import readline from 'readline';
+import puppeteer from 'puppeteer';
+import { renderMermaid } from '@mermaid-js/mermaid-cli';
+
+const pool_size = Math.max(1, parseInt(process.argv[2] ?? '4'));
+const browser = await puppeteer.launch({ headless: true });
+
+let running = 0;
+const waiting = [];
+function acquire() {
+  if (running < pool_size) {
+    running++;
+    return Promise.resolve();
+  }
+  return new Promise((resolve) => waiting.push(resolve));
+}
+function release() {
+  const next = waiting.shift();
+  if (next) {
+    next();
+  } else {
+    running--;
+  }
+}
+
+async function render(req) {
+  await acquire();
+  try {
+    const { data } = await renderMermaid(browser, req.code, 'svg', {});
+    return { id: req.id, svg: Buffer.from(data).toString('utf8') };
+  } catch (err) {
+    return { id: req.id, error: String(err) };
+  } finally {
+    release();
+  }
+}
+
+const pending = [];
+const rl = readline.createInterface({ input: process.stdin, crlfDelay: Infinity });
+rl.on('line', (line) => {
+  let req;
+  try {
+    req = JSON.parse(line);
+  } catch (err) {
+    return;
+  }
+  pending.push(render(req).then((resp) => process.stdout.write(JSON.stringify(resp) + '\n')));
+});
+rl.on('close', async () => {
+  await Promise.all(pending);
+  await browser.close();
+  process.exit(0);
+});
+process.stdout.write(JSON.stringify({ ready: true }) + '\n');)";
+
 class Mermaid final: public Plugin {
 public:
   bool init(ContextPtr& context_ptr) override;
   bool run(const MarkdownPtr& md_ptr) override;
+  bool destroy() override;
+  Resources consumes() const override {
+    return RES_CODE_BLOCK;
+  }
+  Resources produces() const override {
+    return RES_IMAGE;
+  }
 
 private:
   static bool is_mermaid_cli_installed();
+  static std::string mermaid_cli_version();
   static bool install_mermaid_cli();
-  static bool mmd2svg(path& mmd, path& svg);
+  static bool mmd2svg(path& mmd, path& svg, std::chrono::milliseconds timeout);
+  // 首次有图需要渲染时才启动 worker，启动失败后不再重试，退化为逐个 npm exec
+  bool ensure_worker_started();
+  // 返回结果与 diagrams 一一对应，渲染失败的为空串
+  std::vector<std::string> render_batch(const std::vector<std::string>& diagrams);
+  bool fallback_render(const std::string& diagram, const path& svg_path, const utils::Deadline& deadline) const;
 
 private:
   ConfigPtr config_;
+  uint32_t pool_size_ {4};
+  uint32_t timeout_sec_ {60};
+  // 参与缓存键：mermaid-cli 版本 + worker 脚本
+  std::string render_version_;
+  //
+  std::mutex worker_mtx_;
+  utils::Subprocess worker_;
+  bool worker_failed_ {false};
 };
 
 inline bool Mermaid::init(ContextPtr& context_ptr) {
@@ -37,6 +125,8 @@ inline bool Mermaid::init(ContextPtr& context_ptr) {
     return false;
   }
   config_ = context_ptr->with_config();
+  pool_size_ = std::max(1u, toml::find_or<uint32_t>(config_->raw_toml_, "mermaid", "pool_size", 4));
+  timeout_sec_ = toml::find_or<uint32_t>(config_->raw_toml_, "mermaid", "timeout_sec", 60);
   if (!utils::is_npm_exist() || !utils::is_jq_exist()) {
     spdlog::error("npm or jq not exists!");
     return false;
@@ -49,9 +139,121 @@ inline bool Mermaid::init(ContextPtr& context_ptr) {
     }
   }
   spdlog::debug("mermaid cli has installed!");
+  render_version_ = mermaid_cli_version() + "+" + utils::sha256_hex(MERMAID_WORKER_CODE);
+  return true;
+}
+
+inline bool Mermaid::ensure_worker_started() {
+  if (worker_.running()) {
+    return true;
+  }
+  if (worker_failed_) {
+    return false;
+  }
+  worker_failed_ = true;
+  if (exists(MERMAID_WORKER_FILE_PATH)) {
+    std::filesystem::remove(MERMAID_WORKER_FILE_PATH);
+  }
+  if (!utils::write_file(MERMAID_WORKER_FILE_PATH, MERMAID_WORKER_CODE)) {
+    spdlog::error("failure to write file {}", MERMAID_WORKER_FILE_PATH.string());
+    return false;
+  }
+  if (!worker_.start({"node", MERMAID_WORKER_FILE_PATH.string(), std::to_string(pool_size_)})) {
+    spdlog::error("failure to start mermaid worker");
+    return false;
+  }
+  std::string line;
+  const auto& deadline = utils::Deadline::current();
+  if (!worker_.read_line(line, deadline.timeout(std::chrono::seconds(timeout_sec_))) ||
+      line.find("ready") == std::string::npos) {
+    spdlog::error("mermaid worker not ready: {}", line);
+    worker_.stop(std::chrono::milliseconds(200));
+    // 因时间预算耗尽而未就绪的，下次仍可重试
+    worker_failed_ = !deadline.expired();
+    return false;
+  }
+  worker_failed_ = false;
+  spdlog::debug("mermaid worker started, pid: {}", worker_.pid());
   return true;
 }
 
+inline std::vector<std::string> Mermaid::render_batch(const std::vector<std::string>& diagrams) {
+  std::vector<std::string> svgs(diagrams.size());
+  std::lock_guard<std::mutex> lock(worker_mtx_);
+  if (diagrams.empty() || !ensure_worker_started()) {
+    return svgs;
+  }
+  // worker 的 stdout 管道写满时会停止读 stdin，所以写请求与读响应需在不同线程中进行
+  std::thread writer([&] {
+    for (size_t idx = 0; idx < diagrams.size(); idx++) {
+      const nlohmann::json req = {{"id", idx}, {"code", diagrams[idx]}};
+      if (!worker_.write_all(req.dump() + "\n")) {
+        spdlog::error("failure to send diagram to mermaid worker");
+        return;
+      }
+    }
+  });
+  size_t received = 0;
+  std::string line;
+  const auto& deadline = utils::Deadline::current();
+  while (received < diagrams.size()) {
+    if (!worker_.read_line(line, deadline.timeout(std::chrono::seconds(timeout_sec_)))) {
+      if (!deadline.expired()) {
+        spdlog::error("mermaid worker no response, {} diagrams left", diagrams.size() - received);
+      }
+      break;
+    }
+    const auto resp = nlohmann::json::parse(line, nullptr, false);
+    if (resp.is_discarded() || !resp.contains("id")) {
+      continue;
+    }
+    received++;
+    const auto idx = resp["id"].get<size_t>();
+    if (idx >= diagrams.size()) {
+      continue;
+    }
+    if (resp.contains("svg")) {
+      svgs[idx] = resp["svg"].get<std::string>();
+    } else {
+      spdlog::error("failure to render mermaid diagram: {}", resp.value("error", ""));
+    }
+  }
+  if (received < diagrams.size()) {
+    // 无响应的 worker 不再复用，杀掉后 writer 线程的写入也会随之失败返回
+    worker_.kill_now();
+    writer.join();
+    worker_.stop(std::chrono::milliseconds(200));
+    // 时间预算耗尽时 worker 仍在渲染，杀掉以免其响应串到下一批，但下次仍可重新启动
+    worker_failed_ = !deadline.expired();
+    return svgs;
+  }
+  writer.join();
+  return svgs;
+}
+
+inline bool Mermaid::fallback_render(const std::string& diagram, const path& svg_path,
+                                     const utils::Deadline& deadline) const {
+  auto temp_dir = current_path() / ".temp";
+  if (!exists(temp_dir)) {
+    create_directory(temp_dir);
+  }
+  auto mmd_file_path = temp_dir / (svg_path.stem().string() + ".mmd");
+  std::fstream mmd_file_stream(mmd_file_path, std::ios::out | std::ios::trunc);
+  if (!mmd_file_stream.is_open()) {
+    spdlog::error("Failed to open file {}", mmd_file_path);
+    return false;
+  }
+  mmd_file_stream << diagram;
+  mmd_file_stream.flush();
+  mmd_file_stream.close();
+  permissions(mmd_file_path, std::filesystem::perms::owner_all | std::filesystem::perms::group_all,
+              std::filesystem::perm_options::add);
+  auto svg = svg_path;
+  const bool status = mmd2svg(mmd_file_path, svg, deadline.timeout(std::chrono::seconds(timeout_sec_)));
+  std::filesystem::remove(mmd_file_path);
+  return status;
+}
+
 // https://github.com/mermaid-js/mermaid-cli
 inline bool Mermaid::run(const MarkdownPtr& md_ptr) {
   if (md_ptr == nullptr) {
@@ -61,57 +263,76 @@ inline bool Mermaid::run(const MarkdownPtr& md_ptr) {
     spdlog::error("Init before run!");
     return false;
   }
-  auto temp_dir = current_path() / ".temp";
   auto img_dir = current_path() / "mermaid-images";
-  if (!exists(temp_dir)) {
-    create_directory(temp_dir);
-  }
   if (!exists(img_dir)) {
     if (!create_directories(img_dir)) {
       spdlog::error("failure to create directory: {}", img_dir.string());
       return false;
     }
   }
+  // 先收集未缓存的图，批量交给 worker 渲染
+  struct Target {
+    std::shared_ptr<Element>* slot;
+    std::shared_ptr<Element> codeblock;
+    std::string key;
+  };
+  std::vector<Target> targets;
+  std::vector<std::string> diagrams;
+  std::vector<std::string> diagram_keys;
+  std::vector<path> diagram_paths;
+  auto& cache = utils::ArtifactCache::singleton();
   for (auto& ele : md_ptr->elements()) {
-    if (ele == nullptr) {
-      continue;
-    }
-    auto* codeblock = dynamic_cast<CodeBlock*>(ele.get());
+    auto cur = load_slot(ele);
+    auto* codeblock = dynamic_cast<CodeBlock*>(cur.get());
     if (codeblock == nullptr) {
       continue;
     }
-    // std::cout << "has codeblock, lang_name=" << codeblock->lang_name << std::endl;
     if (codeblock->lang_name != "mermaid") {
       continue;
     }
     auto mmd_diagram = absl::StrJoin(codeblock->lines, "\n");
-    auto hash_value = std::hash<std::string>{}(mmd_diagram);
-    auto mmd_file_path = temp_dir / fmt::format("{0}.mmd", hash_value);
-    //
-    auto svg_file_name = fmt::format("{}.svg", hash_value);
-    auto svg_path = img_dir / svg_file_name;
-    if (!exists(svg_path)) {
-      std::fstream mmd_file_stream(mmd_file_path, std::ios::out | std::ios::trunc);
-      if (!mmd_file_stream.is_open()) {
-        spdlog::error("Failed to open file {}", mmd_file_path);
-        continue;
-      }
-      mmd_file_stream << mmd_diagram;
-      mmd_file_stream.flush();
-      mmd_file_stream.close();
-      permissions(mmd_file_path, std::filesystem::perms::owner_all | std::filesystem::perms::group_all,
-                  std::filesystem::perm_options::add);
-
-      if (!mmd2svg(mmd_file_path, svg_path)) {
-        spdlog::error("Failed to export mmd to svg!");
-        continue;
+    auto key = utils::ArtifactCache::make_key("Mermaid", render_version_, mmd_diagram);
+    auto svg_path = img_dir / fmt::format("{}.svg", key);
+    if (std::find(diagram_keys.begin(), diagram_keys.end(), key) == diagram_keys.end() &&
+        !cache.publish("Mermaid", key, svg_path)) {
+      diagrams.push_back(std::move(mmd_diagram));
+      diagram_keys.push_back(key);
+      diagram_paths.push_back(std::move(svg_path));
+    }
+    targets.push_back(Target{&ele, std::move(cur), std::move(key)});
+  }
+  const auto svgs = render_batch(diagrams);
+  const auto& deadline = utils::Deadline::current();
+  for (size_t idx = 0; idx < diagrams.size(); idx++) {
+    if (!svgs[idx].empty()) {
+      if (!cache.put("Mermaid", diagram_keys[idx], svgs[idx]) ||
+          !cache.link("Mermaid", diagram_keys[idx], diagram_paths[idx])) {
+        spdlog::error("failure to write file: {}", diagram_paths[idx].string());
       }
+      continue;
+    }
+    if (deadline.expired()) {
+      utils::report_timeout("mermaid diagram " + diagram_paths[idx].filename().string());
+      continue;
+    }
+    if (!fallback_render(diagrams[idx], diagram_paths[idx], deadline)) {
+      spdlog::error("Failed to export mmd to svg!");
+      continue;
+    }
+    // 回退渲染直接写出到 dest，同样收入缓存
+    cache.put("Mermaid", diagram_keys[idx], utils::read_file_all(diagram_paths[idx]));
+  }
+  for (auto& target : targets) {
+    auto svg_file_name = fmt::format("{}.svg", target.key);
+    if (!exists(img_dir / svg_file_name)) {
+      continue;
     }
     // 替换
     auto* image_ptr = new Image();
-    image_ptr->alt_text = mmd_file_path.stem();
+    image_ptr->alt_text = target.key;
     image_ptr->uri = "/mermaid-images/" + svg_file_name;
     //
+    const auto* codeblock = dynamic_cast<CodeBlock*>(target.codeblock.get());
     for (const auto& [fst, snd] : codeblock->attrs) {
       if (fst == "width") {
         image_ptr->width = snd;
@@ -119,16 +340,24 @@ inline bool Mermaid::run(const MarkdownPtr& md_ptr) {
         image_ptr->alt_text = snd;
       }
     }
-    ele.reset(image_ptr);
+    replace_slot(*target.slot, image_ptr);
+  }
+  return true;
+}
+
+inline bool Mermaid::destroy() {
+  std::lock_guard<std::mutex> lock(worker_mtx_);
+  worker_.stop();
+  if (exists(MERMAID_WORKER_FILE_PATH)) {
+    std::filesystem::remove(MERMAID_WORKER_FILE_PATH);
   }
-  remove_all(temp_dir);
   return true;
 }
 
-inline bool Mermaid::mmd2svg(path& mmd, path& svg) {
+inline bool Mermaid::mmd2svg(path& mmd, path& svg, const std::chrono::milliseconds timeout) {
   const auto cmd = fmt::format("npm exec -- @mermaid-js/mermaid-cli -i {0} -o {1} 2>&1", mmd.string(), svg.string());
   // std::cout << "mmd2svg cmd: " << cmd << std::endl;
-  return system(cmd.c_str()) == 0;
+  return utils::run_shell(cmd, timeout) == 0;
 }
 
 inline bool Mermaid::is_mermaid_cli_installed() {
@@ -136,10 +365,20 @@ inline bool Mermaid::is_mermaid_cli_installed() {
   return query_result == "\"@mermaid-js/mermaid-cli\"\n";
 }
 
+// 未安装时返回空串
+inline std::string Mermaid::mermaid_cli_version() {
+  auto version = utils::get_cmd_stdout(
+      "npm query '#@mermaid-js/mermaid-cli' | jq -r '.[] | select(.name == \"@mermaid-js/mermaid-cli\") | .version'");
+  while (!version.empty() && std::isspace(static_cast<unsigned char>(version.back()))) {
+    version.pop_back();
+  }
+  return version;
+}
+
 inline bool Mermaid::install_mermaid_cli() {
   return system("npm install @mermaid-js/mermaid-cli 2>&1") == 0;
 }
 
 static PluginRegister<Mermaid> mermaid_register_ {"Mermaid"};
 
-}
\ No newline at end of file
+}
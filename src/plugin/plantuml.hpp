@@ -7,11 +7,19 @@
 #include <spdlog/spdlog.h>
 #include <zlib.h>
 
+#include <algorithm>
+#include <atomic>
 #include <filesystem>
+#include <optional>
+#include <thread>
 #include <utility>
 
 #include "parser/markdown.h"
+#include "utils/artifact_cache.hpp"
+#include "utils/deadline.hpp"
+#include "utils/helper.hpp"
 #include "plugin.h"
+#include "sidecar.hpp"
 
 namespace ling::plugin {
 
@@ -81,24 +89,38 @@ public:
   bool init(ContextPtr& context_ptr) override;
   bool run(const MarkdownPtr& md_ptr) override;
   bool destroy() override;
+  Resources consumes() const override {
+    return RES_CODE_BLOCK;
+  }
+  Resources produces() const override {
+    return RES_IMAGE;
+  }
 
-  std::pair<bool, std::string> diagram_desc2pic(std::vector<std::string>& lines);
+  std::pair<bool, std::string> diagram_desc2pic(cpr::Session& session, const std::vector<std::string>& lines) const;
   static std::string hex_encode(const std::string& diagram_desc);
 
 private:
-  bool start_picoweb_server();
-  bool stop_picoweb_server() const;
+  std::string diagram_text(const std::vector<std::string>& lines) const;
+  // 并发渲染，每个图独立重试，返回结果与 diagrams 一一对应，失败的为空串
+  std::vector<std::string> render_all(const std::vector<const std::vector<std::string>*>& diagrams);
 
 private:
   ConfigPtr config_;
   //
   std::string jar_path_;
   uint32_t picweb_port_ {8000};
-  bool picoweb_server_started_ {false};
+  // 使用本地 jar 时的 picoweb 服务，首次有图未命中缓存时才启动
+  std::optional<SidecarSpec> picoweb_spec_;
   //
   std::string plantuml_server_;
   std::string diagram_header_;
+  // 参与缓存键：本地 jar 或远程服务，渲染结果可能不同
+  std::string render_version_;
   std::filesystem::path target_img_dir_;
+  //
+  uint32_t retries_ {3};
+  // 每个 session 复用一条 keep-alive 连接，其数量即同时在途的请求上限
+  std::vector<std::shared_ptr<cpr::Session>> sessions_;
 };
 
 // https://plantuml.com/text-encoding
@@ -112,7 +134,7 @@ inline std::string PlantUML::hex_encode(const std::string& diagram_desc) {
   return ss.str();
 }
 
-inline std::pair<bool, std::string> PlantUML::diagram_desc2pic(std::vector<std::string>& lines) {
+inline std::string PlantUML::diagram_text(const std::vector<std::string>& lines) const {
   std::stringstream ss;
   ss << "@startuml\n";
   ss << diagram_header_ << "\n";
@@ -120,12 +142,15 @@ inline std::pair<bool, std::string> PlantUML::diagram_desc2pic(std::vector<std::
     ss << line << "\n";
   }
   ss << "@enduml";
-  std::string plantuml_diagram = ss.str();
-  auto encoded = hex_encode(plantuml_diagram);
+  return ss.str();
+}
+
+inline std::pair<bool, std::string> PlantUML::diagram_desc2pic(cpr::Session& session,
+                                                               const std::vector<std::string>& lines) const {
+  auto encoded = hex_encode(diagram_text(lines));
   const std::string target_url = fmt::format("http://{}/plantuml/svg/{}", plantuml_server_, encoded);
-  cpr::Response r = cpr::Get(cpr::Url{target_url},
-    cpr::Timeout{std::chrono::seconds(5)},
-    cpr::ConnectTimeout{std::chrono::seconds(2)});
+  session.SetUrl(cpr::Url{target_url});
+  cpr::Response r = session.Get();
   if (r.status_code != 200) {
     spdlog::error("Failed to call plantuml, status_code: {}, response: {}, err msg: {}",
       r.status_code, r.text, r.error.message);
@@ -143,15 +168,24 @@ inline bool PlantUML::init(ContextPtr& context_ptr) {
   picweb_port_ = toml::find_or<uint32_t>(config_->raw_toml_, "plantuml", "picoweb_port", 8000);
   plantuml_server_ = toml::find_or<std::string>(config_->raw_toml_, "plantuml", "server", PLANTUML_REMOTE_SERVER);
   diagram_header_ = toml::find_or_default<std::string>(config_->raw_toml_, "plantuml", "header");
+  retries_ = std::max(1u, toml::find_or<uint32_t>(config_->raw_toml_, "plantuml", "retries", 3));
+  const auto max_inflight = std::max(1u, toml::find_or<uint32_t>(config_->raw_toml_, "plantuml", "max_inflight", 4));
+  for (uint32_t idx = 0; idx < max_inflight; idx++) {
+    auto session = std::make_shared<cpr::Session>();
+    session->SetConnectTimeout(cpr::ConnectTimeout{std::chrono::seconds(2)});
+    sessions_.push_back(session);
+  }
   if (!jar_path_.empty() && (plantuml_server_.empty() || plantuml_server_ == PLANTUML_REMOTE_SERVER)) {
-    if (!start_picoweb_server()) {
-      spdlog::error("failure to start plantuml picoweb server");
-      return false;
-    }
-    std::this_thread::sleep_for(std::chrono::seconds(2)); // 等待2s，等服务就绪
+    SidecarSpec spec;
+    spec.name = "plantuml";
+    spec.argv = {"java", "-jar", jar_path_, fmt::format("-picoweb:{}", picweb_port_)};
+    spec.port = picweb_port_;
+    spec.ready_timeout =
+        std::chrono::seconds(toml::find_or<uint32_t>(config_->raw_toml_, "plantuml", "ready_timeout_sec", 30));
+    picoweb_spec_ = std::move(spec);
     plantuml_server_ = fmt::format("127.0.0.1:{}", picweb_port_);
-    picoweb_server_started_ = true;
   }
+  render_version_ = jar_path_.empty() ? plantuml_server_ : path(jar_path_).filename().string();
   //
   target_img_dir_ = current_path() / "plantuml-images";
   if (!exists(target_img_dir_)) {
@@ -160,15 +194,38 @@ inline bool PlantUML::init(ContextPtr& context_ptr) {
   return true;
 }
 
-inline bool PlantUML::start_picoweb_server() {
-  const std::string cmd = fmt::format("nohup java -jar {} -picoweb:{} > /dev/null 2>&1 &", jar_path_, picweb_port_);
-  return std::system(cmd.c_str()) == 0;
-}
-
-inline bool PlantUML::stop_picoweb_server() const {
-  std::string cmd = fmt::format("lsof -i:{}", picweb_port_);
-  cmd += " | grep \"java\" | awk -F' ' '{print $2}' | xargs kill";
-  return std::system(cmd.c_str()) == 0;
+inline std::vector<std::string> PlantUML::render_all(const std::vector<const std::vector<std::string>*>& diagrams) {
+  std::vector<std::string> svgs(diagrams.size());
+  std::atomic_size_t next {0};
+  // 工作线程不继承 thread_local 的截止时间，这里显式传入
+  const auto deadline = utils::Deadline::current();
+  const auto worker = [&](cpr::Session& session) {
+    for (size_t idx = next++; idx < diagrams.size(); idx = next++) {
+      for (uint32_t attempt = 0; attempt < retries_ && !deadline.expired(); attempt++) {
+        if (attempt > 0) {
+          std::this_thread::sleep_for(deadline.remaining(std::chrono::milliseconds(200 << attempt)));
+        }
+        session.SetTimeout(cpr::Timeout{deadline.timeout(std::chrono::seconds(5))});
+        auto [fst, snd] = diagram_desc2pic(session, *diagrams[idx]);
+        if (fst) {
+          svgs[idx] = std::move(snd);
+          break;
+        }
+      }
+    }
+  };
+  const size_t worker_num = std::min(sessions_.size(), diagrams.size());
+  std::vector<std::thread> workers;
+  for (size_t idx = 1; idx < worker_num; idx++) {
+    workers.emplace_back(worker, std::ref(*sessions_[idx]));
+  }
+  if (worker_num > 0) {
+    worker(*sessions_[0]);
+  }
+  for (auto& w : workers) {
+    w.join();
+  }
+  return svgs;
 }
 
 inline bool PlantUML::run(const MarkdownPtr& md_ptr) {
@@ -178,47 +235,71 @@ inline bool PlantUML::run(const MarkdownPtr& md_ptr) {
   if (!inited_) {
     return false;
   }
-  //
+  // 先收集未缓存的图，并发渲染后再统一替换
+  struct Target {
+    std::shared_ptr<Element>* slot;
+    std::shared_ptr<Element> codeblock;
+    std::filesystem::path svg_file_path;
+  };
+  std::vector<Target> targets;
+  std::vector<const std::vector<std::string>*> diagrams;
+  std::vector<std::string> diagram_keys;
+  std::vector<std::filesystem::path> diagram_paths;
+  auto& cache = utils::ArtifactCache::singleton();
   for (auto& ele : md_ptr->elements()) {
-    if (ele == nullptr) {
-      continue;
-    }
-    auto* codeblock = dynamic_cast<CodeBlock*>(ele.get());
+    auto cur = load_slot(ele);
+    auto* codeblock = dynamic_cast<CodeBlock*>(cur.get());
     if (codeblock == nullptr) {
       continue;
     }
     if (codeblock->lang_name != "plantuml" && codeblock->lang_name != "plantuml-svg") {
       continue;
     }
-    // WARNING: 此处不要使用 absl::Hash，因为它在不同线程中运行时使用的种子不一样，导致同样的输入，生成的哈希值会不一样。
-    auto hash_value = std::hash<std::string>{}(absl::StrJoin(codeblock->lines, "\n"));
-    auto svg_file_path = target_img_dir_ / fmt::format("{0}.svg", hash_value);
-    if (!exists(svg_file_path)) {
-      auto [fst, snd] = diagram_desc2pic(codeblock->lines);
-      if (!fst) {
-        return false;
-      }
-      std::fstream svg_file_stream;
-      svg_file_stream.open(svg_file_path, std::ios::out | std::ios::trunc);
-      if (!svg_file_stream.is_open()) {
-        spdlog::error("Failed to open plantuml svg file");
-        continue;
+    auto key = utils::ArtifactCache::make_key("PlantUML", render_version_, diagram_text(codeblock->lines));
+    auto svg_file_path = target_img_dir_ / fmt::format("{0}.svg", key);
+    if (std::find(diagram_keys.begin(), diagram_keys.end(), key) == diagram_keys.end() &&
+        !cache.publish("PlantUML", key, svg_file_path)) {
+      diagrams.push_back(&codeblock->lines);
+      diagram_keys.push_back(std::move(key));
+      diagram_paths.push_back(svg_file_path);
+    }
+    targets.push_back(Target{&ele, std::move(cur), std::move(svg_file_path)});
+  }
+  if (!diagrams.empty() && picoweb_spec_.has_value() && !SidecarManager::singleton().ensure_started(*picoweb_spec_)) {
+    spdlog::error("failure to start plantuml picoweb server");
+    return false;
+  }
+  const auto svgs = render_all(diagrams);
+  for (size_t idx = 0; idx < diagrams.size(); idx++) {
+    if (svgs[idx].empty()) {
+      if (utils::Deadline::current().expired()) {
+        utils::report_timeout("plantuml diagram " + diagram_paths[idx].filename().string());
+      } else {
+        spdlog::error("Failed to render plantuml diagram: {}", diagram_paths[idx].filename().string());
       }
-      svg_file_stream << snd;
-      svg_file_stream.flush();
-      svg_file_stream.close();
+      continue;
+    }
+    if (!cache.put("PlantUML", diagram_keys[idx], svgs[idx]) ||
+        !cache.link("PlantUML", diagram_keys[idx], diagram_paths[idx])) {
+      spdlog::error("Failed to write plantuml svg file: {}", diagram_paths[idx].string());
+    }
+  }
+  // 替换，渲染失败的图保留原代码块
+  for (const auto& target : targets) {
+    if (!exists(target.svg_file_path)) {
+      continue;
     }
-    // 替换
     auto* image_ptr = new Image();
     image_ptr->width = "";
-    image_ptr->alt_text = svg_file_path.stem();
-    image_ptr->uri = "../plantuml-images/" + svg_file_path.filename().string();
+    image_ptr->alt_text = target.svg_file_path.stem();
+    image_ptr->uri = "../plantuml-images/" + target.svg_file_path.filename().string();
+    const auto* codeblock = dynamic_cast<CodeBlock*>(target.codeblock.get());
     for (const auto& [fst, snd] : codeblock->attrs) {
       if (fst == "alt") {
         image_ptr->alt_text = snd;
       }
     }
-    ele.reset(image_ptr);
+    replace_slot(*target.slot, image_ptr);
   }
   return true;
 }
@@ -227,8 +308,8 @@ inline bool PlantUML::destroy() {
   if (!inited_) {
     return true;
   }
-  if (picoweb_server_started_) {
-    return stop_picoweb_server();
+  if (picoweb_spec_.has_value()) {
+    SidecarManager::singleton().release(picoweb_spec_->name);
   }
   return true;
 }
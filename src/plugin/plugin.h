@@ -8,6 +8,17 @@
 
 namespace ling::plugin {
 
+// 插件在文档上读写的内容，调度器据此推导插件之间的先后依赖
+enum Resource : uint32_t {
+  RES_NONE = 0,
+  RES_SOURCE = 1u << 0,      // markdown 原文与元信息（只读）
+  RES_CODE_BLOCK = 1u << 1,  // 代码块
+  RES_LATEX = 1u << 2,       // 公式块与行内公式
+  RES_IMAGE = 1u << 3,       // 图片
+  RES_HTML = 1u << 4,        // 内嵌 HTML，如构建时渲染好的 SVG
+};
+using Resources = uint32_t;
+
 class Plugin {
 public:
   virtual ~Plugin() = default;
@@ -21,6 +32,14 @@ public:
   virtual bool destroy() {
     return true;
   }
+  // 运行时读取（并可能整体替换）的文档内容
+  virtual Resources consumes() const {
+    return RES_NONE;
+  }
+  // 运行时产出或就地改写的文档内容，消费这些内容的插件会排在其后执行
+  virtual Resources produces() const {
+    return RES_NONE;
+  }
 
   bool is_initialized() const {
     return inited_;
@@ -30,6 +49,18 @@ protected:
   std::atomic_bool inited_ = false;
 };
 
+// 无依赖关系的插件会在同一文档上并发执行，遍历 elements() 等列表时，
+// 槽位的读取与替换需经由以下两个函数，避免与其他插件的读写产生数据竞争
+template<class T>
+std::shared_ptr<T> load_slot(const std::shared_ptr<T>& slot) {
+  return std::atomic_load(&slot);
+}
+
+template<class T, class V>
+void replace_slot(std::shared_ptr<T>& slot, V* value) {
+  std::atomic_store(&slot, std::shared_ptr<T>(value));
+}
+
 using PluginPtr = std::shared_ptr<Plugin>;
 using PluginPtrCreator = std::function<PluginPtr()>;
 static std::unordered_map<std::string, PluginPtrCreator> plugin_factory_m;
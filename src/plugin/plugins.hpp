@@ -6,8 +6,18 @@
 #include <fmt/std.h>
 #include <spdlog/spdlog.h>
 
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
 #include "context.hpp"
 #include "plugin.h"
+#include "sidecar.hpp"
+#include "utils/artifact_cache.hpp"
+#include "utils/deadline.hpp"
 
 // 为了执行 static 语句
 #include "zeoseven.hpp"
@@ -15,6 +25,7 @@
 #include "plantuml.hpp"
 #include "smms.hpp"
 #include "typst_cmarker_pdf.hpp"
+#include "vendor.hpp"
 #include "giscus.hpp"
 #include "highlight.hpp"
 #include "mathjax.hpp"
@@ -25,17 +36,65 @@
 
 namespace ling::plugin {
 
+/*
+ * 插件调度：
+ * 按各插件声明的 consumes/produces 构建依赖图（A 产出 B 消费的内容，则 A -> B），
+ * 互相依赖时按配置顺序；同一文档上，无依赖关系的插件并发执行。
+ * 时间预算：每个插件在一篇文档上的执行时间，以及整篇文档上全部插件的执行时间，均可设上限，
+ * 到期的插件放弃剩余条目（保留原始元素），文档预算耗尽后尚未开始的插件直接跳过。
+ */
 class Plugins final : public Plugin {
 public:
   bool init(ContextPtr& context_ptr) override;
   bool run(const MarkdownPtr& md_ptr) override;
   bool destroy() override;
 
+  // 按配置顺序加入一个已初始化的插件，加入完毕后需调用 build_graph
+  bool add(const std::string& name, const PluginPtr& plugin_ptr);
+  // 存在依赖环时返回 false，并退化为按配置顺序串行执行
+  bool build_graph();
+
+  // 时间预算，0 表示不限时；overrides 按插件名覆盖单插件预算
+  struct Budget {
+    std::chrono::milliseconds per_plugin {0};
+    std::chrono::milliseconds per_document {0};
+    std::unordered_map<std::string, std::chrono::milliseconds> overrides;
+  };
+  void set_budget(Budget budget) {
+    budget_ = std::move(budget);
+  }
+
+private:
+  struct Node {
+    std::string name;
+    PluginPtr plugin;
+    std::vector<size_t> successors;
+    uint32_t indegree{0};
+  };
+
+  bool run_one(const Node& node, const MarkdownPtr& md_ptr, const utils::Deadline& doc_deadline) const;
+  void serialize();
+
 private:
-  std::map<std::string, PluginPtr> plugins_;
+  std::vector<Node> nodes_;
+  Budget budget_;
 };
 
 inline bool Plugins::init(ContextPtr& context_ptr) {
+  const auto& raw_toml = context_ptr->with_config()->raw_toml_;
+  // 保温的 sidecar 在构建结束后继续运行，供下一次构建复用
+  SidecarManager::singleton().keep_warm(toml::find_or<bool>(raw_toml, "sidecar", "keep_warm", false));
+  utils::ArtifactCache::singleton().configure(
+      toml::find_or<std::string>(raw_toml, "artifact_cache", "dir", ".artifact_cache"),
+      toml::find_or<uint64_t>(raw_toml, "artifact_cache", "max_size_mb", 512) << 20);
+  Budget budget;
+  budget.per_plugin = std::chrono::milliseconds(toml::find_or<uint64_t>(raw_toml, "deadline", "plugin_ms", 0));
+  budget.per_document = std::chrono::milliseconds(toml::find_or<uint64_t>(raw_toml, "deadline", "document_ms", 0));
+  for (const auto& [name, ms] : toml::find_or<std::unordered_map<std::string, uint64_t>>(
+           raw_toml, "deadline", "plugins", std::unordered_map<std::string, uint64_t>{})) {
+    budget.overrides[name] = std::chrono::milliseconds(ms);
+  }
+  set_budget(std::move(budget));
   for (const auto& pn : context_ptr->with_config()->plugins) {
     if (plugin_factory_m[pn] == nullptr) {
       spdlog::error("Has no plugin named {}", pn);
@@ -46,27 +105,189 @@ inline bool Plugins::init(ContextPtr& context_ptr) {
       spdlog::error("Failed to init plugin {}", pn);
       continue;
     }
-    plugins_[pn] = plugin_ptr;
+    add(pn, plugin_ptr);
+  }
+  // 插件在 init 中注入前端片段，全部完成后统一本地化其中的 CDN 资源
+  if (!Vendor().run(context_ptr)) {
+    spdlog::warn("Some CDN resources are not vendored, fallback to the origin urls");
   }
+  build_graph();
   return true;
 }
 
-inline bool Plugins::run(const MarkdownPtr& md_ptr) {
-  for (const auto& [pn, plugin] : plugins_) {
-    if (!plugin->run(md_ptr)) {
-      spdlog::error("Failed to run plugin {0} on {}", pn);
+inline bool Plugins::add(const std::string& name, const PluginPtr& plugin_ptr) {
+  for (const auto& node : nodes_) {
+    if (node.name == name) {
+      spdlog::warn("Duplicated plugin {}", name);
+      return false;
+    }
+  }
+  nodes_.push_back(Node{name, plugin_ptr});
+  return true;
+}
+
+inline bool Plugins::build_graph() {
+  for (auto& node : nodes_) {
+    node.successors.clear();
+    node.indegree = 0;
+  }
+  const auto depends = [this](const size_t from, const size_t to) {
+    return (nodes_[from].plugin->produces() & nodes_[to].plugin->consumes()) != 0;
+  };
+  const auto add_edge = [this](const size_t from, const size_t to) {
+    nodes_[from].successors.push_back(to);
+    nodes_[to].indegree++;
+  };
+  for (size_t i = 0; i < nodes_.size(); i++) {
+    for (size_t j = i + 1; j < nodes_.size(); j++) {
+      const bool i2j = depends(i, j);
+      const bool j2i = depends(j, i);
+      if (j2i && !i2j) {
+        add_edge(j, i);
+      } else if (i2j) {
+        add_edge(i, j);  // 互相依赖时按配置顺序
+      }
+    }
+  }
+  // 检查是否有环
+  std::vector<uint32_t> indegree(nodes_.size());
+  std::vector<size_t> ready;
+  for (size_t idx = 0; idx < nodes_.size(); idx++) {
+    indegree[idx] = nodes_[idx].indegree;
+    if (indegree[idx] == 0) {
+      ready.push_back(idx);
+    }
+  }
+  size_t visited = 0;
+  while (!ready.empty()) {
+    const auto idx = ready.back();
+    ready.pop_back();
+    visited++;
+    for (const auto next : nodes_[idx].successors) {
+      if (--indegree[next] == 0) {
+        ready.push_back(next);
+      }
+    }
+  }
+  if (visited != nodes_.size()) {
+    spdlog::warn("Plugin dependencies have a cycle, fallback to run in configured order");
+    serialize();
+    return false;
+  }
+  for (const auto& node : nodes_) {
+    for (const auto next : node.successors) {
+      spdlog::debug("plugin {} -> {}", node.name, nodes_[next].name);
     }
   }
   return true;
 }
 
+inline void Plugins::serialize() {
+  for (size_t idx = 0; idx < nodes_.size(); idx++) {
+    nodes_[idx].successors.clear();
+    nodes_[idx].indegree = idx == 0 ? 0 : 1;
+    if (idx + 1 < nodes_.size()) {
+      nodes_[idx].successors.push_back(idx + 1);
+    }
+  }
+}
+
+inline bool Plugins::run_one(const Node& node, const MarkdownPtr& md_ptr, const utils::Deadline& doc_deadline) const {
+  const auto& doc_id = md_ptr->metadata().id;
+  const auto owner = node.name + "@" + doc_id;
+  if (doc_deadline.expired()) {
+    utils::TimeoutReport::singleton().add(owner, "skipped, document budget exhausted");
+    return true;
+  }
+  const auto it = budget_.overrides.find(node.name);
+  const auto deadline = utils::Deadline::earliest(
+      doc_deadline, utils::Deadline::after(it != budget_.overrides.end() ? it->second : budget_.per_plugin));
+  utils::Deadline::Scope scope(deadline, owner);
+  try {
+    const bool ok = node.plugin->run(md_ptr);
+    if (deadline.expired()) {
+      spdlog::warn("Plugin {} ran out of its time budget on {}", node.name, doc_id);
+    }
+    if (ok) {
+      return true;
+    }
+  } catch (std::exception& err) {
+    spdlog::error("Plugin {} throws error: {}", node.name, err.what());
+  }
+  spdlog::error("Failed to run plugin {} on {}", node.name, doc_id);
+  return false;
+}
+
+inline bool Plugins::run(const MarkdownPtr& md_ptr) {
+  if (md_ptr == nullptr) {
+    return false;
+  }
+  std::vector<uint32_t> pending(nodes_.size());  // 尚未完成的前驱数
+  std::mutex mtx;
+  std::condition_variable cv;
+  std::vector<size_t> finished;
+  std::vector<std::thread> workers;
+  std::atomic_bool all_ok{true};
+  const auto doc_deadline = utils::Deadline::after(budget_.per_document);
+  const auto launch = [&](const size_t idx) {
+    workers.emplace_back([&, idx] {
+      if (!run_one(nodes_[idx], md_ptr, doc_deadline)) {
+        all_ok = false;
+      }
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        finished.push_back(idx);
+      }
+      cv.notify_one();
+    });
+  };
+  for (size_t idx = 0; idx < nodes_.size(); idx++) {
+    pending[idx] = nodes_[idx].indegree;
+    if (pending[idx] == 0) {
+      launch(idx);
+    }
+  }
+  size_t done = 0;
+  while (done < nodes_.size()) {
+    std::vector<size_t> batch;
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      cv.wait(lock, [&finished] { return !finished.empty(); });
+      batch.swap(finished);
+    }
+    for (const auto idx : batch) {
+      done++;
+      for (const auto next : nodes_[idx].successors) {
+        if (--pending[next] == 0) {
+          launch(next);
+        }
+      }
+    }
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  return all_ok;
+}
+
 inline bool Plugins::destroy() {
-  for (const auto& [pn, plugin] : plugins_) {
-    if (!plugin->destroy()) {
-      spdlog::error("Failed to destroy plugin {}", pn);
+  for (const auto& node : nodes_) {
+    if (!node.plugin->destroy()) {
+      spdlog::error("Failed to destroy plugin {}", node.name);
     }
   }
+  auto& cache = utils::ArtifactCache::singleton();
+  cache.evict();
+  cache.report();
+  // 超时的条目已保留原始元素，这里汇总输出，便于调整预算或排查卡住的外部服务
+  const auto timed_out = utils::TimeoutReport::singleton().take();
+  for (const auto& [owner, item] : timed_out) {
+    spdlog::warn("timed out: {} {}", owner, item);
+  }
+  if (!timed_out.empty()) {
+    spdlog::warn("{} items timed out and were left unprocessed", timed_out.size());
+  }
   return true;
 }
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,315 @@
+#pragma once
+
+/*
+ * 插件辅助服务（sidecar）管理，如 BeMathJax 的 node 渲染服务、PlantUML 的 picoweb 服务
+ *
+ * - 按需启动：插件在第一次真正需要渲染时调用 ensure_started，全部命中缓存时不会启动
+ * - 就绪探测：轮询服务端口直到可以建立连接，子进程提前退出时立即失败，不再固定 sleep
+ * - pid 跟踪：pid 记录在 .sidecars/<name>.pid，输出写入 .sidecars/<name>.log
+ * - 保温复用：[sidecar] keep_warm = true 时，构建结束不停止 sidecar，下一次构建（如文件监听触发的重新构建）直接复用
+ * - 并发启动：每个 sidecar 各自加锁，不同插件的 sidecar 可同时冷启动，一个卡住不影响其他
+ */
+
+#include <chrono>
+#include <csignal>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <absl/strings/match.h>
+#include <absl/strings/str_join.h>
+#include <spdlog/spdlog.h>
+
+#include "utils/deadline.hpp"
+#include "utils/helper.hpp"
+#include "utils/strings.hpp"
+
+namespace ling::plugin {
+
+using std::filesystem::path;
+
+struct SidecarSpec {
+  std::string name;  // 唯一名称，同时用作 pid/log 文件名
+  std::vector<std::string> argv;
+  uint32_t port {0};  // 就绪探测端口
+  // 同时受调用线程的截止时间（Deadline::current()）限制
+  std::chrono::milliseconds ready_timeout {std::chrono::seconds(30)};
+  std::function<bool()> prepare;  // 启动前的准备工作，如写出脚本文件
+};
+
+class SidecarManager final {
+public:
+  static SidecarManager& singleton() {
+    static SidecarManager manager;
+    return manager;
+  }
+
+  SidecarManager(const SidecarManager&) = delete;
+  SidecarManager& operator=(const SidecarManager&) = delete;
+  ~SidecarManager() {
+    shutdown();
+  }
+
+  void keep_warm(const bool keep_warm) {
+    keep_warm_ = keep_warm;
+  }
+  // 确保 sidecar 已启动且就绪，优先复用本进程或上一次构建留下的进程
+  bool ensure_started(const SidecarSpec& spec);
+  // 本次构建不再需要；keep_warm 时保留进程，否则停止
+  void release(const std::string& name);
+  // 停止全部 sidecar
+  void shutdown();
+
+private:
+  SidecarManager() = default;
+
+  struct Sidecar {
+    pid_t pid {-1};
+    bool is_child {false};  // 由本进程 fork 的才能 waitpid
+  };
+  // 启动、停止期间持有 mtx，只阻塞同一 sidecar 的调用者
+  struct Entry {
+    std::mutex mtx;
+    Sidecar sidecar;
+  };
+
+  [[nodiscard]] path pid_file(const std::string& name) const {
+    return dir_ / (name + ".pid");
+  }
+  bool adopt(const SidecarSpec& spec, Sidecar& sidecar);
+  bool spawn(const SidecarSpec& spec, Sidecar& sidecar);
+  bool wait_ready(const SidecarSpec& spec, const Sidecar& sidecar) const;
+  void stop(const std::string& name, Sidecar& sidecar);
+  static bool is_alive(const Sidecar& sidecar);
+  static bool cmdline_matches(pid_t pid, const std::vector<std::string>& argv);
+
+private:
+  // 只保护 sidecars_ 的查找与增删
+  std::mutex mtx_;
+  std::unordered_map<std::string, std::shared_ptr<Entry>> sidecars_;
+  path dir_ {".sidecars"};
+  bool keep_warm_ {false};
+};
+
+inline bool SidecarManager::ensure_started(const SidecarSpec& spec) {
+  std::shared_ptr<Entry> entry;
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto& slot = sidecars_[spec.name];
+    if (slot == nullptr) {
+      slot = std::make_shared<Entry>();
+    }
+    entry = slot;
+  }
+  std::lock_guard<std::mutex> lock(entry->mtx);
+  auto& sidecar = entry->sidecar;
+  if (is_alive(sidecar)) {
+    return true;
+  }
+  std::error_code ec;
+  create_directories(dir_, ec);
+  if (adopt(spec, sidecar)) {
+    spdlog::info("reuse warm sidecar {}, pid: {}", spec.name, sidecar.pid);
+    return true;
+  }
+  // 端口已被其他进程（如没有 pid 文件的残留服务）占用时，新进程会因 EADDRINUSE 退出，就绪探测却能连上旧服务
+  if (utils::wait_tcp_port_ready(spec.port, std::chrono::milliseconds(0))) {
+    spdlog::error("port {} of sidecar {} is in use by another process", spec.port, spec.name);
+    return false;
+  }
+  if (spec.prepare && !spec.prepare()) {
+    spdlog::error("failure to prepare sidecar {}", spec.name);
+    return false;
+  }
+  const auto start = std::chrono::steady_clock::now();
+  if (!spawn(spec, sidecar)) {
+    return false;
+  }
+  if (!wait_ready(spec, sidecar)) {
+    if (utils::Deadline::current().expired()) {
+      utils::report_timeout(fmt::format("sidecar {} start", spec.name));
+    }
+    spdlog::error("sidecar {} not ready, see {}", spec.name, (dir_ / (spec.name + ".log")).string());
+    stop(spec.name, sidecar);
+    return false;
+  }
+  spdlog::info("sidecar {} ready in {}ms, pid: {}", spec.name,
+               std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count(),
+               sidecar.pid);
+  return true;
+}
+
+inline void SidecarManager::release(const std::string& name) {
+  std::shared_ptr<Entry> entry;
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    const auto it = sidecars_.find(name);
+    if (it == sidecars_.end() || keep_warm_) {
+      return;
+    }
+    entry = std::move(it->second);
+    sidecars_.erase(it);
+  }
+  // 等进行中的启动结束后再停止
+  std::lock_guard<std::mutex> lock(entry->mtx);
+  stop(name, entry->sidecar);
+}
+
+inline void SidecarManager::shutdown() {
+  std::unordered_map<std::string, std::shared_ptr<Entry>> sidecars;
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (keep_warm_) {
+      return;
+    }
+    sidecars.swap(sidecars_);
+  }
+  for (auto& [name, entry] : sidecars) {
+    std::lock_guard<std::mutex> lock(entry->mtx);
+    stop(name, entry->sidecar);
+  }
+}
+
+inline bool SidecarManager::adopt(const SidecarSpec& spec, Sidecar& sidecar) {
+  const auto pf = pid_file(spec.name);
+  if (!exists(pf)) {
+    return false;
+  }
+  Sidecar warm;
+  try {
+    warm.pid = std::stoi(utils::read_file_all(pf));
+  } catch (std::exception& err) {
+    std::filesystem::remove(pf);
+    return false;
+  }
+  if (!is_alive(warm)) {
+    std::filesystem::remove(pf);
+    return false;
+  }
+  // 参数不一致（如脚本已更新）的旧进程不能复用，且会占用端口，需先停掉
+  if (!cmdline_matches(warm.pid, spec.argv) ||
+      !utils::wait_tcp_port_ready(spec.port, utils::Deadline::current().timeout(std::chrono::seconds(1)))) {
+    spdlog::info("stop stale sidecar {}, pid: {}", spec.name, warm.pid);
+    stop(spec.name, warm);
+    return false;
+  }
+  sidecar = warm;
+  return true;
+}
+
+inline bool SidecarManager::spawn(const SidecarSpec& spec, Sidecar& sidecar) {
+  if (spec.argv.empty()) {
+    return false;
+  }
+  const auto log_path = dir_ / (spec.name + ".log");
+  std::vector<char*> args;
+  args.reserve(spec.argv.size() + 1);
+  for (const auto& arg : spec.argv) {
+    args.push_back(const_cast<char*>(arg.c_str()));
+  }
+  args.push_back(nullptr);
+  const pid_t pid = fork();
+  if (pid < 0) {
+    spdlog::error("failure to fork sidecar {}: {}", spec.name, strerror(errno));
+    return false;
+  }
+  if (pid == 0) {
+    // 独立的会话，不随终端信号一起退出；keep_warm 时可存活到下一次构建
+    setsid();
+    const int null_fd = open("/dev/null", O_RDONLY);
+    const int log_fd = open(log_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (null_fd >= 0) {
+      dup2(null_fd, STDIN_FILENO);
+    }
+    if (log_fd >= 0) {
+      dup2(log_fd, STDOUT_FILENO);
+      dup2(log_fd, STDERR_FILENO);
+    }
+    std::signal(SIGPIPE, SIG_DFL);
+    execvp(args[0], args.data());
+    _exit(127);
+  }
+  sidecar.pid = pid;
+  sidecar.is_child = true;
+  if (!utils::write_file_atomic(pid_file(spec.name), std::to_string(pid))) {
+    spdlog::warn("failure to write pid file of sidecar {}", spec.name);
+  }
+  spdlog::debug("spawn sidecar {}: {}, pid: {}", spec.name, absl::StrJoin(spec.argv, " "), pid);
+  return true;
+}
+
+inline bool SidecarManager::wait_ready(const SidecarSpec& spec, const Sidecar& sidecar) const {
+  const auto deadline = std::chrono::steady_clock::now() + utils::Deadline::current().timeout(spec.ready_timeout);
+  while (std::chrono::steady_clock::now() < deadline) {
+    if (!is_alive(sidecar)) {
+      return false;
+    }
+    if (utils::wait_tcp_port_ready(spec.port, std::chrono::milliseconds(100))) {
+      // 探测期间端口被其他进程占用时，连上的不是本进程，再确认一次子进程仍存活
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      return is_alive(sidecar);
+    }
+  }
+  return false;
+}
+
+inline void SidecarManager::stop(const std::string& name, Sidecar& sidecar) {
+  if (is_alive(sidecar)) {
+    kill(sidecar.pid, SIGTERM);
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(3);
+    while (is_alive(sidecar) && std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    if (is_alive(sidecar)) {
+      kill(sidecar.pid, SIGKILL);
+      if (sidecar.is_child) {
+        waitpid(sidecar.pid, nullptr, 0);
+      }
+    }
+    spdlog::debug("sidecar {} stopped, pid: {}", name, sidecar.pid);
+  }
+  sidecar.pid = -1;
+  std::error_code ec;
+  std::filesystem::remove(pid_file(name), ec);
+}
+
+inline bool SidecarManager::is_alive(const Sidecar& sidecar) {
+  if (sidecar.pid <= 0) {
+    return false;
+  }
+  if (sidecar.is_child) {
+    // 顺带回收已退出的子进程
+    return waitpid(sidecar.pid, nullptr, WNOHANG) == 0;
+  }
+  return kill(sidecar.pid, 0) == 0;
+}
+
+inline bool SidecarManager::cmdline_matches(const pid_t pid, const std::vector<std::string>& argv) {
+  const path cmdline_path = path("/proc") / std::to_string(pid) / "cmdline";
+  if (!exists(path("/proc/self"))) {
+    return true;  // 没有 procfs（如 macOS），只能依赖端口探测
+  }
+  std::ifstream ifs(cmdline_path, std::ios::binary);
+  if (!ifs.is_open()) {
+    return false;
+  }
+  const std::string cmdline{std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>()};
+  // argv[0] 可能被解析为绝对路径，只比较之后的参数
+  std::string expected;
+  for (size_t idx = 1; idx < argv.size(); idx++) {
+    expected.append(argv[idx]).push_back('\0');
+  }
+  return absl::EndsWith(cmdline, expected);
+}
+
+}  // namespace ling::plugin
@@ -5,13 +5,17 @@
  */
 
 /*
- * 1、从本地检测缓存状态（哪些图片已经上传，对应的 url）
- * 2、从 open api 获取上传历史
- * 3、未上传的图片通过 open api，并将状态缓存下来
+ * 1、按图片内容的 sha256 查本地索引（内容哈希 -> 上传结果），命中则不发起任何网络请求
+ * 2、本地索引中没有时，兼容按文件名+大小匹配旧的上传历史（本地缓存或 open api）
+ * 3、剩余的图片去重后并发上传，同时在途的请求数有上限，限流/服务端错误时指数退避重试，结果写回索引
  */
 
-#include <utility>
+#include <algorithm>
+#include <atomic>
 #include <filesystem>
+#include <mutex>
+#include <thread>
+#include <utility>
 
 #include <cpr/cpr.h>
 #include <spdlog/spdlog.h>
@@ -20,6 +24,9 @@
 #include <tsl/robin_set.h>
 
 #include "plugin.h"
+#include "utils/deadline.hpp"
+#include "utils/hash.hpp"
+#include "utils/helper.hpp"
 #include "utils/strings.hpp"
 
 namespace ling::plugin {
@@ -30,6 +37,7 @@ using namespace std::filesystem;
 static std::string BASE_URL = "https://sm.ms/api/v2";
 static std::string CACHE_DIR = ".smms_cache";
 static std::string UPLOAD_HISTORY_CACHE_FILE = ".upload_history.json";
+static std::string UPLOAD_INDEX_CACHE_FILE = ".upload_index.json";
 
 class SmmsUploadHistory {
 public:
@@ -94,6 +102,8 @@ public:
   HistoryVec fetch_upload_history();
   SmmsUploadResult upload(const std::string& image_path);
   SmmsUploadResult upload(const path& image_path);
+  // retryable 表示失败原因为限流、服务端错误或网络错误，稍后重试可能成功
+  SmmsUploadResult upload(const path& image_path, bool& retryable);
   bool del(const std::string& hash);
 
 private:
@@ -108,7 +118,8 @@ inline std::string SmmsOpenAPI::fetch_api_token() {
   }
   const auto url = BASE_URL + "/token";
   cpr::Response r = cpr::Post(cpr::Url{url},
-    cpr::Parameters{{"username", username_}, {"password", password_}});
+    cpr::Parameters{{"username", username_}, {"password", password_}},
+    cpr::Timeout{utils::Deadline::current().timeout(std::chrono::seconds(30))});
   if (r.status_code != 200) {
     spdlog::error("Failed to fetch api token, code: {}, resp: {}", r.status_code, r.text);
     return "";
@@ -181,6 +192,12 @@ inline SmmsUploadResult SmmsOpenAPI::upload(const std::string& image_path) {
 }
 
 inline SmmsUploadResult SmmsOpenAPI::upload(const path& image_path) {
+  bool retryable = false;
+  return upload(image_path, retryable);
+}
+
+inline SmmsUploadResult SmmsOpenAPI::upload(const path& image_path, bool& retryable) {
+  retryable = false;
   SmmsUploadResult upload_result {};
   upload_result.success = false;
   const auto api_token = fetch_api_token();
@@ -190,13 +207,26 @@ inline SmmsUploadResult SmmsOpenAPI::upload(const path& image_path) {
   cpr::Response r = cpr::Post(cpr::Url{url},
     cpr::Header{{"Content-Type", "multipart/form-data"}, {"Authorization", api_token}},
     cpr::Multipart{{"smfile", cpr::File(img_ap.string(), img_ap.filename().string())},
-      {"format", "json"}});
+      {"format", "json"}},
+    cpr::Timeout{utils::Deadline::current().timeout(std::chrono::seconds(60))});
   if (r.status_code != 200) {
+    retryable = r.status_code == 0 || r.status_code == 429 || r.status_code >= 500;
     spdlog::error("Failed to upload, status_code: {}, resp: {}, image path: {}, image name: {}",
       r.status_code, r.text, img_ap.string(), img_ap.filename().string());
     return upload_result;
   }
-  const auto rj = json::parse(r.text);
+  const auto rj = json::parse(r.text, nullptr, false);
+  if (rj.is_discarded()) {
+    spdlog::error("Failed to upload image, illegal resp: {}, image path: {}", r.text, img_ap.string());
+    return upload_result;
+  }
+  // 同样内容的图片已上传过，服务端直接给出已有的链接
+  if (rj.value("code", "") == "image_repeated" && rj.contains("images") && rj["images"].is_string()) {
+    upload_result.success = true;
+    upload_result.history.file_name = img_ap.filename().string();
+    upload_result.history.url = rj["images"].get<std::string>();
+    return upload_result;
+  }
   if (!rj.contains("success") || !rj["success"].is_boolean() || !rj["success"].get<bool>() ||
       !rj.contains("data") || !rj["data"].is_object()) {
     spdlog::error("Failed to upload image, resp: {}, image path: {}, image name: {}",
@@ -231,16 +261,34 @@ public:
   bool init(ContextPtr& context_ptr) override;
   bool run(const MarkdownPtr& md_ptr) override;
   bool destroy() override;
+  // 就地改写图片链接，需排在产出图片的插件之后
+  Resources consumes() const override {
+    return RES_IMAGE;
+  }
+  Resources produces() const override {
+    return RES_IMAGE;
+  }
 
 private:
   bool load_upload_history();
   bool cache_upload_history();
+  bool load_upload_index();
+  bool cache_upload_index();
+  // 先查内容哈希索引，再按文件名+大小兼容旧的上传历史
+  bool lookup(const std::string& content_hash, const path& img_path, SmmsUploadHistory& history);
+  // 并发上传，返回结果与 img_paths 一一对应
+  std::vector<SmmsUploadResult> upload_all(const std::vector<path>& img_paths);
 
 private:
   ConfigPtr config_;
   SmmsOpenAPI api_;
+  uint32_t max_inflight_ {4};
+  uint32_t retries_ {4};
+  uint32_t backoff_ms_ {500};
   //
+  std::mutex mtx_;
   tsl::robin_map<std::string, SmmsUploadHistory> upload_history_;
+  tsl::robin_map<std::string, SmmsUploadHistory> upload_index_;
   tsl::robin_set<std::string> smms_supported_exts {".jpg", ".jpeg", ".png", ".webp", ".gif", ".bmp"};
 };
 
@@ -262,9 +310,13 @@ inline bool Smms::init(ContextPtr& context_ptr) {
     api_ = SmmsOpenAPI{};
     api_.set_api_token(api_token);
   }
+  max_inflight_ = std::max(1u, toml::find_or<uint32_t>(config_->raw_toml_, "smms", "max_inflight", 4));
+  retries_ = std::max(1u, toml::find_or<uint32_t>(config_->raw_toml_, "smms", "retries", 4));
+  backoff_ms_ = toml::find_or<uint32_t>(config_->raw_toml_, "smms", "backoff_ms", 500);
   try {
+    load_upload_index();
     load_upload_history();
-  } catch (std::runtime_error& err) {
+  } catch (std::exception& err) {
     spdlog::error("Plugin Smms init error: {}", err.what());
     return false;
   }
@@ -275,11 +327,17 @@ inline bool Smms::run(const MarkdownPtr& md_ptr) {
   if (!inited_) {
     return false;
   }
+  // 先收集需要上传的图片（按内容去重），并发上传后再统一改写链接
+  struct Target {
+    std::shared_ptr<Element> image;
+    std::string content_hash;
+  };
+  std::vector<Target> targets;
+  std::vector<std::string> pending_hashes;
+  std::vector<path> pending_paths;
   for (const auto& ele : md_ptr->elements()) {
-    if (ele == nullptr) {
-      continue;
-    }
-    auto* img_ptr = dynamic_cast<Image*>(ele.get());
+    auto cur = load_slot(ele);
+    auto* img_ptr = dynamic_cast<Image*>(cur.get());
     if (img_ptr == nullptr) {
       continue;
     }
@@ -297,24 +355,142 @@ inline bool Smms::run(const MarkdownPtr& md_ptr) {
       spdlog::info("Smms not support this image type, skip image: {}", img_path.string());
       continue;
     }
-    auto img_file_name = img_path.filename().string();
-    if (upload_history_.contains(img_file_name)) {
-      img_ptr->uri = upload_history_[img_file_name].url;
+    std::error_code ec;
+    if (!is_regular_file(img_path, ec)) {
+      spdlog::warn("Smms image not found, skip image: {}", img_path.string());
       continue;
     }
-    const auto& r = api_.upload(img_path);
-    if (!r.success) {
+    auto content_hash = utils::sha256_hex(utils::read_file_all(img_path));
+    SmmsUploadHistory history;
+    if (lookup(content_hash, img_path, history)) {
+      img_ptr->uri = history.url;
       continue;
     }
-    spdlog::info("success to upload image:{}, smms url: {}", uri, r.history.url);
-    upload_history_[img_file_name] = r.history;
-    img_ptr->uri = r.history.url;
+    if (std::find(pending_hashes.begin(), pending_hashes.end(), content_hash) == pending_hashes.end()) {
+      pending_hashes.push_back(content_hash);
+      pending_paths.push_back(img_path);
+    }
+    targets.push_back(Target{std::move(cur), std::move(content_hash)});
+  }
+  if (pending_paths.empty()) {
+    return true;
+  }
+  const auto results = upload_all(pending_paths);
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (size_t idx = 0; idx < results.size(); idx++) {
+      if (!results[idx].success) {
+        if (utils::Deadline::current().expired()) {
+          utils::report_timeout("smms image " + pending_paths[idx].string());
+        }
+        continue;
+      }
+      spdlog::info("success to upload image:{}, smms url: {}", pending_paths[idx].string(), results[idx].history.url);
+      upload_index_[pending_hashes[idx]] = results[idx].history;
+    }
+  }
+  for (const auto& target : targets) {
+    const auto idx = std::find(pending_hashes.begin(), pending_hashes.end(), target.content_hash) - pending_hashes.begin();
+    if (results[idx].success) {
+      dynamic_cast<Image*>(target.image.get())->uri = results[idx].history.url;
+    }
+  }
+  return true;
+}
+
+inline bool Smms::lookup(const std::string& content_hash, const path& img_path, SmmsUploadHistory& history) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  if (const auto it = upload_index_.find(content_hash); it != upload_index_.end()) {
+    history = it->second;
+    return true;
+  }
+  // 旧的上传历史只有文件名，大小也一致时才认为是同一张图，并迁移到索引中
+  const auto it = upload_history_.find(img_path.filename().string());
+  std::error_code ec;
+  if (it == upload_history_.end() || it->second.size != file_size(img_path, ec)) {
+    return false;
   }
+  history = it->second;
+  upload_index_[content_hash] = history;
   return true;
 }
 
+inline std::vector<SmmsUploadResult> Smms::upload_all(const std::vector<path>& img_paths) {
+  std::vector<SmmsUploadResult> results(img_paths.size());
+  // 先取得 token，避免各线程并发获取
+  if (api_.fetch_api_token().empty()) {
+    return results;
+  }
+  std::atomic_size_t next {0};
+  const auto deadline = utils::Deadline::current();
+  const auto owner = utils::Deadline::current_owner();
+  const auto worker = [&] {
+    // 上传请求以当前线程的截止时间为超时
+    utils::Deadline::Scope scope(deadline, owner);
+    for (size_t idx = next++; idx < img_paths.size(); idx = next++) {
+      for (uint32_t attempt = 0; attempt < retries_ && !deadline.expired(); attempt++) {
+        if (attempt > 0) {
+          std::this_thread::sleep_for(deadline.remaining(std::chrono::milliseconds(backoff_ms_ << (attempt - 1))));
+        }
+        bool retryable = false;
+        results[idx] = api_.upload(img_paths[idx], retryable);
+        if (results[idx].success || !retryable) {
+          break;
+        }
+        spdlog::warn("Smms upload throttled or failed, retry later: {}", img_paths[idx].string());
+      }
+    }
+  };
+  const size_t worker_num = std::min<size_t>(max_inflight_, img_paths.size());
+  std::vector<std::thread> workers;
+  for (size_t idx = 1; idx < worker_num; idx++) {
+    workers.emplace_back(worker);
+  }
+  worker();
+  for (auto& w : workers) {
+    w.join();
+  }
+  return results;
+}
+
 inline bool Smms::destroy() {
-  return cache_upload_history();
+  if (!inited_) {
+    return true;
+  }
+  const bool index_ok = cache_upload_index();
+  return cache_upload_history() && index_ok;
+}
+
+inline bool Smms::load_upload_index() {
+  const path index_fp = path(CACHE_DIR) / UPLOAD_INDEX_CACHE_FILE;
+  if (!exists(index_fp)) {
+    return true;
+  }
+  const auto ji = json::parse(utils::read_file_all(index_fp), nullptr, false);
+  if (!ji.is_object()) {
+    spdlog::warn("Ignore broken smms upload index {}", index_fp.string());
+    return false;
+  }
+  for (const auto& [content_hash, j] : ji.items()) {
+    upload_index_[content_hash].from(j);
+  }
+  return true;
+}
+
+inline bool Smms::cache_upload_index() {
+  json ji = json::object();
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (const auto& [fst, snd] : upload_index_) {
+      snd.to(ji[fst]);
+    }
+  }
+  const path index_fp = path(CACHE_DIR) / UPLOAD_INDEX_CACHE_FILE;
+  if (!utils::write_file_atomic(index_fp, ji.dump(2))) {
+    spdlog::error("Failed to write cache file {}", index_fp.string());
+    return false;
+  }
+  return true;
 }
 
 inline bool Smms::load_upload_history() {
@@ -370,4 +546,4 @@ inline bool Smms::cache_upload_history() {
 
 static PluginRegister<Smms> smms_register_ {"Smms"};
 
-}
\ No newline at end of file
+}
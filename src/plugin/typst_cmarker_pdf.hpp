@@ -2,11 +2,23 @@
 
 #include "plugin.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <fstream>
 #include <filesystem>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
 
 #include <spdlog/spdlog.h>
 
+#include "utils/artifact_cache.hpp"
+#include "utils/deadline.hpp"
+#include "utils/helper.hpp"
+#include "utils/subprocess.hpp"
+
 namespace ling::plugin {
 
 using std::filesystem::path;
@@ -19,8 +31,10 @@ static bool is_typst_exist() {
   return system("which typst > /dev/null 2>&1") == 0;
 }
 
-static bool typst_compile(const std::string& input_file, const std::string& output_file) {
-  return system(fmt::format("typst compile {} {}", input_file, output_file).c_str()) == 0;
+// 超时后杀掉 typst 进程，timeout 为 0 表示不限时
+static bool typst_compile(const std::string& input_file, const std::string& output_file,
+                          const std::chrono::milliseconds timeout) {
+  return utils::run_shell(fmt::format("typst compile '{}' '{}'", input_file, output_file), timeout) == 0;
 }
 
 static void with_public_permission(path p) {
@@ -33,10 +47,25 @@ public:
   bool init(ContextPtr& context_ptr) override;
   bool run(const MarkdownPtr& md_ptr) override;
   bool destroy() override;
+  // 只读取原文，可与其他插件并发执行
+  Resources consumes() const override {
+    return RES_SOURCE;
+  }
 
 private:
-  bool make_typst_wrapper_file();
-  bool make_tmp_post_file(const MarkdownPtr& md_ptr) const;
+  // 每个任务一个独立的工作目录，按任务序号命名，编译任务之间互不干扰；id 只用于命名输出的 PDF
+  struct Job {
+    std::string id;
+    path workspace;
+    path output;
+    std::string cache_key;
+    // 编译在 run 返回后异步进行，超时时以提交任务的插件归属上报
+    std::string owner;
+  };
+
+  bool make_workspace(const Job& job, const std::string& post_content) const;
+  void ensure_workers_started();
+  void compile(const Job& job);
 
 private:
   path root_path;
@@ -45,37 +74,45 @@ private:
   path tmp_dir = "tmp_typst_build";
   std::string typst_wrapper_file_name = "md2pdf.typ";
   std::string tmp_md_file_name = "tmp_post.md";
+  // typst 版本与模板参与缓存键，任意一项变化都会重新编译
+  std::string typst_version_;
+  std::string wrapper_content_;
+  //
+  uint32_t max_jobs_ {2};
+  // 单篇文章的编译时间上限
+  std::chrono::milliseconds compile_timeout_ {0};
+  std::mutex jobs_mtx_;
+  std::condition_variable jobs_cv_;
+  std::deque<Job> jobs_;
+  bool closed_ {false};
+  std::vector<std::thread> workers_;
+  std::atomic_uint64_t next_job_ {0};
+  std::atomic_uint32_t compiled_ {0};
+  std::atomic_uint32_t failed_ {0};
 };
 
-inline bool TypstCmarkerPdf::make_typst_wrapper_file() {
-  const auto& typst_content = fmt::format(typst_template, text_fonts, tmp_md_file_name);
-  spdlog::debug("typst_content: {}", typst_content);
-  std::ofstream typst_fstream(tmp_dir / typst_wrapper_file_name);
-  if (!typst_fstream.is_open()) {
-    spdlog::error("Failed to open file: {}", (tmp_dir/typst_wrapper_file_name).string());
+// 重建工作目录并写入 files（文件名 -> 内容）。被中断或崩溃的构建会留下同名目录，先整体删除，否则 write_file 会失败
+static bool reset_workspace(const path& workspace, const std::vector<std::pair<std::string, std::string>>& files) {
+  std::error_code ec;
+  remove_all(workspace, ec);
+  if (ec || !create_directories(workspace, ec)) {
+    spdlog::error("Failed to create workspace: {}, {}", workspace.string(), ec.message());
     return false;
   }
-  typst_fstream << typst_content;
-  typst_fstream.flush();
-  typst_fstream.close();
-  return true;
-}
-
-inline bool TypstCmarkerPdf::make_tmp_post_file(const MarkdownPtr& md_ptr) const {
-  const auto& body = md_ptr->body_part();
-  std::ofstream tmp_post_fstream(tmp_dir / tmp_md_file_name, std::ios::trunc);
-  if (!tmp_post_fstream.is_open()) {
-    spdlog::error("Failed to open file: {}", (tmp_dir / tmp_md_file_name).string());
-    return false;
+  with_public_permission(workspace);
+  for (const auto& [name, content] : files) {
+    if (!utils::write_file(workspace / name, content)) {
+      spdlog::error("Failed to open file: {}", (workspace / name).string());
+      return false;
+    }
+    with_public_permission(workspace / name);
   }
-  tmp_post_fstream << "# " + md_ptr->metadata().title + "\n\n";
-  tmp_post_fstream << body;
-  tmp_post_fstream.flush();
-  tmp_post_fstream.close();
-  with_public_permission(tmp_dir / tmp_md_file_name);
   return true;
 }
 
+inline bool TypstCmarkerPdf::make_workspace(const Job& job, const std::string& post_content) const {
+  return reset_workspace(job.workspace, {{typst_wrapper_file_name, wrapper_content_}, {tmp_md_file_name, post_content}});
+}
 
 inline bool TypstCmarkerPdf::init(ContextPtr& context_ptr) {
   if (!Plugin::init(context_ptr)) {
@@ -92,12 +129,18 @@ inline bool TypstCmarkerPdf::init(ContextPtr& context_ptr) {
     spdlog::error("Please specify a text font for typst");
     return false;
   }
+  const auto default_jobs = std::max(1u, std::thread::hardware_concurrency() / 2);
+  max_jobs_ = std::max(1u, toml::find_or<uint32_t>(config_ptr->raw_toml_, "typst_pdf", "max_jobs", default_jobs));
+  compile_timeout_ =
+      std::chrono::seconds(toml::find_or<uint32_t>(config_ptr->raw_toml_, "typst_pdf", "timeout_sec", 120));
+  typst_version_ = utils::get_cmd_stdout("typst --version");
+  wrapper_content_ = fmt::format(typst_template, text_fonts, tmp_md_file_name);
+  spdlog::debug("typst_content: {}", wrapper_content_);
   try {
     if (!exists(tmp_dir)) {
       create_directory(tmp_dir);
       with_public_permission(tmp_dir);
     }
-    make_typst_wrapper_file();
     if (!exists(output_dir)) {
       create_directory(output_dir);
       with_public_permission(output_dir);
@@ -110,31 +153,104 @@ inline bool TypstCmarkerPdf::init(ContextPtr& context_ptr) {
   return true;
 }
 
+// 只负责准备工作目录并提交编译任务，PDF 不参与后续渲染，destroy 时等待全部完成
 inline bool TypstCmarkerPdf::run(const MarkdownPtr& md_ptr) {
-  if (!make_tmp_post_file(md_ptr)) {
+  Job job;
+  job.id = md_ptr->metadata().id;
+  if (job.id.empty()) {
+    spdlog::warn("TypstCmarkerPdf skip post without id: {}", md_ptr->metadata().title);
+    return true;
+  }
+  const auto post_content = "# " + md_ptr->metadata().title + "\n\n" + md_ptr->body_part();
+  // 不用 id 命名：重复的 id 会让两个任务共用并互删同一个目录
+  job.workspace = tmp_dir / fmt::format("job-{}", next_job_++);
+  job.output = output_dir / (job.id + ".pdf");
+  job.owner = utils::Deadline::current_owner();
+  job.cache_key = utils::ArtifactCache::make_key("TypstCmarkerPdf", typst_version_ + "\n" + wrapper_content_,
+                                                 post_content);
+  // 内容与模板都没变，直接复用上次的 PDF
+  if (utils::ArtifactCache::singleton().publish("TypstCmarkerPdf", job.cache_key, job.output, true)) {
+    spdlog::debug("pdf unchanged, skip post: {}", job.id);
+    return true;
+  }
+  if (!make_workspace(job, post_content)) {
     return false;
   }
-  const path output_file_path = output_dir / (md_ptr->metadata().id + ".pdf");
-  const auto status = typst_compile(tmp_dir / typst_wrapper_file_name, output_file_path.string());
-  if (!status) {
-    spdlog::error("Failed to generate pdf for post: {}", md_ptr->metadata().id);
+  ensure_workers_started();
+  {
+    std::lock_guard<std::mutex> lock(jobs_mtx_);
+    jobs_.push_back(std::move(job));
   }
-  return status;
+  jobs_cv_.notify_one();
+  return true;
+}
+
+inline void TypstCmarkerPdf::ensure_workers_started() {
+  std::lock_guard<std::mutex> lock(jobs_mtx_);
+  if (!workers_.empty()) {
+    return;
+  }
+  for (uint32_t idx = 0; idx < max_jobs_; idx++) {
+    workers_.emplace_back([this] {
+      while (true) {
+        Job job;
+        {
+          std::unique_lock<std::mutex> lock(jobs_mtx_);
+          jobs_cv_.wait(lock, [this] {
+            return closed_ || !jobs_.empty();
+          });
+          if (jobs_.empty()) {
+            return;
+          }
+          job = std::move(jobs_.front());
+          jobs_.pop_front();
+        }
+        compile(job);
+      }
+    });
+  }
+}
+
+inline void TypstCmarkerPdf::compile(const Job& job) {
+  const auto pdf_path = job.workspace / (job.id + ".pdf");
+  auto& cache = utils::ArtifactCache::singleton();
+  const auto start = std::chrono::steady_clock::now();
+  if (!typst_compile((job.workspace / typst_wrapper_file_name).string(), pdf_path.string(), compile_timeout_)) {
+    if (compile_timeout_.count() > 0 && std::chrono::steady_clock::now() - start >= compile_timeout_) {
+      utils::TimeoutReport::singleton().add(job.owner, "typst compile");
+    }
+    spdlog::error("Failed to generate pdf for post: {}", job.id);
+    failed_++;
+  } else if (!cache.put_file("TypstCmarkerPdf", job.cache_key, pdf_path) ||
+      !cache.link("TypstCmarkerPdf", job.cache_key, job.output)) {
+    spdlog::error("Failed to generate pdf for post: {}", job.id);
+    failed_++;
+  } else {
+    compiled_++;
+  }
+  std::error_code ec;
+  remove_all(job.workspace, ec);
 }
 
 inline bool TypstCmarkerPdf::destroy() {
-  if (exists(tmp_dir / tmp_md_file_name)) {
-    std::filesystem::remove(tmp_dir / tmp_md_file_name);
+  {
+    std::lock_guard<std::mutex> lock(jobs_mtx_);
+    closed_ = true;
+  }
+  jobs_cv_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
   }
-  if (exists(tmp_dir / typst_wrapper_file_name)) {
-    std::filesystem::remove(tmp_dir / typst_wrapper_file_name);
+  workers_.clear();
+  if (compiled_ + failed_ > 0) {
+    spdlog::info("TypstCmarkerPdf compiled: {}, failed: {}", compiled_.load(), failed_.load());
   }
   if (exists(tmp_dir)) {
     remove_all(tmp_dir);
   }
-  return true;
+  return failed_ == 0;
 }
 
 static PluginRegister<TypstCmarkerPdf> typst_cmarker_pdf_register_ {"TypstCmarkerPdf"};
 
-}
\ No newline at end of file
+}
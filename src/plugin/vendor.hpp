@@ -0,0 +1,324 @@
+#pragma once
+
+/*
+ * 将插件注入页面的第三方 CSS/JS/字体下载到本地，从自己的域名提供，减少首屏的 DNS/TLS/建连开销与外部故障
+ *
+ * - 可选：[vendor] enable = true 时，在全部插件 init 之后、渲染模板之前执行
+ * - 下载：经产物缓存按 URL 缓存，只下载一次；CSS 中 url(...) 引用的字体等资源一并下载，并改写为本地路径
+ * - 落盘：vendor/<内容哈希><扩展名>，copy_assets 会将其复制到 dist，内容不变则文件名不变，可长期缓存
+ * - 改写：FeInjectPos 片段中的 URL 替换为 /vendor/...，并去掉对应标签上的 integrity/crossorigin 属性
+ * - 排除：依赖自身来源地址的脚本（如 giscus 的 client.js 以脚本地址推断 iframe 地址、MathJax 按脚本地址加载组件）
+ *   不能本地化，默认排除，可通过 [vendor] exclude 配置
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <absl/strings/match.h>
+#include <absl/strings/str_join.h>
+#include <absl/strings/str_replace.h>
+#include <absl/strings/str_split.h>
+#include <cpr/cpr.h>
+#include <spdlog/spdlog.h>
+#include <tsl/robin_map.h>
+
+#include "context.hpp"
+#include "utils/artifact_cache.hpp"
+#include "utils/hash.hpp"
+#include "utils/helper.hpp"
+
+namespace ling::plugin {
+
+class Vendor final {
+public:
+  bool run(ContextPtr& context_ptr);
+
+  // 提取片段中 src="..."、href="..."、url(...) 引用的地址
+  static std::vector<std::string> extract_urls(const std::string& snippet);
+  // 将 CSS 中的相对引用解析为绝对地址
+  static std::string resolve_url(const std::string& base, const std::string& ref);
+
+private:
+  static bool is_asset_ext(const std::string& ext) {
+    static const std::vector<std::string> exts = {".css", ".js",  ".mjs", ".woff", ".woff2", ".ttf", ".otf",
+                                                  ".eot", ".svg", ".png", ".jpg",  ".gif",   ".webp"};
+    return std::find(exts.begin(), exts.end(), ext) != exts.end();
+  }
+  bool excluded(const std::string& url) const;
+  // 下载到本地，返回 vendor 目录下的文件名，失败时返回空串
+  std::string localize(const std::string& url, uint32_t depth);
+  // 并发预取，结果进入产物缓存
+  void prefetch(const std::vector<std::string>& urls);
+  bool fetch(const std::string& url, std::string& content);
+  std::string save(const std::string& url, const std::string& content) const;
+  static std::string rewrite_snippet(const std::string& snippet, const tsl::robin_map<std::string, std::string>& m);
+
+private:
+  std::filesystem::path public_dir_ {"vendor"};
+  std::string url_prefix_ {"/vendor/"};
+  std::vector<std::string> excludes_;
+  uint32_t max_inflight_ {8};
+  uint32_t timeout_sec_ {30};
+  //
+  std::mutex mtx_;
+  tsl::robin_map<std::string, std::string> localized_;
+};
+
+inline bool Vendor::run(ContextPtr& context_ptr) {
+  const auto& raw_toml = context_ptr->with_config()->raw_toml_;
+  if (!toml::find_or<bool>(raw_toml, "vendor", "enable", false)) {
+    return true;
+  }
+  public_dir_ = toml::find_or<std::string>(raw_toml, "vendor", "dir", "vendor");
+  url_prefix_ = "/" + public_dir_.filename().string() + "/";
+  excludes_ = toml::find_or<std::vector<std::string>>(raw_toml, "vendor", "exclude",
+                                                      std::vector<std::string>{"giscus.app", "mathjax"});
+  max_inflight_ = std::max(1u, toml::find_or<uint32_t>(raw_toml, "vendor", "max_inflight", 8));
+  timeout_sec_ = toml::find_or<uint32_t>(raw_toml, "vendor", "timeout_sec", 30);
+  if (!exists(public_dir_)) {
+    create_directories(public_dir_);
+  }
+  auto& render_ctx = context_ptr->with_render_ctx();
+  const FeInjectPos positions[] = {FeInjectPos::PLUGIN_HEAD_PARTS, FeInjectPos::PLUGIN_AFTER_POST_CONTENT_PARTS,
+                                   FeInjectPos::PLUGIN_AFTER_FOOTER_PARTS, FeInjectPos::PLUGIN_CLIENT_HIGHLIGHT_PARTS};
+  std::vector<std::string> urls;
+  for (const auto pos : positions) {
+    for (const auto& snippet : render_ctx[to_string(pos)]) {
+      for (auto& url : extract_urls(snippet.get<std::string>())) {
+        if (!excluded(url) && std::find(urls.begin(), urls.end(), url) == urls.end()) {
+          urls.push_back(std::move(url));
+        }
+      }
+    }
+  }
+  prefetch(urls);
+  tsl::robin_map<std::string, std::string> url2local;
+  for (const auto& url : urls) {
+    if (auto local = localize(url, 0); !local.empty()) {
+      url2local[url] = url_prefix_ + local;
+    }
+  }
+  for (const auto pos : positions) {
+    for (auto& snippet : render_ctx[to_string(pos)]) {
+      snippet = rewrite_snippet(snippet.get<std::string>(), url2local);
+    }
+  }
+  spdlog::info("vendored {}/{} resources into {}", url2local.size(), urls.size(), public_dir_.string());
+  return url2local.size() == urls.size();
+}
+
+inline std::vector<std::string> Vendor::extract_urls(const std::string& snippet) {
+  std::vector<std::string> urls;
+  const auto collect = [&](const absl::string_view opener, const absl::string_view closers) {
+    size_t pos = 0;
+    while ((pos = snippet.find(opener.data(), pos, opener.size())) != std::string::npos) {
+      pos += opener.size();
+      // url( 后可能有引号
+      while (pos < snippet.size() && (snippet[pos] == '"' || snippet[pos] == '\'' || snippet[pos] == ' ')) {
+        pos++;
+      }
+      const auto end = snippet.find_first_of(closers.data(), pos, closers.size());
+      if (end == std::string::npos) {
+        break;
+      }
+      auto url = snippet.substr(pos, end - pos);
+      // 只处理静态资源，避免把 <a href> 之类的页面链接也下载下来
+      const auto ext = std::filesystem::path(url.substr(0, url.find_first_of("?#"))).extension().string();
+      if ((absl::StartsWith(url, "https://") || absl::StartsWith(url, "http://")) && is_asset_ext(ext)) {
+        urls.push_back(std::move(url));
+      }
+      pos = end;
+    }
+  };
+  collect("src=\"", "\"");
+  collect("href=\"", "\"");
+  collect("url(", "\"') ");
+  return urls;
+}
+
+inline std::string Vendor::resolve_url(const std::string& base, const std::string& ref) {
+  if (absl::StartsWith(ref, "https://") || absl::StartsWith(ref, "http://")) {
+    return ref;
+  }
+  const auto scheme_end = base.find("://");
+  if (scheme_end == std::string::npos) {
+    return ref;
+  }
+  if (absl::StartsWith(ref, "//")) {
+    return base.substr(0, scheme_end + 1) + ref;
+  }
+  const auto host_end = base.find('/', scheme_end + 3);
+  const auto origin = base.substr(0, host_end);
+  if (absl::StartsWith(ref, "/")) {
+    return origin + ref;
+  }
+  // 相对路径：基于 base 所在目录，逐段处理 . 与 ..
+  std::vector<std::string> segments;
+  if (host_end != std::string::npos) {
+    const auto base_path = base.substr(host_end + 1, base.find_first_of("?#", host_end) - host_end - 1);
+    segments = absl::StrSplit(base_path, '/');
+    segments.pop_back();
+  }
+  for (const auto& seg : absl::StrSplit(ref, '/')) {
+    if (seg == "..") {
+      if (!segments.empty()) {
+        segments.pop_back();
+      }
+    } else if (seg != ".") {
+      segments.emplace_back(seg);
+    }
+  }
+  return origin + "/" + absl::StrJoin(segments, "/");
+}
+
+inline bool Vendor::excluded(const std::string& url) const {
+  return std::any_of(excludes_.begin(), excludes_.end(), [&](const std::string& pattern) {
+    return !pattern.empty() && url.find(pattern) != std::string::npos;
+  });
+}
+
+inline bool Vendor::fetch(const std::string& url, std::string& content) {
+  auto& cache = utils::ArtifactCache::singleton();
+  // 按 URL 缓存：带版本号的 CDN 地址内容不变，不带版本号的也只在缓存被淘汰后才重新下载
+  const auto key = utils::ArtifactCache::make_key("Vendor", "1", url);
+  if (cache.get("Vendor", key, content)) {
+    return true;
+  }
+  const auto r = cpr::Get(cpr::Url{url}, cpr::Timeout{std::chrono::seconds(timeout_sec_)});
+  if (r.status_code != 200) {
+    spdlog::warn("failure to vendor {}, status_code: {}, err msg: {}", url, r.status_code, r.error.message);
+    return false;
+  }
+  content = r.text;
+  cache.put("Vendor", key, content);
+  return true;
+}
+
+inline void Vendor::prefetch(const std::vector<std::string>& urls) {
+  std::atomic_size_t next {0};
+  const auto worker = [&] {
+    for (size_t idx = next++; idx < urls.size(); idx = next++) {
+      std::string content;
+      fetch(urls[idx], content);
+    }
+  };
+  const size_t worker_num = std::min<size_t>(max_inflight_, urls.size());
+  std::vector<std::thread> workers;
+  for (size_t idx = 1; idx < worker_num; idx++) {
+    workers.emplace_back(worker);
+  }
+  if (worker_num > 0) {
+    worker();
+  }
+  for (auto& w : workers) {
+    w.join();
+  }
+}
+
+inline std::string Vendor::save(const std::string& url, const std::string& content) const {
+  const auto url_path = url.substr(0, url.find_first_of("?#"));
+  auto ext = std::filesystem::path(url_path).extension().string();
+  if (ext.size() > 8) {
+    ext.clear();
+  }
+  auto file_name = utils::sha256_hex(content).substr(0, 16) + ext;
+  const auto file_path = public_dir_ / file_name;
+  if (!exists(file_path) && !utils::write_file_atomic(file_path, content)) {
+    spdlog::warn("failure to write vendor file {}", file_path.string());
+    return "";
+  }
+  return file_name;
+}
+
+inline std::string Vendor::localize(const std::string& url, const uint32_t depth) {
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (const auto it = localized_.find(url); it != localized_.end()) {
+      return it->second;
+    }
+  }
+  std::string content;
+  if (!fetch(url, content)) {
+    return "";
+  }
+  const auto url_path = url.substr(0, url.find_first_of("?#"));
+  // CSS 引用的字体、图片、@import 一并本地化，同在 vendor 目录下，改写为文件名即可
+  if (absl::EndsWith(url_path, ".css") && depth < 2) {
+    std::vector<std::pair<std::string, std::string>> refs;
+    size_t pos = 0;
+    while ((pos = content.find("url(", pos)) != std::string::npos) {
+      pos += 4;
+      while (pos < content.size() && (content[pos] == '"' || content[pos] == '\'' || content[pos] == ' ')) {
+        pos++;
+      }
+      const auto end = content.find_first_of("\"') ", pos);
+      if (end == std::string::npos) {
+        break;
+      }
+      auto ref = content.substr(pos, end - pos);
+      pos = end;
+      if (ref.empty() || absl::StartsWith(ref, "data:") || absl::StartsWith(ref, "#")) {
+        continue;
+      }
+      auto abs_url = resolve_url(url, ref);
+      if (!excluded(abs_url)) {
+        refs.emplace_back(std::move(ref), std::move(abs_url));
+      }
+    }
+    std::vector<std::string> abs_urls;
+    for (const auto& [ref, abs_url] : refs) {
+      abs_urls.push_back(abs_url);
+    }
+    prefetch(abs_urls);
+    std::vector<std::pair<std::string, std::string>> replacements;
+    for (const auto& [ref, abs_url] : refs) {
+      if (auto local = localize(abs_url, depth + 1); !local.empty()) {
+        replacements.emplace_back("(" + ref, "(" + local);
+        replacements.emplace_back("\"" + ref + "\"", "\"" + local + "\"");
+        replacements.emplace_back("'" + ref + "'", "'" + local + "'");
+      }
+    }
+    content = absl::StrReplaceAll(content, replacements);
+  }
+  auto local = save(url, content);
+  if (!local.empty()) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    localized_[url] = local;
+  }
+  return local;
+}
+
+inline std::string Vendor::rewrite_snippet(const std::string& snippet,
+                                           const tsl::robin_map<std::string, std::string>& m) {
+  std::string out = snippet;
+  for (const auto& [url, local] : m) {
+    size_t pos = 0;
+    while ((pos = out.find(url, pos)) != std::string::npos) {
+      out.replace(pos, url.size(), local);
+      pos += local.size();
+      // 本地文件内容与 CDN 上的不同（CSS 中的引用已改写），integrity 校验会失败，同源也无需 crossorigin
+      const auto tag_begin = out.rfind('<', pos);
+      const auto tag_end = out.find('>', pos);
+      if (tag_begin == std::string::npos || tag_end == std::string::npos || out.find('>', tag_begin) < pos) {
+        continue;
+      }
+      auto tag = out.substr(tag_begin, tag_end - tag_begin);
+      const auto tag_size = tag.size();
+      for (const std::string attr : {" integrity=\"", " crossorigin=\""}) {
+        if (const auto attr_pos = tag.find(attr); attr_pos != std::string::npos) {
+          tag.erase(attr_pos, tag.find('"', attr_pos + attr.size()) + 1 - attr_pos);
+        }
+      }
+      out.replace(tag_begin, tag_size, tag);
+      pos = tag_begin + tag.size();
+    }
+  }
+  return out;
+}
+
+}  // namespace ling::plugin
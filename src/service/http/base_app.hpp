@@ -17,6 +17,9 @@ protected:
   virtual bool prepare() = 0;
   virtual std::pair<std::string, int> host_port() = 0;
   virtual std::unique_ptr<Router> router() = 0;
+  virtual server::ServerOptions server_options() {
+    return {};
+  }
 };
 
 inline void BaseApp::start() {
@@ -27,7 +30,7 @@ inline void BaseApp::start() {
   http::router = router();
   auto [host, port] = host_port();
   spdlog::info("run http server on {}:{}", host, port);
-  server::start_server(host, port);
+  server::start_server(host, port, server_options());
 }
 
 }
\ No newline at end of file
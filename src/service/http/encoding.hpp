@@ -0,0 +1,110 @@
+#pragma once
+
+/*
+ * 静态文件的 gzip 结果缓存
+ *
+ * - 按原内容的 ETag（内容哈希）缓存压缩结果，内容不变就不再重复压缩，同样内容的不同路径共用
+ * - 按压缩结果的总字节数限制容量，超过时淘汰最久未用的
+ * - 压缩后没有变小的也记录下来（body 为空），避免每次请求都再压缩一遍
+ */
+
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "protocol.hpp"
+#include "utils/gzip.hpp"
+#include "utils/hash.hpp"
+
+namespace ling::http {
+
+struct Compressed {
+  // 为空表示不值得压缩
+  std::shared_ptr<const std::string> body;
+  // 压缩结果的强校验 ETag，与原内容的不同
+  std::string etag;
+};
+
+class CompressionCache final {
+public:
+  static CompressionCache& singleton() {
+    static CompressionCache cache;
+    return cache;
+  }
+
+  CompressionCache(const CompressionCache&) = delete;
+  CompressionCache& operator=(const CompressionCache&) = delete;
+
+  void capacity(const size_t capacity_bytes) {
+    std::lock_guard lock(mutex_);
+    capacity_bytes_ = capacity_bytes;
+    evict();
+  }
+  // 按原内容的 ETag 取压缩结果，没有时由 read 读出原内容后压缩；读取失败时返回 false
+  bool gzip(const std::string& etag, const std::function<bool(std::string*)>& read, Compressed* compressed);
+
+private:
+  CompressionCache() = default;
+
+  void evict();
+
+  struct Entry {
+    Compressed compressed;
+    std::list<std::string>::iterator lru_it;
+  };
+
+private:
+  std::mutex mutex_;
+  size_t capacity_bytes_ {64 * 1024 * 1024}; // 64MB
+  size_t bytes_ {0};
+  std::unordered_map<std::string, Entry> entries_;
+  // 最近使用的在前
+  std::list<std::string> lru_;
+};
+
+inline bool CompressionCache::gzip(const std::string& etag, const std::function<bool(std::string*)>& read,
+                                   Compressed* compressed) {
+  {
+    std::lock_guard lock(mutex_);
+    if (const auto it = entries_.find(etag); it != entries_.end()) {
+      lru_.splice(lru_.begin(), lru_, it->second.lru_it);
+      *compressed = it->second.compressed;
+      return true;
+    }
+  }
+  // 压缩不持锁，同一内容并发未命中时可能重复压缩，结果相同
+  std::string content;
+  if (!read(&content)) {
+    return false;
+  }
+  std::string output;
+  *compressed = {};
+  if (utils::gzip_compress(content, &output) && output.size() < content.size()) {
+    compressed->etag = strong_etag(utils::sha256_hex(output));
+    compressed->body = std::make_shared<const std::string>(std::move(output));
+  }
+  //
+  std::lock_guard lock(mutex_);
+  if (entries_.find(etag) != entries_.end()) {
+    return true;
+  }
+  lru_.push_front(etag);
+  entries_[etag] = Entry{*compressed, lru_.begin()};
+  bytes_ += etag.size() + (compressed->body != nullptr ? compressed->body->size() : 0);
+  evict();
+  return true;
+}
+
+inline void CompressionCache::evict() {
+  while (bytes_ > capacity_bytes_ && !lru_.empty()) {
+    const auto it = entries_.find(lru_.back());
+    bytes_ -= it->first.size() + (it->second.compressed.body != nullptr ? it->second.compressed.body->size() : 0);
+    entries_.erase(it);
+    lru_.pop_back();
+  }
+}
+
+}  // namespace ling::http
@@ -1,17 +1,30 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <random>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include <spdlog/spdlog.h>
 #include <tsl/robin_map.h>
 #include <uv.h>
+#include <absl/strings/ascii.h>
+#include <absl/strings/match.h>
 #include <absl/strings/str_split.h>
+#include <absl/strings/strip.h>
 
 #include "nlohmann/json.hpp"
 
 #include "service/protocol.h"
+#include "utils/fd_cache.hpp"
+#include "utils/gzip.hpp"
+#include "utils/iobuf.hpp"
 #include "utils/strings.hpp"
+#include "utils/time.hpp"
 
 namespace ling::http {
 
@@ -38,6 +51,7 @@ public:
 static std::unique_ptr<Router> router;
 
 static size_t HTTP_FIRST_LINE_LENGTH_LIMIT {5 * 1024}; // 5kB
+static size_t HTTP_HEAD_LENGTH_LIMIT {64 * 1024}; // 64kB
 static std::string HTTP_VERSION_CODE_1_1 = "1.1";
 
 namespace header {
@@ -45,6 +59,19 @@ namespace header {
 static std::string ContentType {"Content-Type"};
 static std::string ContentLength {"Content-Length"};
 static std::string UserAgent {"User-Agent"};
+static std::string TransferEncoding {"Transfer-Encoding"};
+static std::string Connection {"Connection"};
+static std::string ETag {"ETag"};
+static std::string Vary {"Vary"};
+static std::string AcceptEncoding {"Accept-Encoding"};
+static std::string ContentEncoding {"Content-Encoding"};
+static std::string LastModified {"Last-Modified"};
+static std::string IfNoneMatch {"If-None-Match"};
+static std::string IfModifiedSince {"If-Modified-Since"};
+static std::string Range {"Range"};
+static std::string IfRange {"If-Range"};
+static std::string AcceptRanges {"Accept-Ranges"};
+static std::string ContentRange {"Content-Range"};
 
 }
 
@@ -52,6 +79,9 @@ static std::string UserAgent {"User-Agent"};
 
 enum class HttpStatusCode {
   OK = 200,
+  PARTIAL_CONTENT = 206,
+
+  NOT_MODIFIED = 304,
 
   BAD_REQUEST = 400,
   UNAUTHORIZED = 401,
@@ -61,6 +91,7 @@ enum class HttpStatusCode {
   METHOD_NOT_ALLOWED = 405,
   CONTENT_TOO_LARGE = 413,
   URI_TOO_LONG = 414,
+  RANGE_NOT_SATISFIABLE = 416,
   TOO_MANY_REQUESTS = 429,
 
   INTERNAL_ERR = 500,
@@ -68,6 +99,9 @@ enum class HttpStatusCode {
 
 static tsl::robin_map<HttpStatusCode, std::string> CODE2MSG{
   {HttpStatusCode::OK, "Ok"},
+  {HttpStatusCode::PARTIAL_CONTENT, "Partial Content"},
+
+  {HttpStatusCode::NOT_MODIFIED, "Not Modified"},
 
   {HttpStatusCode::BAD_REQUEST, "Bad Request"},
   {HttpStatusCode::UNAUTHORIZED, "Unauthorized"},
@@ -76,6 +110,7 @@ static tsl::robin_map<HttpStatusCode, std::string> CODE2MSG{
   {HttpStatusCode::METHOD_NOT_ALLOWED, "Method Not Allowed"},
   {HttpStatusCode::CONTENT_TOO_LARGE, "Content Too Large"},
   {HttpStatusCode::URI_TOO_LONG, "URI Too Long"},
+  {HttpStatusCode::RANGE_NOT_SATISFIABLE, "Range Not Satisfiable"},
   {HttpStatusCode::TOO_MANY_REQUESTS, "Too Many Requests"},
 
   {HttpStatusCode::INTERNAL_ERR, "Internal Error"}};
@@ -99,6 +134,8 @@ static std::string GIF = "image/gif";
 static std::string TTF = "font/ttf";
 static std::string WOFF = "font/woff";
 static std::string WOFF2 = "font/woff2";
+static std::string PDF = "application/pdf";
+static std::string MULTIPART_BYTERANGES = "multipart/byteranges";
 
 }
 
@@ -125,29 +162,81 @@ static tsl::robin_map<std::string, ContentType> FILE_SUFFIX_TYPE_M_CONTENT_TYPE{
   {"ttf", {content_type::TTF, true}},
   {"woff", {content_type::WOFF, true}},
   {"woff2", {content_type::WOFF2, true}},
+  {"pdf", {content_type::PDF, true}},
+};
+
+// 文本类的响应（见 FILE_SUFFIX_TYPE_M_CONTENT_TYPE 中非二进制的类型）不小于该大小时才 gzip，更小的压缩收益抵不上开销
+static size_t GZIP_MIN_LENGTH {1024}; // 1kB
+
+// Content-Type（可能带有 ; charset=... 等参数）是否为值得压缩的文本类型
+inline bool is_compressible_type(absl::string_view type) {
+  type = utils::view_strip_empty(type.substr(0, type.find(';')));
+  for (const auto& [_, content_type] : FILE_SUFFIX_TYPE_M_CONTENT_TYPE) {
+    if (!content_type.is_binary && absl::EqualsIgnoreCase(type, content_type.type_name)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// 响应体的一段：文件的一段，由 loop 线程以 sendfile 发送，不经过用户态内存；
+// 或共享的内存（如静态站点缓存中的文件），由 loop 线程直接写出，不拷贝
+struct BodyRef {
+  utils::OpenFilePtr file;
+  std::shared_ptr<const std::string> memory;
+  size_t offset {0};
+  size_t length {0};
+};
+using BodyRefs = std::vector<BodyRef>;
+
+// Range 请求中的一段，已按内容长度截断，length 不为 0
+struct ByteRange {
+  size_t offset {0};
+  size_t length {0};
 };
+using ByteRanges = std::vector<ByteRange>;
 
 class HttpResponse {
 public:
   HttpResponse() = default;
   ~HttpResponse() = default;
 
+  // 生成响应头与 body；响应体的引用部分（body_refs）不在其中，由 loop 线程随后写出
   bool generate(char** resp_buffer, size_t* resp_buffer_size);
   void with_code(HttpStatusCode status_code) {
     code = status_code;
   }
   void with_header(const std::string& name, const std::string& value);
+  // 预先生成的响应头，每行以 CRLF 结尾，原样写出
+  void with_raw_headers(std::shared_ptr<const std::string> raw_headers) {
+    raw_headers_ = std::move(raw_headers);
+  }
   bool with_body(std::string body);
+  // 追加一段文件或内存作为响应体，可多次调用，不能与 with_body 同时使用
+  bool with_file(utils::OpenFilePtr file, size_t offset, size_t length);
+  bool with_memory(std::shared_ptr<const std::string> memory, size_t offset, size_t length);
+  [[nodiscard]] const BodyRefs& body_refs() const {
+    return body_refs_;
+  }
+  // 以 206 响应总长为 size 的内容中的 ranges，每段由 append(offset, length) 以 with_file 或 with_memory 追加；
+  // 多段时为 multipart/byteranges，各段的分隔行共用一块内存，原内容仍按引用发送
+  bool with_ranges(const ByteRanges& ranges, size_t size, const std::function<bool(size_t, size_t)>& append);
+  // 416，不能与 with_raw_headers 同时使用，没有 body 也就不带 Content-Type 与 Content-Encoding
+  void with_unsatisfiable_range(size_t size);
+  // 动态生成的文本响应体按需 gzip，可压缩时总是带上 Vary；带有 ETag 的响应已由静态文件处理自行协商，不再改动
+  void negotiate_encoding(bool accept_gzip);
 
 private:
   //
   HttpStatusCode code = HttpStatusCode::OK;
   tsl::robin_map<std::string, std::string> resp_headers {};
+  std::shared_ptr<const std::string> raw_headers_;
   //
   bool sealed_ = false;
   // char* content_ = nullptr;  // 在 clean_after_send 中被 free
   // size_t content_length_ = 0;
   std::string body_;
+  BodyRefs body_refs_;
 };
 
 inline bool HttpResponse::generate(char** resp_buffer, size_t* resp_buffer_size) {
@@ -158,10 +247,21 @@ inline bool HttpResponse::generate(char** resp_buffer, size_t* resp_buffer_size)
     resp_lines.emplace_back(fmt::format("{}: {}\r\n", k, v));
     *resp_buffer_size += resp_lines.back().size();
   }
+  if (raw_headers_ != nullptr) {
+    resp_lines.emplace_back(*raw_headers_);
+    *resp_buffer_size += resp_lines.back().size();
+  }
   //
-  resp_lines.emplace_back(fmt::format("{}: {}\r\n", header::ContentLength, body_.size()));
-  *resp_buffer_size += resp_lines.back().size();
-  *resp_buffer_size += body_.size() + 4;
+  // 304 没有 body，Content-Length 若出现须与 200 时的一致，不如不发
+  if (code != HttpStatusCode::NOT_MODIFIED) {
+    size_t content_length = body_.size();
+    for (const auto& ref : body_refs_) {
+      content_length += ref.length;
+    }
+    resp_lines.emplace_back(fmt::format("{}: {}\r\n", header::ContentLength, content_length));
+    *resp_buffer_size += resp_lines.back().size();
+    *resp_buffer_size += body_.size();
+  }
   //
   resp_lines.emplace_back("\r\n");
   *resp_buffer_size += resp_lines.back().size();
@@ -173,12 +273,10 @@ inline bool HttpResponse::generate(char** resp_buffer, size_t* resp_buffer_size)
     memcpy(*resp_buffer + copy_idx, s.data(), s.size());
     copy_idx += s.size();
   }
+  // 长度由 Content-Length 界定，body 之后不能有多余的字节，否则会破坏同一连接上的下一个响应
   if (!body_.empty()) {
     memcpy(*resp_buffer + copy_idx, body_.data(), body_.size());
-    copy_idx += body_.size();
-    memcpy(*resp_buffer + copy_idx, "\r\n\r\n", 4);
   }
-  // copy_idx += 4;
   return true;
 }
 
@@ -187,7 +285,7 @@ inline void HttpResponse::with_header(const std::string& name, const std::string
 }
 
 inline bool HttpResponse::with_body(std::string body) {
-  if (sealed_) {
+  if (sealed_ || !body_refs_.empty()) {
     spdlog::error("response has been sealed");
     return false;
   }
@@ -196,6 +294,85 @@ inline bool HttpResponse::with_body(std::string body) {
   return true;
 }
 
+inline bool HttpResponse::with_file(utils::OpenFilePtr file, const size_t offset, const size_t length) {
+  if (sealed_) {
+    spdlog::error("response has been sealed");
+    return false;
+  }
+  body_refs_.emplace_back(BodyRef{std::move(file), nullptr, offset, length});
+  return true;
+}
+
+inline bool HttpResponse::with_memory(std::shared_ptr<const std::string> memory, const size_t offset,
+                                      const size_t length) {
+  if (sealed_) {
+    spdlog::error("response has been sealed");
+    return false;
+  }
+  body_refs_.emplace_back(BodyRef{nullptr, std::move(memory), offset, length});
+  return true;
+}
+
+inline bool HttpResponse::with_ranges(const ByteRanges& ranges, const size_t size,
+                                      const std::function<bool(size_t, size_t)>& append) {
+  code = HttpStatusCode::PARTIAL_CONTENT;
+  if (ranges.size() == 1) {
+    resp_headers[header::ContentRange] =
+        fmt::format("bytes {}-{}/{}", ranges[0].offset, ranges[0].offset + ranges[0].length - 1, size);
+    return append(ranges[0].offset, ranges[0].length);
+  }
+  static thread_local std::mt19937_64 rng {std::random_device{}()};
+  const auto boundary = fmt::format("{:016x}", rng());
+  std::string part_type;
+  if (const auto it = resp_headers.find(header::ContentType); it != resp_headers.end()) {
+    part_type = fmt::format("{}: {}\r\n", header::ContentType, it->second);
+  }
+  std::string delimiters;
+  std::vector<std::pair<size_t, size_t>> spans;
+  for (const auto& range : ranges) {
+    const size_t begin = delimiters.size();
+    delimiters += fmt::format("\r\n--{}\r\n{}{}: bytes {}-{}/{}\r\n\r\n", boundary, part_type, header::ContentRange,
+                              range.offset, range.offset + range.length - 1, size);
+    spans.emplace_back(begin, delimiters.size() - begin);
+  }
+  const size_t tail = delimiters.size();
+  delimiters += fmt::format("\r\n--{}--\r\n", boundary);
+  const auto memory = std::make_shared<const std::string>(std::move(delimiters));
+  resp_headers[header::ContentType] = fmt::format("{}; boundary={}", content_type::MULTIPART_BYTERANGES, boundary);
+  for (size_t idx = 0; idx < ranges.size(); idx++) {
+    if (!with_memory(memory, spans[idx].first, spans[idx].second) ||
+        !append(ranges[idx].offset, ranges[idx].length)) {
+      return false;
+    }
+  }
+  return with_memory(memory, tail, memory->size() - tail);
+}
+
+inline void HttpResponse::with_unsatisfiable_range(const size_t size) {
+  code = HttpStatusCode::RANGE_NOT_SATISFIABLE;
+  resp_headers.erase(header::ContentType);
+  resp_headers.erase(header::ContentEncoding);
+  resp_headers[header::ContentRange] = fmt::format("bytes */{}", size);
+}
+
+inline void HttpResponse::negotiate_encoding(const bool accept_gzip) {
+  if (code != HttpStatusCode::OK || body_.size() < GZIP_MIN_LENGTH || resp_headers.contains(header::ContentEncoding) ||
+      resp_headers.contains(header::ETag)) {
+    return;
+  }
+  if (const auto it = resp_headers.find(header::ContentType); it == resp_headers.end() ||
+      !is_compressible_type(it->second)) {
+    return;
+  }
+  resp_headers[header::Vary] = header::AcceptEncoding;
+  std::string compressed;
+  if (!accept_gzip || !utils::gzip_compress(body_, &compressed) || compressed.size() >= body_.size()) {
+    return;
+  }
+  body_ = std::move(compressed);
+  resp_headers[header::ContentEncoding] = "gzip";
+}
+
 // ---------------------------------------------------------------------------------------------------------------------
 
 struct UrlQuery {
@@ -271,18 +448,45 @@ struct UrlEncodedFormBody {
   }
 };
 
+// 请求头名不区分大小写，按 ASCII 小写取哈希与比较，保留客户端的原始写法
+struct HeaderNameHash {
+  size_t operator()(const std::string& name) const {
+    // FNV-1a
+    uint64_t hash = 14695981039346656037ULL;
+    for (const char c : name) {
+      hash ^= static_cast<unsigned char>(absl::ascii_tolower(static_cast<unsigned char>(c)));
+      hash *= 1099511628211ULL;
+    }
+    return static_cast<size_t>(hash);
+  }
+};
+
+struct HeaderNameEqual {
+  bool operator()(const std::string& lhs, const std::string& rhs) const {
+    return absl::EqualsIgnoreCase(lhs, rhs);
+  }
+};
+
+using HeaderMap = tsl::robin_map<std::string, std::string, HeaderNameHash, HeaderNameEqual>;
+
 class HttpRequest {
 public:
   HttpRequest() = default;
   void to_string(std::string& s);
-  ParseStatus parse(char* buffer, size_t buffer_size);
-  void handle(std::function<void(char* resp, size_t resp_size)> cb);
+  // 从 buf 的开头解析一个请求，完成时该请求的字节已从 buf 中取走，请求体只移动块的引用
+  ParseStatus parse(utils::IOBuf& buf);
+  // resp 为 malloc 分配的响应头（与 body），响应体中引用的文件或内存由 body_refs 给出
+  void handle(std::function<void(char* resp, size_t resp_size, BodyRefs body_refs)> cb);
 
 public:
   size_t first_line_end_idx = 0;
   bool valid = false;
   //
   size_t headers_end_idx = 0;
+  // 请求头的原始字节，通常不超过一个块，拷贝一次便于按行解析
+  std::string head;
+  // 请求体所在的块，body 是其上的视图
+  utils::IOBuf body_buf;
   //
   std::pair<std::string, int> from;
   //
@@ -290,40 +494,227 @@ public:
   std::string raw_q;
   UrlQuery q;
   std::string http_version;
-  tsl::robin_map<std::string, std::string> headers;
+  // 响应后是否保持连接：HTTP/1.1 默认保持，HTTP/1.0 需显式声明；服务端也可置为 false 以关闭连接
+  bool keep_alive = true;
+  HeaderMap headers;
   std::string_view body;
 };
 
-inline ParseStatus HttpRequest::parse(char* buffer, size_t buffer_size) {
-  if (first_line_end_idx <= 0) {
-    spdlog::error("illegal parse status");
-    return ParseStatus::INVALID;
+// Accept-Encoding 中 coding 的权重（q 值）：显式列出的优先，其次是 *，都没有时为 0
+inline double accept_encoding_q(absl::string_view accept_encoding, absl::string_view coding) {
+  double star_q = 0;
+  for (const auto item : absl::StrSplit(accept_encoding, ',')) {
+    const std::vector<absl::string_view> params = absl::StrSplit(item, ';');
+    const auto name = utils::view_strip_empty(params[0]);
+    double q = 1;
+    for (size_t idx = 1; idx < params.size(); idx++) {
+      auto param = utils::view_strip_empty(params[idx]);
+      if (absl::ConsumePrefix(&param, "q=") || absl::ConsumePrefix(&param, "Q=")) {
+        q = std::strtod(std::string(param).c_str(), nullptr);
+      }
+    }
+    if (absl::EqualsIgnoreCase(name, coding)) {
+      return q;
+    }
+    if (name == "*") {
+      star_q = q;
+    }
+  }
+  return star_q;
+}
+
+inline bool accepts_gzip(const HttpRequest& req) {
+  const auto it = req.headers.find(header::AcceptEncoding);
+  return it != req.headers.end() && accept_encoding_q(it->second, "gzip") > 0;
+}
+
+// 由内容的 sha256 生成强校验的 ETag
+inline std::string strong_etag(const std::string& content_hash) {
+  return fmt::format("\"{}\"", content_hash.substr(0, 32));
+}
+
+// 条件请求：If-None-Match 优先，没有时才看 If-Modified-Since，返回 true 表示客户端的缓存仍有效，应响应 304
+inline bool not_modified(const HttpRequest& req, const std::string& etag, const absl::Time last_modified) {
+  if (const auto it = req.headers.find(header::IfNoneMatch); it != req.headers.end()) {
+    if (etag.empty()) {
+      return false;
+    }
+    // GET 使用弱比较，忽略 W/ 前缀
+    for (const auto tag : absl::StrSplit(it->second, ',')) {
+      auto candidate = utils::view_strip_empty(tag);
+      if (candidate == "*") {
+        return true;
+      }
+      absl::ConsumePrefix(&candidate, "W/");
+      if (candidate == etag) {
+        return true;
+      }
+    }
+    return false;
+  }
+  if (const auto it = req.headers.find(header::IfModifiedSince); it != req.headers.end()) {
+    absl::Time since;
+    // 日期精确到秒
+    return utils::parse_http_date(it->second, &since) &&
+           absl::ToUnixSeconds(last_modified) <= absl::ToUnixSeconds(since);
   }
+  return false;
+}
+
+enum class RangeStatus {
+  // 没有 Range 或应忽略它（格式不对、If-Range 不匹配、段数过多），返回整个内容
+  WHOLE,
+  PARTIAL,
+  // 所有段都超出了内容长度
+  UNSATISFIABLE,
+};
+
+// 多段 Range 的段数上限，超过时返回整个内容，避免大量零碎的段放大开销
+static size_t RANGE_MAX_COUNT {16};
+
+// 解析 Range 的值（如 bytes=0-99,200-,-50），按内容长度 size 截断；各段按起点排序，重叠或相邻的合并
+inline RangeStatus parse_range(absl::string_view value, const size_t size, ByteRanges* ranges) {
+  ranges->clear();
+  value = utils::view_strip_empty(value);
+  if (value.size() < 6 || !absl::EqualsIgnoreCase(value.substr(0, 6), "bytes=")) {
+    return RangeStatus::WHOLE;
+  }
+  const auto to_number = [](absl::string_view str, size_t* number) {
+    str = utils::view_strip_empty(str);
+    if (str.empty() || str.size() > 19 || !std::all_of(str.begin(), str.end(), absl::ascii_isdigit)) {
+      return false;
+    }
+    *number = std::strtoull(std::string(str).c_str(), nullptr, 10);
+    return true;
+  };
+  size_t count = 0;
+  for (const auto spec : absl::StrSplit(value.substr(6), ',')) {
+    if (utils::view_strip_empty(spec).empty()) {
+      continue;
+    }
+    if (++count > RANGE_MAX_COUNT) {
+      ranges->clear();
+      return RangeStatus::WHOLE;
+    }
+    const auto dash = spec.find('-');
+    if (dash == absl::string_view::npos) {
+      ranges->clear();
+      return RangeStatus::WHOLE;
+    }
+    size_t first = 0;
+    size_t last = 0;
+    const auto last_str = utils::view_strip_empty(spec.substr(dash + 1));
+    if (utils::view_strip_empty(spec.substr(0, dash)).empty()) { // 最后 n 个字节
+      if (!to_number(last_str, &last)) {
+        ranges->clear();
+        return RangeStatus::WHOLE;
+      }
+      if (last > 0 && size > 0) {
+        ranges->emplace_back(ByteRange{size - std::min(last, size), std::min(last, size)});
+      }
+      continue;
+    }
+    if (!to_number(spec.substr(0, dash), &first) ||
+        (!last_str.empty() && (!to_number(last_str, &last) || last < first))) {
+      ranges->clear();
+      return RangeStatus::WHOLE;
+    }
+    if (first >= size) {
+      continue;
+    }
+    last = last_str.empty() ? size - 1 : std::min(last, size - 1);
+    ranges->emplace_back(ByteRange{first, last - first + 1});
+  }
+  if (count == 0) {
+    return RangeStatus::WHOLE;
+  }
+  if (ranges->empty()) {
+    return RangeStatus::UNSATISFIABLE;
+  }
+  std::sort(ranges->begin(), ranges->end(), [](const ByteRange& a, const ByteRange& b) {
+    return a.offset < b.offset;
+  });
+  size_t merged = 0;
+  for (size_t idx = 1; idx < ranges->size(); idx++) {
+    auto& prev = (*ranges)[merged];
+    const auto& cur = (*ranges)[idx];
+    if (cur.offset <= prev.offset + prev.length) {
+      prev.length = std::max(prev.offset + prev.length, cur.offset + cur.length) - prev.offset;
+    } else {
+      (*ranges)[++merged] = cur;
+    }
+  }
+  ranges->resize(merged + 1);
+  return RangeStatus::PARTIAL;
+}
+
+// 只有 GET 才处理 Range；带有 If-Range 时，只有其中的 ETag（强比较）或日期与当前内容一致才返回部分内容
+inline RangeStatus request_range(const HttpRequest& req, const std::string& etag, const absl::Time last_modified,
+                                 const size_t size, ByteRanges* ranges) {
+  const auto range = req.headers.find(header::Range);
+  if (req.action != "GET" || range == req.headers.end()) {
+    return RangeStatus::WHOLE;
+  }
+  if (const auto it = req.headers.find(header::IfRange); it != req.headers.end()) {
+    const auto validator = utils::view_strip_empty(it->second);
+    absl::Time date;
+    if (absl::StartsWith(validator, "\"") || absl::StartsWith(validator, "W/")) {
+      if (etag.empty() || validator != etag) {
+        return RangeStatus::WHOLE;
+      }
+    } else if (!utils::parse_http_date(std::string(validator), &date) ||
+               absl::ToUnixSeconds(date) != absl::ToUnixSeconds(last_modified)) {
+      return RangeStatus::WHOLE;
+    }
+  }
+  return parse_range(range->second, size, ranges);
+}
+
+// 解析请求行
+inline ParseStatus probe(const char* buffer, size_t buffer_size, HttpRequest& http_req);
+
+inline ParseStatus HttpRequest::parse(utils::IOBuf& buf) {
   if (headers_end_idx == 0) { // 解析请求头
-    size_t cnt = buffer_size-1-first_line_end_idx;
-    std::string_view part_after_first_line {buffer+first_line_end_idx+1, cnt};
-    size_t idx = 1;
-    size_t new_line_begin_idx = 0;
-    while (idx < part_after_first_line.size()) {
-      if (part_after_first_line[idx] == '\n') {
-        if (part_after_first_line[idx-1] == '\r') {
-          if (idx >= 4 && part_after_first_line[idx-1] == '\r' && part_after_first_line[idx-2] == '\n' && part_after_first_line[idx-3] == '\r') { // 请求头结束
-            headers_end_idx = idx+(first_line_end_idx+1);
-            break;
-          }
-          std::string_view header_line = part_after_first_line.substr(new_line_begin_idx, idx-new_line_begin_idx-1);
-          auto pos = header_line.find(':');
-          if (pos == std::string_view::npos) {
-            spdlog::warn("illegal header line: {}", header_line);
-          } else {
-            std::string header_name {utils::view_strip_empty(header_line.substr(0, pos))};
-            std::string header_val {utils::view_strip_empty(header_line.substr(pos+1, header_line.size()-1-pos))};
-            headers[header_name] = header_val;
-          }
-          new_line_begin_idx = idx+1;
-        }
+    // 安全防护：首行、请求头长度限制
+    if (buf.size() >= HTTP_FIRST_LINE_LENGTH_LIMIT && buf.find("\r\n", 0, HTTP_FIRST_LINE_LENGTH_LIMIT) == std::string::npos) {
+      return ParseStatus::INVALID;
+    }
+    const auto head_end = buf.find("\r\n\r\n", 0, HTTP_HEAD_LENGTH_LIMIT);
+    if (head_end == std::string::npos) {
+      return buf.size() >= HTTP_HEAD_LENGTH_LIMIT ? ParseStatus::INVALID : ParseStatus::CONTINUE;
+    }
+    head.clear();
+    buf.copy_to(head, head_end + 4);
+    buf.pop_front(head_end + 4);
+    if (probe(head.data(), head.size(), *this) == ParseStatus::INVALID || !valid) {
+      return ParseStatus::INVALID;
+    }
+    std::string_view lines {head};
+    lines = lines.substr(first_line_end_idx + 1, lines.size() - first_line_end_idx - 3);
+    while (!lines.empty()) {
+      auto line_end = lines.find("\r\n");
+      if (line_end == std::string_view::npos) {
+        line_end = lines.size();
       }
-      idx++;
+      const std::string_view header_line = lines.substr(0, line_end);
+      lines.remove_prefix(std::min(lines.size(), line_end + 2));
+      const auto pos = header_line.find(':');
+      if (pos == std::string_view::npos) {
+        spdlog::warn("illegal header line: {}", header_line);
+        continue;
+      }
+      std::string header_name {utils::view_strip_empty(header_line.substr(0, pos))};
+      std::string header_val {utils::view_strip_empty(header_line.substr(pos+1, header_line.size()-1-pos))};
+      headers[header_name] = header_val;
+    }
+    headers_end_idx = head.size();
+    //
+    if (headers.contains(header::Connection)) {
+      const auto& conn = headers[header::Connection];
+      keep_alive = http_version == "1.0" ? absl::EqualsIgnoreCase(conn, "keep-alive")
+                                         : !absl::EqualsIgnoreCase(conn, "close");
+    } else {
+      keep_alive = http_version != "1.0";
     }
   }
   /*
@@ -331,38 +722,37 @@ inline ParseStatus HttpRequest::parse(char* buffer, size_t buffer_size) {
     spdlog::debug("query: {}", q.json_str());
   }
   */
-  // 判断请求体是否结束
+  if (headers.contains(header::TransferEncoding)) {
+    spdlog::warn("unsupported transfer encoding: {}", headers[header::TransferEncoding]);
+    return ParseStatus::INVALID;
+  }
+  // 判断请求体是否结束，没有 Content-Length 的请求没有请求体
+  long length = 0;
   if (headers.contains(header::ContentLength)) {
-    long length = std::strtol(headers[header::ContentLength].c_str(), nullptr, 10);
-    if (length > 0) {
-      if (length == buffer_size-1-headers_end_idx) {
-        body = std::string_view(buffer+headers_end_idx+1, length);
-        return ParseStatus::COMPLETE;
-      }
-      if (length > buffer_size-1-headers_end_idx) {
-        return ParseStatus::CONTINUE;
-      }
-      if (length < buffer_size-1-headers_end_idx) {
-        spdlog::warn("illegal content length: {}, too small!", length);
-        return ParseStatus::INVALID;
-      }
-    }
-  } else if (headers_end_idx > 0 && buffer_size > headers_end_idx) {
-    if (buffer[buffer_size-1] == '\n' && buffer[buffer_size-2] == '\r' && buffer[buffer_size-3] == '\n' && \
-      buffer[buffer_size-4] == '\r') {
-      body = std::string_view(buffer+headers_end_idx+1, buffer_size-1-headers_end_idx);
-      return ParseStatus::COMPLETE;
+    length = std::strtol(headers[header::ContentLength].c_str(), nullptr, 10);
+    if (length < 0) {
+      spdlog::warn("illegal content length: {}", length);
+      return ParseStatus::INVALID;
     }
   }
-  return ParseStatus::INVALID;
+  if (buf.size() < static_cast<size_t>(length)) {
+    return ParseStatus::CONTINUE;
+  }
+  buf.cut(length, &body_buf);
+  body = body_buf.view();
+  return ParseStatus::COMPLETE;
 }
 
-inline void HttpRequest::handle(std::function<void(char* resp, size_t resp_size)> cb) {
-  router->route(this, [cb](const HttpResponsePtr& resp_ptr) {
+inline void HttpRequest::handle(std::function<void(char* resp, size_t resp_size, BodyRefs body_refs)> cb) {
+  // 回调可能在请求释放后才执行，需要的信息先取出
+  const bool accept_gzip = accepts_gzip(*this);
+  router->route(this, [cb, keep_alive = keep_alive, accept_gzip](const HttpResponsePtr& resp_ptr) {
+    resp_ptr->negotiate_encoding(accept_gzip);
+    resp_ptr->with_header(header::Connection, keep_alive ? "keep-alive" : "close");
     char* resp_buf = nullptr;
     size_t buf_size = 0;
     resp_ptr->generate(&resp_buf, &buf_size);
-    cb(resp_buf, buf_size);
+    cb(resp_buf, buf_size, resp_ptr->body_refs());
   });
 }
 
@@ -1,12 +1,20 @@
 #pragma once
 
 #include "protocol.hpp"
+#include "encoding.hpp"
 #include "handler.hpp"
+#include "static_site.hpp"
+#include "utils/fd_cache.hpp"
 #include "utils/rate_limit.hpp"
 #include "utils/guard.hpp"
 
 namespace ling::http {
 
+// 不小于该大小的静态文件以 sendfile 发送，更小的读入内存随响应头一起写出
+static size_t SENDFILE_THRESHOLD {64 * 1024}; // 64kB
+// 不超过该大小的文本类静态文件才 gzip（结果缓存在 CompressionCache 中），更大的不压缩，仍以 sendfile 发送
+static size_t GZIP_MAX_FILE_SIZE {8 * 1024 * 1024}; // 8MB
+
 struct MapBasedRouterConf {
   uint32_t global_rate_limit;
   uint32_t per_client_rate_limit;
@@ -24,6 +32,7 @@ private:
   static void rate_limited_handler(HttpRequest& req, const HttpResponsePtr& resp, const DoneCallback& cb);
   // 兜底，静态文件请求处理
   void static_file_handler(HttpRequest& req, const HttpResponsePtr& resp, const DoneCallback& cb) const;
+  static bool read_file(const utils::OpenFilePtr& file, std::string* content);
 
 private:
   std::unique_ptr<utils::RateLimiter> rate_limiter_ptr_;
@@ -88,33 +97,155 @@ inline void MapBasedRouter::static_file_handler(HttpRequest& req,
     path += "index.html";
   }
   DoneCallbackGuard guard{cb, resp}; // guard
+  // 开启静态站点缓存时以缓存为准，不在其中的路径不访问磁盘
+  StaticEntryPtr entry = nullptr;
+  if (StaticSite::singleton().enabled()) {
+    entry = StaticSite::singleton().find(path);
+    if (entry == nullptr) {
+      resp->with_body(CODE2MSG[HttpStatusCode::NOT_FOUND]);
+      resp->with_code(HttpStatusCode::NOT_FOUND);
+      return;
+    }
+  }
+  std::string suffix_type = utils::find_suffix_type(path);
+  if (entry != nullptr && !entry->on_disk) {
+    if ((suffix_type == "html" || suffix_type == "htm") && func_log_req_) {
+      func_log_req_(req);
+    }
+    const bool gzip = entry->gzip_body != nullptr && accepts_gzip(req);
+    const auto& body = gzip ? entry->gzip_body : entry->body;
+    const auto& etag = gzip ? entry->gzip_etag : entry->etag;
+    if (not_modified(req, etag, entry->last_modified)) {
+      resp->with_raw_headers(gzip ? entry->gzip_headers : entry->headers);
+      resp->with_code(HttpStatusCode::NOT_MODIFIED);
+      return;
+    }
+    // Range 作用于选定编码的内容
+    ByteRanges ranges;
+    const auto range_status = request_range(req, etag, entry->last_modified, body->size(), &ranges);
+    if (range_status == RangeStatus::UNSATISFIABLE) {
+      resp->with_unsatisfiable_range(body->size());
+      return;
+    }
+    if (range_status == RangeStatus::PARTIAL && ranges.size() > 1) {
+      // 多段时 Content-Type 由 with_ranges 替换，逐个设置响应头
+      resp->with_header(header::LastModified, utils::format_http_date(entry->last_modified));
+      resp->with_header(header::AcceptRanges, "bytes");
+      resp->with_header(header::ETag, etag);
+      if (!entry->content_type.empty()) {
+        resp->with_header(header::ContentType, entry->content_type);
+      }
+      if (entry->gzip_body != nullptr) {
+        resp->with_header(header::Vary, header::AcceptEncoding);
+      }
+      if (gzip) {
+        resp->with_header(header::ContentEncoding, "gzip");
+      }
+    } else {
+      resp->with_raw_headers(gzip ? entry->gzip_headers : entry->headers);
+    }
+    const auto append = [&resp, &body](const size_t offset, const size_t length) {
+      return resp->with_memory(body, offset, length);
+    };
+    if (range_status == RangeStatus::PARTIAL) {
+      resp->with_ranges(ranges, body->size(), append);
+    } else {
+      append(0, body->size());
+    }
+    return;
+  }
   std::filesystem::path file_path{"." + path};
-  if (!exists(file_path)) {
+  const auto file = utils::FdCache::singleton().open(file_path);
+  if (file == nullptr) {
     resp->with_body(CODE2MSG[HttpStatusCode::NOT_FOUND]);
     resp->with_code(HttpStatusCode::NOT_FOUND);
     return;
   }
-  std::string suffix_type = utils::find_suffix_type(path);
   if (suffix_type == "html" || suffix_type == "htm") {
     if (func_log_req_) {
       func_log_req_(req);
     }
   }
-  std::ifstream file_stream;
-  file_stream.open(file_path);
-  utils::DeferGuard defer_guard([&]() {
-    file_stream.close();
-  });
-  if (file_stream.fail()) {
-    resp->with_body(CODE2MSG[HttpStatusCode::INTERNAL_ERR]);
-    resp->with_code(HttpStatusCode::INTERNAL_ERR);
-    return;
-  }
-  std::string resp_content((std::istreambuf_iterator<char>(file_stream)), std::istreambuf_iterator<char>());
-  resp->with_body(resp_content);
-  //
+  const bool compressible = !suffix_type.empty() && FILE_SUFFIX_TYPE_M_CONTENT_TYPE.contains(suffix_type) &&
+                            !FILE_SUFFIX_TYPE_M_CONTENT_TYPE[suffix_type].is_binary;
   if (!suffix_type.empty() && FILE_SUFFIX_TYPE_M_CONTENT_TYPE.contains(suffix_type)) {
     resp->with_header(header::ContentType, FILE_SUFFIX_TYPE_M_CONTENT_TYPE[suffix_type].type_name);
   }
+  // 校验信息随打开的文件缓存，同一版本的文件只计算一次内容哈希
+  auto etag = file->content_hash().empty() ? std::string() : strong_etag(file->content_hash());
+  const auto last_modified = absl::FromUnixNanos(file->mtime_ns);
+  resp->with_header(header::LastModified, utils::format_http_date(last_modified));
+  resp->with_header(header::AcceptRanges, "bytes");
+  // 优先发送同目录下的 .gz 文件，没有时 gzip 结果按原内容的 ETag 缓存，没有 ETag（读取失败）时不压缩
+  auto body_file = file;
+  Compressed compressed;
+  if (compressible && !etag.empty() && file->size >= GZIP_MIN_LENGTH && file->size <= GZIP_MAX_FILE_SIZE) {
+    resp->with_header(header::Vary, header::AcceptEncoding);
+    const auto read = [&file](std::string* content) {
+      return read_file(file, content);
+    };
+    if (accepts_gzip(req)) {
+      const auto gz_file = utils::FdCache::singleton().open(file_path.string() + ".gz");
+      if (gz_file != nullptr && !gz_file->content_hash().empty()) {
+        body_file = gz_file;
+        etag = strong_etag(gz_file->content_hash());
+        resp->with_header(header::ContentEncoding, "gzip");
+      } else if (CompressionCache::singleton().gzip(etag, read, &compressed) && compressed.body != nullptr) {
+        etag = compressed.etag;
+        resp->with_header(header::ContentEncoding, "gzip");
+      }
+    }
+  }
+  if (!etag.empty()) {
+    resp->with_header(header::ETag, etag);
+  }
+  if (not_modified(req, etag, last_modified)) {
+    resp->with_code(HttpStatusCode::NOT_MODIFIED);
+    return;
+  }
+  // Range 作用于选定编码的内容：.gz 文件或压缩结果
+  auto memory = compressed.body;
+  const size_t size = memory != nullptr ? memory->size() : body_file->size;
+  ByteRanges ranges;
+  const auto range_status = request_range(req, etag, last_modified, size, &ranges);
+  if (range_status == RangeStatus::UNSATISFIABLE) {
+    resp->with_unsatisfiable_range(size);
+    return;
+  }
+  if (memory == nullptr && body_file->size < SENDFILE_THRESHOLD) {
+    std::string resp_content;
+    if (!read_file(body_file, &resp_content)) {
+      resp->with_body(CODE2MSG[HttpStatusCode::INTERNAL_ERR]);
+      resp->with_code(HttpStatusCode::INTERNAL_ERR);
+      return;
+    }
+    if (range_status == RangeStatus::WHOLE) {
+      resp->with_body(std::move(resp_content));
+      return;
+    }
+    memory = std::make_shared<const std::string>(std::move(resp_content));
+  }
+  // 大文件的各段都以 sendfile 发送
+  const auto append = [&resp, &memory, &body_file](const size_t offset, const size_t length) {
+    return memory != nullptr ? resp->with_memory(memory, offset, length) : resp->with_file(body_file, offset, length);
+  };
+  if (range_status == RangeStatus::PARTIAL) {
+    resp->with_ranges(ranges, size, append);
+  } else {
+    append(0, size);
+  }
+}
+
+inline bool MapBasedRouter::read_file(const utils::OpenFilePtr& file, std::string* content) {
+  content->resize(file->size);
+  size_t nread = 0;
+  while (nread < content->size()) {
+    const auto n = pread(file->fd, content->data() + nread, content->size() - nread, nread);
+    if (n <= 0) {
+      break;
+    }
+    nread += n;
+  }
+  return nread == content->size();
 }
 }
\ No newline at end of file
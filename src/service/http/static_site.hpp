@@ -0,0 +1,233 @@
+#pragma once
+
+/*
+ * 静态站点缓存（可选）
+ *
+ * - 将 dist 目录下的文件读入内存，按请求路径建表，每项包含预先生成的响应头、body、gzip 版本、ETag 与修改时间
+ * - gzip 版本优先用同目录下的 .gz 文件，没有时加载时压缩文本类文件，请求时不再压缩
+ * - 表建好后不再修改，重新构建后整体替换，正在使用旧表的请求不受影响
+ * - 开启后以表为准：不在表中的路径直接 404，不访问磁盘；超过大小上限的文件只记录存在，仍以 sendfile 发送
+ */
+
+#include <sys/stat.h>
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+#include <tsl/robin_map.h>
+
+#include "protocol.hpp"
+#include "utils/fd_cache.hpp"
+#include "utils/gzip.hpp"
+#include "utils/hash.hpp"
+#include "utils/strings.hpp"
+
+namespace ling::http {
+
+struct StaticEntry {
+  // 预先生成的响应头：Content-Type、ETag 等，每行以 CRLF 结尾
+  std::shared_ptr<const std::string> headers;
+  // 未知类型时为空；多段 Range 响应的 Content-Type 不同，不能用预先生成的响应头
+  std::string content_type;
+  std::shared_ptr<const std::string> body;
+  // 强校验的 ETag，由内容哈希得到，含引号
+  std::string etag;
+  absl::Time last_modified;
+  // gzip 版本及其响应头（多出 Content-Encoding），不值得压缩时为空；两种编码的内容不同，ETag 也不同
+  std::shared_ptr<const std::string> gzip_headers;
+  std::shared_ptr<const std::string> gzip_body;
+  std::string gzip_etag;
+  // 超过大小上限，没有读入内存
+  bool on_disk {false};
+};
+using StaticEntryPtr = std::shared_ptr<const StaticEntry>;
+// 请求路径（以 / 开头）到文件的映射
+using StaticTable = tsl::robin_map<std::string, StaticEntryPtr>;
+
+class StaticSite final {
+public:
+  static StaticSite& singleton() {
+    static StaticSite site;
+    return site;
+  }
+
+  StaticSite(const StaticSite&) = delete;
+  StaticSite& operator=(const StaticSite&) = delete;
+
+  // 加载 root 下的所有文件并替换当前的表，大于 max_file_size 的文件不读入内存
+  bool load(const std::filesystem::path& root, size_t max_file_size);
+  // 目录下文件有增删或大小、修改时间有变化时重新加载，返回是否重新加载了
+  bool refresh();
+  [[nodiscard]] bool enabled() const {
+    return std::atomic_load(&table_) != nullptr;
+  }
+  // 未开启或路径不存在时返回 nullptr
+  [[nodiscard]] StaticEntryPtr find(const std::string& path) const;
+
+private:
+  StaticSite() = default;
+
+  // 目录下所有文件的路径、大小与修改时间的摘要，出错时返回 false
+  static bool signature_of(const std::filesystem::path& root, uint64_t& signature);
+  using Content = std::shared_ptr<const std::string>;
+  static StaticEntryPtr make_entry(const std::string& path, absl::Time last_modified, Content content,
+                                   Content gzip_content);
+
+private:
+  std::shared_ptr<const StaticTable> table_;
+  // 以下只在 load/refresh 中使用
+  std::mutex load_mutex_;
+  std::filesystem::path root_;
+  size_t max_file_size_ {0};
+  uint64_t signature_ {0};
+};
+
+inline StaticEntryPtr StaticSite::find(const std::string& path) const {
+  const auto table = std::atomic_load(&table_);
+  if (table == nullptr) {
+    return nullptr;
+  }
+  const auto it = table->find(path);
+  return it == table->end() ? nullptr : it->second;
+}
+
+inline bool StaticSite::signature_of(const std::filesystem::path& root, uint64_t& signature) {
+  namespace fs = std::filesystem;
+  std::error_code ec;
+  signature = 0;
+  for (auto it = fs::recursive_directory_iterator(root, ec); !ec && it != fs::recursive_directory_iterator();
+       it.increment(ec)) {
+    struct stat st {};
+    if (::stat(it->path().c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+      continue;
+    }
+    // 与顺序无关，目录遍历的顺序不保证稳定
+    size_t h = std::hash<std::string>{}(it->path().string());
+    h ^= std::hash<uint64_t>{}(st.st_size) + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    h ^= std::hash<int64_t>{}(utils::mtime_ns_of(st)) + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    signature += h;
+  }
+  if (ec) {
+    spdlog::error("failed to scan {}: {}", root.string(), ec.message());
+    return false;
+  }
+  return true;
+}
+
+inline StaticEntryPtr StaticSite::make_entry(const std::string& path, const absl::Time last_modified,
+                                             Content content, Content gzip_content) {
+  auto entry = std::make_shared<StaticEntry>();
+  entry->etag = strong_etag(utils::sha256_hex(*content));
+  entry->last_modified = last_modified;
+  std::string headers;
+  headers += fmt::format("{}: {}\r\n", header::LastModified, utils::format_http_date(last_modified));
+  headers += fmt::format("{}: bytes\r\n", header::AcceptRanges);
+  const auto suffix_type = utils::find_suffix_type(path);
+  if (const auto it = FILE_SUFFIX_TYPE_M_CONTENT_TYPE.find(suffix_type);
+      !suffix_type.empty() && it != FILE_SUFFIX_TYPE_M_CONTENT_TYPE.end()) {
+    entry->content_type = it->second.type_name;
+    headers += fmt::format("{}: {}\r\n", header::ContentType, it->second.type_name);
+    // 没有 .gz 文件的文本类文件在加载时压缩
+    std::string compressed;
+    if (gzip_content == nullptr && !it->second.is_binary && content->size() >= GZIP_MIN_LENGTH &&
+        utils::gzip_compress(*content, &compressed) && compressed.size() < content->size()) {
+      gzip_content = std::make_shared<const std::string>(std::move(compressed));
+    }
+  }
+  if (gzip_content != nullptr) {
+    headers += fmt::format("{}: {}\r\n", header::Vary, header::AcceptEncoding);
+    entry->gzip_etag = strong_etag(utils::sha256_hex(*gzip_content));
+    entry->gzip_headers = std::make_shared<const std::string>(
+        headers + fmt::format("{}: {}\r\n{}: gzip\r\n", header::ETag, entry->gzip_etag, header::ContentEncoding));
+    entry->gzip_body = std::move(gzip_content);
+  }
+  headers += fmt::format("{}: {}\r\n", header::ETag, entry->etag);
+  entry->headers = std::make_shared<const std::string>(std::move(headers));
+  entry->body = std::move(content);
+  return entry;
+}
+
+inline bool StaticSite::load(const std::filesystem::path& root, const size_t max_file_size) {
+  namespace fs = std::filesystem;
+  std::lock_guard lock(load_mutex_);
+  uint64_t signature = 0;
+  if (!signature_of(root, signature)) {
+    return false;
+  }
+  // 先读入所有文件，再为有 .gz 文件的生成预压缩版本，与 .gz 文件本身共用内存
+  tsl::robin_map<std::string, std::pair<Content, absl::Time>> contents;
+  tsl::robin_map<std::string, bool> large_files;
+  std::error_code ec;
+  for (auto it = fs::recursive_directory_iterator(root, ec); !ec && it != fs::recursive_directory_iterator();
+       it.increment(ec)) {
+    struct stat st {};
+    if (::stat(it->path().c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+      continue;
+    }
+    const auto path = "/" + it->path().lexically_relative(root).generic_string();
+    const auto size = static_cast<size_t>(st.st_size);
+    if (size > max_file_size) {
+      large_files[path] = true;
+      continue;
+    }
+    std::string content(size, '\0');
+    std::ifstream fi(it->path(), std::ios::binary);
+    if (!fi.read(content.data(), static_cast<std::streamsize>(size))) {
+      spdlog::error("failed to read {}", it->path().string());
+      return false;
+    }
+    contents[path] = {std::make_shared<const std::string>(std::move(content)),
+                      absl::FromUnixNanos(utils::mtime_ns_of(st))};
+  }
+  if (ec) {
+    spdlog::error("failed to load {}: {}", root.string(), ec.message());
+    return false;
+  }
+  //
+  auto table = std::make_shared<StaticTable>();
+  size_t bytes = 0;
+  for (const auto& [path, file] : contents) {
+    const auto& [content, last_modified] = file;
+    const auto gz = contents.find(path + ".gz");
+    bytes += content->size();
+    (*table)[path] = make_entry(path, last_modified, content, gz != contents.end() ? gz->second.first : nullptr);
+  }
+  for (const auto& [path, _] : large_files) {
+    auto entry = std::make_shared<StaticEntry>();
+    entry->on_disk = true;
+    (*table)[path] = std::move(entry);
+  }
+  std::atomic_store(&table_, std::shared_ptr<const StaticTable>(std::move(table)));
+  root_ = root;
+  max_file_size_ = max_file_size;
+  signature_ = signature;
+  spdlog::info("static site loaded: {} files in memory ({} bytes), {} on disk", contents.size(), bytes,
+               large_files.size());
+  return true;
+}
+
+inline bool StaticSite::refresh() {
+  std::filesystem::path root;
+  size_t max_file_size = 0;
+  {
+    std::lock_guard lock(load_mutex_);
+    uint64_t signature = 0;
+    if (root_.empty() || !signature_of(root_, signature) || signature == signature_) {
+      return false;
+    }
+    root = root_;
+    max_file_size = max_file_size_;
+  }
+  spdlog::info("static site changed, reloading {}", root.string());
+  return load(root, max_file_size);
+}
+
+}  // namespace ling::http
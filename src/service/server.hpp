@@ -1,6 +1,21 @@
 #pragma once
 
-#include <future>
+#if defined(__APPLE__)
+#include <sys/socket.h>
+#include <sys/uio.h>
+#else
+#include <sys/sendfile.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #include <spdlog/spdlog.h>
 #include <uv.h>
@@ -12,14 +27,28 @@
 
 #include "utils/guard.hpp"
 #include "utils/executor.hpp"
+#include "utils/iobuf.hpp"
+#include "utils/mpsc_queue.hpp"
 
 namespace ling::server {
 
 static int DEFAULT_BACKLOG = 128;
 static size_t REQUEST_SIZE_LIMIT {10 * 1024 * 1024}; // 10MB
+// 一个连接每轮最多 sendfile 的字节数，超过后让出 loop，等下一次可写再继续
+static size_t SENDFILE_BYTES_PER_TURN {4 * 1024 * 1024}; // 4MB
+
+struct ServerOptions {
+  // loop 线程数，每个线程一个 loop 与一个监听 socket（SO_REUSEPORT），0 表示 CPU 核数
+  uint32_t threads {1};
+  // 空闲连接（没有在处理的请求）的超时，0 表示不超时
+  uint32_t keep_alive_timeout_ms {5000};
+  // 单个连接最多处理的请求数，最后一个请求响应 Connection: close，0 表示不限
+  uint32_t max_keep_alive_requests {1000};
+  // 单个连接上同时在处理的流水线请求上限，达到后暂停读
+  uint32_t max_pipelined_requests {16};
+};
 
-using LoopPtr = std::shared_ptr<uv_loop_t>;
-static LoopPtr loop_;
+static ServerOptions options_;
 
 enum class RequestBufferStage {
   INIT,
@@ -30,149 +59,187 @@ enum class RequestBufferStage {
 
 class RequestBuffer;
 using RequestBufferPtr = std::shared_ptr<RequestBuffer>;
+class Connection;
+using ConnectionPtr = std::shared_ptr<Connection>;
+
+// 处理完成的响应，data 由 malloc 分配；body 中引用的文件或内存在 data 之后依次写出，文件部分 sendfile
+struct Response {
+  char* data;
+  size_t size;
+  bool keep_alive;
+  http::BodyRefs body;
+};
+
+// 处理线程交回 loop 线程的响应
+struct Completion {
+  ConnectionPtr conn;
+  uint64_t seq {0};
+  Response resp {};
+};
+
+struct LoopStats {
+  std::atomic_uint64_t accepted {0};
+  std::atomic_uint64_t active {0};
+  std::atomic_uint64_t requests {0};
+  std::atomic_uint64_t bytes_in {0};
+  std::atomic_uint64_t bytes_out {0};
+};
 
-class RequestBufferManager {
+// 一个 libuv loop 及其监听 socket，每个 loop 线程一个，连接只在接受它的 loop 上读写
+struct Reactor {
+  size_t id {0};
+  uv_loop_t loop {};
+  uv_tcp_t server {};
+  // 处理线程将响应放入无锁队列，再由 resp_notify 唤醒 loop 线程取出并按序写出
+  uv_async_t resp_notify {};
+  utils::MpscQueue<Completion> completions;
+  LoopStats stats;
+};
+static std::vector<std::unique_ptr<Reactor>> reactors_;
+
+// 连接状态，accept 时创建并挂在 uv_tcp_t::data 上，对端地址只解析一次，关闭回调中释放
+//
+// 同一连接上的请求依次解析、编号后并发处理，响应在 loop 线程按请求顺序写出（支持流水线）；
+// 空闲超时、请求数达到上限、请求声明不保持连接时，写完已分发请求的响应后关闭
+class Connection final : public std::enable_shared_from_this<Connection> {
 public:
-  static RequestBufferManager& instance() {
-    static RequestBufferManager rbm;
-    return rbm;
+  // 接受新连接并开始读，失败时返回 nullptr
+  static ConnectionPtr accept(Reactor* reactor, uv_stream_t* server);
+  static Connection* from(const uv_handle_t* handle) {
+    return static_cast<Connection*>(handle->data);
   }
 
-  RequestBufferManager();
-  ~RequestBufferManager() {
-    exit_flag_ = true;
-    cleanup_future_.wait_for(std::chrono::seconds(5));
-  }
+  Connection(const Connection&) = delete;
+  Connection& operator=(const Connection&) = delete;
 
-  RequestBufferPtr with_req_buffer(const std::string& k) {
-    if (request_buffers_.count(k) > 0) {
-      return request_buffers_.at(k);
-    }
-    std::lock_guard lock(mutex_);
-    if (request_buffers_.count(k) > 0) {
-      return request_buffers_.at(k);
-    }
-    request_buffers_[k] = std::make_shared<RequestBuffer>();
-    return request_buffers_.at(k);
+  uv_stream_t* stream() {
+    return reinterpret_cast<uv_stream_t*>(&handle_);
   }
-
-  bool free_req_buffer(const std::string& k) {
-    if (request_buffers_.count(k) > 0) {
-      std::lock_guard lock(mutex_);
-      request_buffers_.erase(k);
-      return true;
-    }
-    return false;
+  [[nodiscard]] const std::pair<std::string, int>& peer() const {
+    return peer_;
   }
+  // 处理线程调用：提交第 seq 个请求的响应，resp 由 malloc 分配，所有权转移给连接
+  void respond(uint64_t seq, char* resp, size_t resp_size, bool keep_alive, http::BodyRefs body = {});
+
+  // 以下只在 loop 线程调用
+  // 读到的数据已在 block 中，只增加引用，不拷贝
+  void on_data(utils::IOBlock* block, size_t nread);
+  // 对端关闭了写端，写完已分发请求的响应后关闭
+  void on_eof();
+  // 收下处理线程交回的响应，返回 true 表示需要（且尚未安排）flush
+  bool on_response(uint64_t seq, Response resp);
+  // 按请求顺序，将已就绪的响应合并为一次 uv_write 写出
+  void flush();
+  void close();
+
+private:
+  Connection() = default;
+  // 解析并分发缓冲中完整的请求
+  void process();
+  // 不再接收新的请求，写完已分发请求的响应后关闭
+  void drain();
+  void maybe_close();
+  void update_reading();
+  void touch();
+  // 以 sendfile 发送 sending_，socket 写满时等待可写后继续
+  void send_file();
+  void wait_writable(int sock);
+  static void alloc_buffer(uv_handle_t* handle, size_t suggested_size, uv_buf_t* buf);
+  static void on_read(uv_stream_t* client, ssize_t nread, const uv_buf_t* buf);
+  static void on_write(uv_write_t* req, int status);
+  static void on_idle(uv_timer_t* timer);
+  static void on_writable(uv_poll_t* poll, int status, int events);
+  static void on_close(uv_handle_t* handle);
+
+  // 一次 uv_write 合并写出的多个响应
+  struct WriteReq {
+    uv_write_t req {};
+    std::vector<uv_buf_t> bufs;
+    // bufs 中由 malloc 分配、写完后释放的部分
+    std::vector<char*> owned;
+    // bufs 中引用的共享内存，写完前保持有效
+    std::vector<std::shared_ptr<const std::string>> pinned;
+    // 写完后接着发送 sending_
+    bool then_file {false};
+  };
 
 private:
-  std::mutex mutex_;
-  std::unordered_map<std::string, RequestBufferPtr> request_buffers_;
-  std::future<void> cleanup_future_;
-  std::atomic_bool exit_flag_ {false};
+  Reactor* reactor_ {nullptr};
+  uv_tcp_t handle_ {};
+  uv_timer_t idle_timer_ {};
+  // sendfile 遇到 socket 写满时，以 dup 出的 fd 监听可写（同一 fd 不能再被其他 handle 监听）
+  uv_poll_t writable_ {};
+  int writable_fd_ {-1};
+  int open_handles_ {0};
+  std::pair<std::string, int> peer_;
+  // 已读到、尚未解析的数据，可能包含多个流水线请求
+  utils::IOBuf in_;
+  // 正在解析的请求
+  RequestBufferPtr parsing_;
+  // 下一个分发的请求与下一个写出的响应的序号，两者之差即在处理的请求数
+  uint64_t next_seq_ {0};
+  uint64_t next_write_ {0};
+  size_t writes_in_flight_ {0};
+  // 交给 uv_write 的总字节数，及上次空闲超时时已写入 socket 的字节数，用来判断写有没有进展
+  uint64_t bytes_queued_ {0};
+  uint64_t bytes_flushed_at_idle_ {0};
+  bool reading_ {false};
+  bool draining_ {false};
+  bool flush_scheduled_ {false};
+  bool closed_ {false};
+  // 处理完成、等待按序写出的响应
+  std::map<uint64_t, Response> ready_;
+  // 当前响应还未写出的 body 部分
+  std::deque<http::BodyRef> pending_;
+  // 正在发送的文件，发送完之前不写后续的部分
+  http::BodyRef sending_;
+  // libuv 持有的引用，关闭回调中释放
+  ConnectionPtr self_;
 };
 
 class RequestBuffer {
 public:
   RequestBuffer() = default;
-  ~RequestBuffer() {
-    if (buffer_ != nullptr) {
-      free(buffer_);
-      buffer_ = nullptr;
-    }
-  }
 
-  ParseStatus accept(const uv_buf_t* buf, ssize_t nread);
-  void handle(uv_stream_t *client);
-  std::chrono::time_point<std::chrono::system_clock>& last_fill_time() {
-    return last_fill_time_;
-  }
-
-private:
-  ParseStatus try_parse();
+  // 从连接的缓冲开头解析一个请求，完成时该请求的字节已从缓冲中取走
+  ParseStatus try_parse(utils::IOBuf& in);
+  void handle(const ConnectionPtr& conn, uint64_t seq);
   http::HttpRequest& with_http_request() {
     return http_req_;
   }
-  [[nodiscard]] std::pair<char*, size_t> with_buffer() const {
-    return std::make_pair(buffer_, size_);
-  }
 
 private:
-  char* buffer_ = nullptr;
-  size_t size_ = 0;
   RequestBufferStage stage_ = RequestBufferStage::INIT;
-  std::chrono::time_point<std::chrono::system_clock> last_fill_time_ = std::chrono::system_clock::now();
   Protocol protocol_ = Protocol::UNKNOWN;
   http::HttpRequest http_req_;
 };
 
-inline ParseStatus RequestBuffer::accept(const uv_buf_t* buf, ssize_t nread) {
-  // 安全防护
-  if (size_ + nread >= REQUEST_SIZE_LIMIT) {
-    spdlog::warn("request size exceed limit!");
-    return ParseStatus::INVALID;
-  }
-  // TODO: 待优化，参考 brpc IOBuf
-  char* tmp_buffer = nullptr;
-  size_t tmp_size;
-  char* copy_base;
-  if (buffer_ == nullptr) {
-    tmp_size = nread;
-    tmp_buffer = static_cast<char*>(malloc(tmp_size));
-    copy_base = tmp_buffer;
-  } else {
-    tmp_size = size_ + nread;
-    tmp_buffer = static_cast<char*>(malloc(tmp_size));
-    memcpy(tmp_buffer, buffer_, size_);
-    copy_base = tmp_buffer + size_;
-  }
-  //
-  memcpy(copy_base, buf->base, nread);
-  //
-  free(buffer_);
-  buffer_ = tmp_buffer;
-  size_ = tmp_size;
-  //
-  last_fill_time_ = std::chrono::system_clock::now();
-  //
-  return try_parse();
-}
-
-inline ParseStatus RequestBuffer::try_parse() {
+inline ParseStatus RequestBuffer::try_parse(utils::IOBuf& in) {
   stage_ = RequestBufferStage::PARSING;
   //
-  if (size_ <= 0 || buffer_ == nullptr) {
+  if (in.empty() || protocol_ == Protocol::INVALID) {
     return ParseStatus::INVALID;
   }
-  if (protocol_ == Protocol::UNKNOWN) {
-    auto [buffer_ptr, buffer_size] = with_buffer();
-    // HTTP 协议探测
-    if (http::probe(buffer_ptr, buffer_size, with_http_request()) == ParseStatus::INVALID) {
-      protocol_ = Protocol::INVALID;
-      return ParseStatus::INVALID;
-    }
-    if (with_http_request().valid) {
-      protocol_ = Protocol::HTTP;
-    } else {
-      return ParseStatus::INVALID;
-    }
-  }
-  if (protocol_ == Protocol::HTTP) { // 正式解析 HTTP 协议
-    return with_http_request().parse(buffer_, size_);
+  // 目前只支持 HTTP，能解析出合法的请求行即为 HTTP
+  const auto status = with_http_request().parse(in);
+  if (status == ParseStatus::INVALID) {
+    protocol_ = Protocol::INVALID;
+  } else if (with_http_request().valid) {
+    protocol_ = Protocol::HTTP;
   }
-  return ParseStatus::INVALID;
+  return status;
 }
 
-static bool parse_peer_info(uv_stream_t* client, std::pair<std::string, int>& peer) {
-  int peer_addr_len = sizeof(sockaddr);
-  auto* peer_addr = static_cast<sockaddr*>(malloc(peer_addr_len));
-  utils::MemoryGuard memory_guard {peer_addr};
-  auto err_code = uv_tcp_getpeername(reinterpret_cast<uv_tcp_t*>(client), peer_addr, &peer_addr_len);
+static bool parse_peer_info(const uv_tcp_t* client, std::pair<std::string, int>& peer) {
+  sockaddr_storage peer_addr {};
+  int peer_addr_len = sizeof(peer_addr);
+  auto err_code = uv_tcp_getpeername(client, reinterpret_cast<sockaddr*>(&peer_addr), &peer_addr_len);
   if (err_code != 0) {
     return false;
   }
   char host[NI_MAXHOST], service[NI_MAXSERV];
-  if (getnameinfo(peer_addr, peer_addr_len, host, NI_MAXHOST, service, NI_MAXSERV, NI_NUMERICSERV) == 0) {
+  if (getnameinfo(reinterpret_cast<sockaddr*>(&peer_addr), peer_addr_len, host, NI_MAXHOST, service, NI_MAXSERV,
+                  NI_NUMERICHOST | NI_NUMERICSERV) == 0) {
     peer.first = std::string(host);
     peer.second = std::strtol(service, nullptr, 10);
     return true;
@@ -180,183 +247,538 @@ static bool parse_peer_info(uv_stream_t* client, std::pair<std::string, int>& pe
   return false;
 }
 
-typedef struct {
-  uv_write_t req;
-  uv_buf_t buf;
-} write_req_t;
+inline void RequestBuffer::handle(const ConnectionPtr& conn, const uint64_t seq) {
+  stage_ = RequestBufferStage::HANDLING;
+  if (protocol_ == Protocol::HTTP) {
+    auto& http_req = with_http_request();
+    http_req.from = conn->peer();
+    http_req.handle([conn, seq, keep_alive = http_req.keep_alive](char* resp, size_t resp_size, http::BodyRefs body) {
+      conn->respond(seq, resp, resp_size, keep_alive, std::move(body));
+    });
+    stage_ = RequestBufferStage::COMPLETE;
+    return;
+  }
+  spdlog::error("Illegal protocol");
+  // 占住序号，保证后续响应能写出
+  conn->respond(seq, nullptr, 0, false);
+}
 
-static void clean_after_send(uv_write_t* req, int status) {
-  if (status) {
-    fprintf(stderr, "Write error %s\n", uv_strerror(status));
+inline ConnectionPtr Connection::accept(Reactor* reactor, uv_stream_t* server) {
+  ConnectionPtr conn {new Connection()};
+  conn->reactor_ = reactor;
+  uv_tcp_init(&reactor->loop, &conn->handle_);
+  uv_timer_init(&reactor->loop, &conn->idle_timer_);
+  conn->handle_.data = conn.get();
+  conn->idle_timer_.data = conn.get();
+  conn->open_handles_ = 2;
+  conn->self_ = conn;
+  reactor->stats.active++;
+  if (uv_accept(server, conn->stream()) != 0) {
+    conn->close();
+    return nullptr;
   }
-  write_req_t* wr = reinterpret_cast<write_req_t*>(req);
-  free(wr->buf.base);
-  free(wr);
+  if (!parse_peer_info(&conn->handle_, conn->peer_)) {
+    spdlog::warn("failed to parse peer info");
+  }
+  reactor->stats.accepted++;
+  conn->parsing_ = std::make_shared<RequestBuffer>();
+  conn->update_reading();
+  conn->touch();
+  return conn;
 }
 
-struct ClientResp {
-  write_req_t* write_req;
-  uv_stream_t* client;
+inline void Connection::respond(const uint64_t seq, char* resp, const size_t resp_size, const bool keep_alive,
+                                http::BodyRefs body) {
+  reactor_->completions.push(
+      Completion{shared_from_this(), seq, Response{resp, resp_size, keep_alive, std::move(body)}});
+  // 多次 send 在 loop 线程可能只回调一次，回调中会取完队列
+  uv_async_send(&reactor_->resp_notify);
+}
 
-  ClientResp(write_req_t* w, uv_stream_t* c) : write_req(w), client(c) {}
-};
+inline bool Connection::on_response(const uint64_t seq, Response resp) {
+  if (closed_) {
+    free(resp.data);
+    return false;
+  }
+  ready_[seq] = std::move(resp);
+  if (flush_scheduled_ || seq != next_write_) {
+    return false;
+  }
+  flush_scheduled_ = true;
+  return true;
+}
 
-static void write_resp(uv_work_t* work) {
-  auto client_resp = static_cast<ClientResp*>(work->data);
-  // client 和 buf 由 uv_write 回收内存？
-  // clean_after_send 负责回收 work-> data 和 work 的内存
-  uv_write(reinterpret_cast<uv_write_t*>(client_resp->write_req), client_resp->client, &client_resp->write_req->buf,
-    1, clean_after_send);
+inline void Connection::on_data(utils::IOBlock* block, const size_t nread) {
+  // 安全防护
+  if (in_.size() + nread >= REQUEST_SIZE_LIMIT) {
+    spdlog::warn("request size exceed limit!");
+    drain();
+    return;
+  }
+  in_.append(block, 0, nread);
+  reactor_->stats.bytes_in += nread;
+  touch();
+  process();
 }
 
-static void after_write_resp(uv_work_t* w, int status) {
-  delete static_cast<ClientResp*>(w->data);
-  delete w;
+inline void Connection::on_eof() {
+  drain();
 }
 
-inline void RequestBuffer::handle(uv_stream_t *client) {
-  stage_ = RequestBufferStage::HANDLING;
-  if (protocol_ == Protocol::HTTP) {
-    auto& http_req = with_http_request();
-    if (!parse_peer_info(client, http_req.from)) {
-      spdlog::warn("failed to parse peer info");
+inline void Connection::process() {
+  while (!draining_ && !in_.empty() && next_seq_ - next_write_ < options_.max_pipelined_requests) {
+    const auto status = parsing_->try_parse(in_);
+    if (status == ParseStatus::CONTINUE) { // 还没接收完成的请求
+      break;
+    }
+    if (status == ParseStatus::INVALID) { // 不合法的请求，已分发的请求照常响应
+      spdlog::error("Illegal request");
+      drain();
+      break;
+    }
+    // 请求完整了，交给处理线程，后续数据由新的请求缓冲解析
+    const auto seq = next_seq_++;
+    reactor_->stats.requests++;
+    auto& http_req = parsing_->with_http_request();
+    if (options_.max_keep_alive_requests > 0 && next_seq_ >= options_.max_keep_alive_requests) {
+      http_req.keep_alive = false;
+    }
+    if (!http_req.keep_alive) {
+      drain();
     }
-    http_req.handle([client](char* resp, size_t resp_size) {
-      auto req = static_cast<write_req_t*>(malloc(sizeof(write_req_t)));
-      req->buf = uv_buf_init(resp, resp_size);
-      //
-      auto* work = new uv_work_t();
-      work->data = new ClientResp(req, client);
-      // 排队由 loop_ 来统一处理
-      uv_queue_work(loop_.get(), work, write_resp, after_write_resp);
+    utils::default_executor().async_execute([conn = shared_from_this(), req = parsing_, seq]() {
+      req->handle(conn, seq);
     });
-    stage_ = RequestBufferStage::COMPLETE;
-    RequestBufferManager::instance().free_req_buffer(http_req.from.first+":"+std::to_string(http_req.from.second)); //
+    parsing_ = std::make_shared<RequestBuffer>();
+  }
+  update_reading();
+  maybe_close();
+}
+
+inline void Connection::flush() {
+  flush_scheduled_ = false;
+  if (closed_ || sending_.file != nullptr) {
     return;
   }
-  spdlog::error("Illegal protocol");
+  auto* wr = new WriteReq();
+  wr->req.data = wr;
+  size_t bytes = 0;
+  bool last = false;
+  while (true) {
+    // 先写当前响应剩下的 body，遇到文件时停下，文件在之前的部分写完后发送，之后的部分等文件发送完
+    while (!pending_.empty() && (pending_.front().file == nullptr || pending_.front().length == 0)) {
+      auto& ref = pending_.front();
+      if (ref.memory != nullptr && ref.length > 0) {
+        wr->bufs.emplace_back(uv_buf_init(const_cast<char*>(ref.memory->data()) + ref.offset, ref.length));
+        wr->pinned.emplace_back(std::move(ref.memory));
+        bytes += ref.length;
+      }
+      pending_.pop_front();
+    }
+    if (!pending_.empty()) {
+      sending_ = std::move(pending_.front());
+      pending_.pop_front();
+      wr->then_file = true;
+      break;
+    }
+    // 不保持连接的响应之后不会再有响应
+    if (last) {
+      break;
+    }
+    const auto it = ready_.find(next_write_);
+    if (it == ready_.end()) {
+      break;
+    }
+    auto resp = std::move(it->second);
+    ready_.erase(it);
+    next_write_++;
+    if (resp.data != nullptr) {
+      wr->bufs.emplace_back(uv_buf_init(resp.data, resp.size));
+      wr->owned.emplace_back(resp.data);
+      bytes += resp.size;
+      pending_.assign(std::make_move_iterator(resp.body.begin()), std::make_move_iterator(resp.body.end()));
+    }
+    if (!resp.keep_alive) {
+      drain();
+      last = true;
+    }
+  }
+  if (wr->bufs.empty()) {
+    const bool then_file = wr->then_file;
+    delete wr;
+    // 只在上一段文件发送完后出现，此时没有在写的数据，可以直接发送
+    if (then_file) {
+      send_file();
+      return;
+    }
+  } else if (const auto r = uv_write(&wr->req, stream(), wr->bufs.data(), wr->bufs.size(), on_write); r != 0) {
+    spdlog::warn("failed to write response: {}", uv_strerror(r));
+    for (auto* data : wr->owned) {
+      free(data);
+    }
+    delete wr;
+    close();
+    return;
+  } else {
+    writes_in_flight_++;
+    bytes_queued_ += bytes;
+    reactor_->stats.bytes_out += bytes;
+  }
+  touch();
+  // 流水线请求少于上限后继续解析
+  process();
+}
+
+// 非阻塞 socket 上从 fd 的 offset 处发送至多 len 字节，返回发送的字节数，出错时返回 -1 并设置 errno
+static ssize_t sendfile_nonblock(const int sock, const int fd, const off_t offset, const size_t len) {
+#if defined(__APPLE__)
+  off_t sent = static_cast<off_t>(len);
+  if (sendfile(fd, sock, offset, &sent, nullptr, 0) != 0 && !(errno == EAGAIN && sent > 0)) {
+    return -1;
+  }
+  return sent;
+#else
+  off_t off = offset;
+  return sendfile(sock, fd, &off, len);
+#endif
+}
+
+inline void Connection::send_file() {
+  uv_os_fd_t sock;
+  if (closed_ || uv_fileno(reinterpret_cast<uv_handle_t*>(&handle_), &sock) != 0) {
+    close();
+    return;
+  }
+  size_t budget = SENDFILE_BYTES_PER_TURN;
+  while (sending_.length > 0) {
+    if (budget == 0) { // 让出 loop，其他连接也能发送
+      wait_writable(sock);
+      return;
+    }
+    const auto n = sendfile_nonblock(sock, sending_.file->fd, sending_.offset, std::min(sending_.length, budget));
+    if (n > 0) {
+      sending_.offset += n;
+      sending_.length -= n;
+      budget -= n;
+      reactor_->stats.bytes_out += n;
+      touch();
+      continue;
+    }
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      wait_writable(sock);
+      return;
+    }
+    // 文件在发送过程中被截断，已声明的 Content-Length 无法满足，只能断开
+    spdlog::warn("sendfile failed: {}", n == 0 ? "unexpected end of file" : strerror(errno));
+    close();
+    return;
+  }
+  if (writable_fd_ >= 0) {
+    uv_poll_stop(&writable_);
+  }
+  sending_ = {};
+  flush();
 }
 
-inline RequestBufferManager::RequestBufferManager() {
-  cleanup_future_ = std::async(std::launch::async, [&]() {
-      while (!exit_flag_) {
-        if (request_buffers_.empty()) {
-          std::this_thread::sleep_for(std::chrono::seconds(30));
-        }
-        std::vector<std::string> keys_to_cleanup;
-        auto now = std::chrono::system_clock::now();
-        for (const auto& [k, v] : request_buffers_) {
-          std::lock_guard lock{mutex_};
-          if (request_buffers_.count(k) == 0 || v == nullptr) {
-            continue;
-          }
-          if ((now - v->last_fill_time()) > std::chrono::seconds(300)) {
-            keys_to_cleanup.emplace_back(k);
-          }
-        }
-        if (keys_to_cleanup.empty()) {
-          std::this_thread::sleep_for(std::chrono::seconds(30));
-          continue;
-        }
-        std::lock_guard lock{mutex_};
-        for (const auto& k : keys_to_cleanup) {
-          request_buffers_.erase(k);
-        }
+inline void Connection::wait_writable(const int sock) {
+  if (writable_fd_ < 0) {
+    writable_fd_ = dup(sock);
+    if (writable_fd_ < 0 || uv_poll_init_socket(&reactor_->loop, &writable_, writable_fd_) != 0) {
+      spdlog::warn("failed to poll socket: {}", strerror(errno));
+      if (writable_fd_ >= 0) {
+        ::close(writable_fd_);
+        writable_fd_ = -1;
       }
-    });
+      close();
+      return;
+    }
+    writable_.data = this;
+    open_handles_++;
+  }
+  uv_poll_start(&writable_, UV_WRITABLE, on_writable);
 }
 
-// ---------------------------------------------------------------------------------------------------------------------
+inline void Connection::on_writable(uv_poll_t* poll, const int status, int events) {
+  auto* conn = from(reinterpret_cast<uv_handle_t*>(poll));
+  if (status < 0) {
+    spdlog::warn("poll error: {}", uv_strerror(status));
+    conn->close();
+    return;
+  }
+  conn->send_file();
+}
 
-namespace connection {
+inline void Connection::drain() {
+  if (draining_) {
+    return;
+  }
+  draining_ = true;
+  in_.clear();
+  update_reading();
+}
+
+inline void Connection::maybe_close() {
+  if (draining_ && next_write_ == next_seq_ && writes_in_flight_ == 0 && sending_.file == nullptr && pending_.empty()) {
+    close();
+  }
+}
+
+inline void Connection::update_reading() {
+  if (closed_) {
+    return;
+  }
+  // 流水线请求过多或者即将关闭时暂停读
+  const bool want = !draining_ && next_seq_ - next_write_ < options_.max_pipelined_requests;
+  if (want == reading_) {
+    return;
+  }
+  reading_ = want;
+  if (want) {
+    uv_read_start(stream(), alloc_buffer, on_read);
+  } else {
+    uv_read_stop(stream());
+  }
+}
+
+inline void Connection::touch() {
+  if (closed_ || options_.keep_alive_timeout_ms == 0) {
+    return;
+  }
+  uv_timer_start(&idle_timer_, on_idle, options_.keep_alive_timeout_ms, 0);
+}
 
-static void alloc_buffer(uv_handle_t *handle, size_t suggested_size, uv_buf_t *buf) {
-  buf->base = static_cast<char*>(malloc(suggested_size));
-  buf->len = suggested_size;
+inline void Connection::close() {
+  if (closed_) {
+    return;
+  }
+  closed_ = true;
+  uv_close(reinterpret_cast<uv_handle_t*>(&handle_), on_close);
+  uv_close(reinterpret_cast<uv_handle_t*>(&idle_timer_), on_close);
+  if (writable_fd_ >= 0) {
+    uv_close(reinterpret_cast<uv_handle_t*>(&writable_), on_close);
+  }
 }
 
-static void on_close(uv_handle_t* handle) {
-  free(handle);
+// 直接读入池化的块，on_read 中再以引用的方式挂到连接的缓冲上
+inline void Connection::alloc_buffer(uv_handle_t* handle, size_t suggested_size, uv_buf_t* buf) {
+  auto* block = utils::IOBlock::acquire();
+  buf->base = block->data();
+  buf->len = block->capacity();
 }
 
-static void on_read(uv_stream_t *client, ssize_t nread, const uv_buf_t *buf) {
+inline void Connection::on_read(uv_stream_t* client, const ssize_t nread, const uv_buf_t* buf) {
+  auto* conn = from(reinterpret_cast<uv_handle_t*>(client));
   if (nread > 0) {
-    // accept 需要将 buf 的内容拷贝一份
-    // 返回 true，则表示请求体已接收完整
-    std::pair<std::string, int> peer_info;
-    if (parse_peer_info(client, peer_info)) {
-      auto peer = peer_info.first + ":" + std::to_string(peer_info.second);
-      auto req_buffer = RequestBufferManager::instance().with_req_buffer(peer);
-      auto status = req_buffer->accept(buf, nread);
-      if (status == ParseStatus::COMPLETE) { // 请求完整了
-        utils::default_executor().async_execute([client, req_buffer]() {
-          req_buffer->handle(client);
-        });
-      } else if (status == ParseStatus::INVALID) { // 不合法的请求
-        spdlog::error("Illegal request");
-      } else {} // 还没接收完成的请求
-    }
+    conn->on_data(utils::IOBlock::from_data(buf->base), nread);
+  } else if (nread == UV_EOF) {
+    conn->on_eof();
   } else if (nread < 0) {
-    if (nread != UV_EOF) {
-      fprintf(stderr, "Read error %s\n", uv_err_name(nread));
+    fprintf(stderr, "Read error %s\n", uv_err_name(nread));
+    conn->close();
+  }
+  // 释放本次读的引用，数据若已挂到连接的缓冲上则由其继续持有
+  if (buf->base != nullptr) {
+    utils::IOBlock::from_data(buf->base)->unref();
+  }
+}
+
+inline void Connection::on_write(uv_write_t* req, const int status) {
+  // 关闭连接时未完成的写会先以 UV_ECANCELED 回调，此时连接仍有效
+  auto* conn = from(reinterpret_cast<uv_handle_t*>(req->handle));
+  conn->writes_in_flight_--;
+  auto* wr = static_cast<WriteReq*>(req->data);
+  const bool then_file = wr->then_file;
+  for (auto* data : wr->owned) {
+    free(data);
+  }
+  delete wr;
+  if (status != 0) {
+    if (status != UV_ECANCELED) {
+      spdlog::warn("write error: {}", uv_strerror(status));
     }
-    uv_close(reinterpret_cast<uv_handle_t*>(client), on_close);
+    conn->close();
+    return;
   }
-  //
-  free(buf->base);
+  if (then_file) {
+    conn->send_file();
+    return;
+  }
+  conn->maybe_close();
 }
 
-static bool handle(const LoopPtr& loop_, uv_stream_t* server) {
-  uv_tcp_t *client = static_cast<uv_tcp_t*>(malloc(sizeof(uv_tcp_t)));
-  uv_tcp_init(loop_.get(), client);
-  if (uv_accept(server, reinterpret_cast<uv_stream_t*>(client)) == 0) {
-    // on_read 要负责释放 client 的内存
-    uv_read_start(reinterpret_cast<uv_stream_t*>(client), alloc_buffer, on_read);
-    return true;
+inline void Connection::on_idle(uv_timer_t* timer) {
+  auto* conn = from(reinterpret_cast<uv_handle_t*>(timer));
+  // 文件发送在超时时间内没有进展，对端不再读
+  if (conn->sending_.file != nullptr) {
+    spdlog::warn("file sending to {}:{} stalled", conn->peer_.first, conn->peer_.second);
+    conn->close();
+    return;
   }
-  // on_close 要负责释放 client 的内存
-  uv_close(reinterpret_cast<uv_handle_t*>(client), on_close);
-  return false;
+  // 写在超时时间内没有进展，同样是对端不再读
+  if (conn->writes_in_flight_ > 0) {
+    const auto flushed = conn->bytes_queued_ - uv_stream_get_write_queue_size(conn->stream());
+    if (flushed == conn->bytes_flushed_at_idle_) {
+      spdlog::warn("writing to {}:{} stalled", conn->peer_.first, conn->peer_.second);
+      conn->close();
+      return;
+    }
+    conn->bytes_flushed_at_idle_ = flushed;
+    conn->touch();
+    return;
+  }
+  // 还有在处理的请求时不算空闲
+  if (conn->next_write_ < conn->next_seq_) {
+    conn->touch();
+    return;
+  }
+  conn->close();
 }
 
+inline void Connection::on_close(uv_handle_t* handle) {
+  auto* conn = from(handle);
+  if (handle == reinterpret_cast<uv_handle_t*>(&conn->writable_)) {
+    ::close(conn->writable_fd_);
+    conn->writable_fd_ = -1;
+  }
+  if (--conn->open_handles_ > 0) {
+    return;
+  }
+  conn->sending_ = {};
+  conn->pending_.clear();
+  conn->in_.clear();
+  conn->parsing_.reset();
+  for (auto& [_, resp] : conn->ready_) {
+    free(resp.data);
+  }
+  conn->ready_.clear();
+  conn->reactor_->stats.active--;
+  // 可能是最后一个引用，放在最后
+  conn->self_.reset();
 }
 
-//----------------------------------------------------------------------------------------------------------------------
+// ---------------------------------------------------------------------------------------------------------------------
 
-static std::shared_ptr<uv_tcp_t> tcp_server_;
+namespace connection {
+
+static void on_resp_ready(uv_async_t* handle) {
+  auto* reactor = static_cast<Reactor*>(handle->data);
+  // 先收下所有响应，每个连接只 flush 一次，同一连接的多个响应合并写出
+  std::vector<ConnectionPtr> conns;
+  Completion completion;
+  while (reactor->completions.pop(completion)) {
+    if (completion.conn->on_response(completion.seq, completion.resp)) {
+      conns.emplace_back(std::move(completion.conn));
+    }
+  }
+  for (const auto& conn : conns) {
+    conn->flush();
+  }
+}
 
 static void on_new_connection(uv_stream_t* server, int status) {
   if (status != 0) {
     spdlog::error("New connection failed: {}", status);
     return;
   }
-  if (!connection::handle(loop_, server)) {
+  // 连接关闭时由 Connection::on_close 释放
+  if (Connection::accept(static_cast<Reactor*>(server->data), server) == nullptr) {
     spdlog::error("Failed to handle connection.");
   }
 }
 
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+// 各 loop 的统计，可在任意线程调用
+static nlohmann::json loop_stats() {
+  nlohmann::json stats = nlohmann::json::array();
+  for (const auto& reactor : reactors_) {
+    stats.push_back({
+        {"loop", reactor->id},
+        {"accepted", reactor->stats.accepted.load()},
+        {"active", reactor->stats.active.load()},
+        {"requests", reactor->stats.requests.load()},
+        {"bytes_in", reactor->stats.bytes_in.load()},
+        {"bytes_out", reactor->stats.bytes_out.load()},
+    });
+  }
+  return stats;
+}
+
+// 初始化 loop 并监听；多个 loop 时各自的监听 socket 以 SO_REUSEPORT 绑定同一地址，由内核分配连接
+static bool listen_on(Reactor& reactor, const sockaddr* addr, const bool reuse_port) {
+  uv_loop_init(&reactor.loop);
+  uv_async_init(&reactor.loop, &reactor.resp_notify, connection::on_resp_ready);
+  reactor.resp_notify.data = &reactor;
+  uv_tcp_init_ex(&reactor.loop, &reactor.server, addr->sa_family);
+  reactor.server.data = &reactor;
+#ifdef SO_REUSEPORT
+  if (reuse_port) {
+    uv_os_fd_t fd;
+    int on = 1;
+    if (uv_fileno(reinterpret_cast<uv_handle_t*>(&reactor.server), &fd) != 0 ||
+        setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) != 0) {
+      spdlog::error("failed to set SO_REUSEPORT: {}", strerror(errno));
+      return false;
+    }
+  }
+#endif
+  if (const int r = uv_tcp_bind(&reactor.server, addr, 0); r) {
+    spdlog::error("bind failed: {}", uv_strerror(r));
+    return false;
+  }
+  if (const int r = uv_listen(reinterpret_cast<uv_stream_t*>(&reactor.server), DEFAULT_BACKLOG,
+                              connection::on_new_connection); r) {
+    spdlog::error("listen failed: {}", uv_strerror(r));
+    return false;
+  }
+  return true;
+}
+
 static void cleanup_before_exit() {
   utils::default_executor().join();
+  spdlog::info("loop stats: {}", loop_stats().dump());
 }
 
-static bool start_server(const std::string& host, int port) {
-  loop_.reset(uv_default_loop());
-  tcp_server_ = std::make_shared<uv_tcp_t>();
-  uv_tcp_init(loop_.get(), tcp_server_.get());
+static bool start_server(const std::string& host, int port, const ServerOptions& options = {}) {
+  options_ = options;
+  size_t threads = options_.threads > 0 ? options_.threads : std::max(1u, std::thread::hardware_concurrency());
+#ifndef SO_REUSEPORT
+  if (threads > 1) {
+    spdlog::warn("SO_REUSEPORT is not supported, fallback to single loop");
+    threads = 1;
+  }
+#endif
   //
   sockaddr_in addr{};
   uv_ip4_addr(host.c_str(), port, &addr);
   //
-  uv_tcp_bind(tcp_server_.get(), reinterpret_cast<const sockaddr*>(&addr), 0);
-  //
-  int r = uv_listen(reinterpret_cast<uv_stream_t*>(tcp_server_.get()), DEFAULT_BACKLOG, on_new_connection);
-  if (r) {
-    spdlog::error("listen failed: {}", uv_strerror(r));
-    return false;
+  for (size_t idx = 0; idx < threads; idx++) {
+    auto reactor = std::make_unique<Reactor>();
+    reactor->id = idx;
+    if (!listen_on(*reactor, reinterpret_cast<const sockaddr*>(&addr), threads > 1)) {
+      return false;
+    }
+    reactors_.emplace_back(std::move(reactor));
+  }
+  spdlog::info("server runs with {} loop(s)", threads);
+  // 第一个 loop 在当前线程运行
+  std::vector<std::thread> workers;
+  for (size_t idx = 1; idx < threads; idx++) {
+    workers.emplace_back([reactor = reactors_[idx].get()]() {
+      uv_run(&reactor->loop, UV_RUN_DEFAULT);
+    });
+  }
+  bool ret_status = uv_run(&reactors_[0]->loop, UV_RUN_DEFAULT);
+  for (auto& worker : workers) {
+    worker.join();
   }
-  bool ret_status = uv_run(loop_.get(), UV_RUN_DEFAULT);
   cleanup_before_exit();
   return ret_status;
 }
 
-}
\ No newline at end of file
+}
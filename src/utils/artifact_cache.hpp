@@ -0,0 +1,277 @@
+#pragma once
+
+/*
+ * 渲染类插件共用的内容寻址缓存
+ *
+ * - 缓存键：sha256(插件名, 插件版本, 输入)，与标准库实现无关，跨平台、跨版本稳定
+ * - 布局：<dir>/<插件名>/<key>，写入先落临时文件再 rename，并发构建也不会读到半个文件
+ * - 淘汰：总大小超过上限时按最近访问时间（文件 mtime，命中时刷新）淘汰最久未用的
+ * - 统计：按插件记录本次构建的命中/未命中/写入/淘汰次数
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include <absl/strings/string_view.h>
+#include <fmt/core.h>
+#include <spdlog/spdlog.h>
+
+#include "utils/hash.hpp"
+#include "utils/helper.hpp"
+#include "utils/strings.hpp"
+
+namespace ling::utils {
+
+struct ArtifactStats {
+  uint64_t hits {0};
+  uint64_t misses {0};
+  uint64_t writes {0};
+  uint64_t evictions {0};
+};
+
+class ArtifactCache final {
+public:
+  static ArtifactCache& singleton() {
+    static ArtifactCache cache;
+    return cache;
+  }
+
+  ArtifactCache(const ArtifactCache&) = delete;
+  ArtifactCache& operator=(const ArtifactCache&) = delete;
+
+  // 需在插件 init 之前设置，max_bytes 为 0 表示不淘汰
+  void configure(const std::filesystem::path& dir, uint64_t max_bytes);
+  // 各字段带长度前缀，避免 ("ab", "c") 与 ("a", "bc") 拼接后相同
+  static std::string make_key(absl::string_view plugin, absl::string_view version, absl::string_view input);
+
+  // 命中时读出内容并刷新访问时间
+  bool get(const std::string& plugin, const std::string& key, std::string& data);
+  bool put(const std::string& plugin, const std::string& key, const std::string& data);
+  // 将已生成的文件（如 PDF）移入缓存，避免整个读入内存
+  bool put_file(const std::string& plugin, const std::string& key, const std::filesystem::path& src);
+  // 查缓存并发布到对外可见的位置（如 plantuml-images），计入命中/未命中
+  // overwrite 为 false 时 dest 已存在视为命中：dest 以缓存键命名，同名即同内容
+  bool publish(const std::string& plugin, const std::string& key, const std::filesystem::path& dest,
+               bool overwrite = false);
+  // 只发布不计数，用于 put 之后；优先硬链接，不支持时复制
+  bool link(const std::string& plugin, const std::string& key, const std::filesystem::path& dest) const;
+
+  // 按 LRU 淘汰到上限以下，返回淘汰的文件数
+  uint64_t evict();
+  std::map<std::string, ArtifactStats> stats();
+  // 输出本次构建的统计并清零
+  void report();
+
+  [[nodiscard]] std::filesystem::path path_of(const std::string& plugin, const std::string& key) const {
+    return dir_ / plugin / key;
+  }
+
+private:
+  ArtifactCache() = default;
+
+  void count(const std::string& plugin, uint64_t ArtifactStats::* field) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    stats_[plugin].*field += 1;
+  }
+  bool ensure_dir(const std::string& plugin);
+
+private:
+  std::mutex mtx_;
+  std::filesystem::path dir_ {".artifact_cache"};
+  uint64_t max_bytes_ {512ull << 20};
+  std::map<std::string, ArtifactStats> stats_;
+};
+
+inline void ArtifactCache::configure(const std::filesystem::path& dir, const uint64_t max_bytes) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  dir_ = dir;
+  max_bytes_ = max_bytes;
+}
+
+inline std::string ArtifactCache::make_key(const absl::string_view plugin, const absl::string_view version,
+                                           const absl::string_view input) {
+  std::string material;
+  material.reserve(plugin.size() + version.size() + input.size() + 32);
+  for (const auto field : {plugin, version, input}) {
+    material.append(std::to_string(field.size())).push_back(':');
+    material.append(field.data(), field.size());
+  }
+  return sha256_hex(material);
+}
+
+inline bool ArtifactCache::ensure_dir(const std::string& plugin) {
+  std::error_code ec;
+  create_directories(dir_ / plugin, ec);
+  return !ec;
+}
+
+inline bool ArtifactCache::get(const std::string& plugin, const std::string& key, std::string& data) {
+  const auto fp = path_of(plugin, key);
+  std::error_code ec;
+  if (!exists(fp, ec)) {
+    count(plugin, &ArtifactStats::misses);
+    return false;
+  }
+  data = read_file_all(fp);
+  last_write_time(fp, std::filesystem::file_time_type::clock::now(), ec);
+  count(plugin, &ArtifactStats::hits);
+  return true;
+}
+
+inline bool ArtifactCache::put(const std::string& plugin, const std::string& key, const std::string& data) {
+  if (!ensure_dir(plugin) || !write_file_atomic(path_of(plugin, key), data)) {
+    spdlog::warn("failure to write artifact {}/{}", plugin, key);
+    return false;
+  }
+  count(plugin, &ArtifactStats::writes);
+  return true;
+}
+
+inline bool ArtifactCache::put_file(const std::string& plugin, const std::string& key,
+                                    const std::filesystem::path& src) {
+  const auto fp = path_of(plugin, key);
+  std::error_code ec;
+  if (ensure_dir(plugin)) {
+    // 同一文件系统内 rename 即可，跨文件系统时先复制到临时文件
+    rename(src, fp, ec);
+    if (ec) {
+      auto tmp_path = fp;
+      tmp_path += ".tmp." + std::to_string(getpid()) + "." +
+                  std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+      ec.clear();
+      copy_file(src, tmp_path, std::filesystem::copy_options::overwrite_existing, ec);
+      if (!ec) {
+        rename(tmp_path, fp, ec);
+      }
+      if (ec) {
+        std::filesystem::remove(tmp_path, ec);
+      }
+    }
+  }
+  if (!exists(fp, ec)) {
+    spdlog::warn("failure to move {} into artifact {}/{}", src.string(), plugin, key);
+    return false;
+  }
+  count(plugin, &ArtifactStats::writes);
+  return true;
+}
+
+inline bool ArtifactCache::publish(const std::string& plugin, const std::string& key,
+                                   const std::filesystem::path& dest, const bool overwrite) {
+  const auto fp = path_of(plugin, key);
+  std::error_code ec;
+  const bool cached = exists(fp, ec);
+  if (cached) {
+    last_write_time(fp, std::filesystem::file_time_type::clock::now(), ec);
+  }
+  if (!overwrite && exists(dest, ec)) {
+    count(plugin, &ArtifactStats::hits);
+    return true;
+  }
+  if (!cached || !link(plugin, key, dest)) {
+    count(plugin, &ArtifactStats::misses);
+    return false;
+  }
+  count(plugin, &ArtifactStats::hits);
+  return true;
+}
+
+inline bool ArtifactCache::link(const std::string& plugin, const std::string& key,
+                                const std::filesystem::path& dest) const {
+  const auto fp = path_of(plugin, key);
+  std::error_code ec;
+  create_directories(dest.parent_path(), ec);
+  // 先链接/复制到临时文件再 rename，其他线程不会看到不完整的 dest
+  auto tmp_path = dest;
+  tmp_path += ".tmp." + std::to_string(getpid()) + "." +
+              std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+  std::filesystem::remove(tmp_path, ec);
+  create_hard_link(fp, tmp_path, ec);
+  if (ec) {
+    ec.clear();
+    copy_file(fp, tmp_path, std::filesystem::copy_options::overwrite_existing, ec);
+  }
+  if (!ec) {
+    rename(tmp_path, dest, ec);
+  }
+  if (ec) {
+    std::filesystem::remove(tmp_path, ec);
+    spdlog::warn("failure to publish artifact {}/{} to {}", plugin, key, dest.string());
+    return false;
+  }
+  return true;
+}
+
+inline uint64_t ArtifactCache::evict() {
+  struct Entry {
+    std::filesystem::path path;
+    std::string plugin;
+    uint64_t size;
+    std::filesystem::file_time_type atime;
+  };
+  std::lock_guard<std::mutex> lock(mtx_);
+  std::error_code ec;
+  if (max_bytes_ == 0 || !exists(dir_, ec)) {
+    return 0;
+  }
+  std::vector<Entry> entries;
+  uint64_t total = 0;
+  for (auto it = std::filesystem::recursive_directory_iterator(dir_, ec);
+       !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+    if (!it->is_regular_file(ec)) {
+      continue;
+    }
+    const auto size = it->file_size(ec);
+    const auto atime = it->last_write_time(ec);
+    if (ec) {
+      ec.clear();
+      continue;
+    }
+    total += size;
+    entries.push_back(Entry{it->path(), it->path().parent_path().filename().string(), size, atime});
+  }
+  if (total <= max_bytes_) {
+    return 0;
+  }
+  std::sort(entries.begin(), entries.end(), [](const Entry& e1, const Entry& e2) {
+    return e1.atime < e2.atime;
+  });
+  uint64_t evicted = 0;
+  for (const auto& entry : entries) {
+    if (total <= max_bytes_) {
+      break;
+    }
+    if (std::filesystem::remove(entry.path, ec)) {
+      total -= entry.size;
+      evicted++;
+      stats_[entry.plugin].evictions++;
+    }
+  }
+  spdlog::info("artifact cache evicted {} files, {} bytes left", evicted, total);
+  return evicted;
+}
+
+inline std::map<std::string, ArtifactStats> ArtifactCache::stats() {
+  std::lock_guard<std::mutex> lock(mtx_);
+  return stats_;
+}
+
+inline void ArtifactCache::report() {
+  std::lock_guard<std::mutex> lock(mtx_);
+  for (const auto& [plugin, st] : stats_) {
+    spdlog::info("artifact cache [{}] hits: {}, misses: {}, writes: {}, evictions: {}", plugin, st.hits, st.misses,
+                 st.writes, st.evictions);
+  }
+  stats_.clear();
+}
+
+}  // namespace ling::utils
@@ -0,0 +1,141 @@
+#pragma once
+
+/*
+ * 插件执行的时间预算
+ *
+ * - 插件调度器为每个插件设置截止时间（单插件预算与整篇文档预算取较早者），经 thread_local 传递，
+ *   插件自建的工作线程需用 Deadline::Scope 显式继承
+ * - 阻塞调用（cpr 请求、子进程、管道读写）以剩余时间为超时，到期后放弃剩余条目，保留原始元素
+ * - 放弃的条目记入 TimeoutReport，构建结束时统一输出
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ling::utils {
+
+class Deadline final {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  // 默认不限时
+  Deadline() = default;
+  explicit Deadline(const Clock::time_point at) : at_(at) {}
+
+  // budget 为 0 表示不限时
+  static Deadline after(const std::chrono::milliseconds budget) {
+    return budget.count() > 0 ? Deadline(Clock::now() + budget) : Deadline();
+  }
+  static Deadline earliest(const Deadline& d1, const Deadline& d2) {
+    if (d1.unlimited()) {
+      return d2;
+    }
+    if (d2.unlimited()) {
+      return d1;
+    }
+    return Deadline(std::min(*d1.at_, *d2.at_));
+  }
+
+  bool unlimited() const {
+    return !at_.has_value();
+  }
+  bool expired() const {
+    return at_.has_value() && Clock::now() >= *at_;
+  }
+  // 剩余时间，不超过 cap；已到期时返回 0
+  std::chrono::milliseconds remaining(const std::chrono::milliseconds cap) const {
+    if (!at_.has_value()) {
+      return cap;
+    }
+    const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(*at_ - Clock::now());
+    return std::clamp(left, std::chrono::milliseconds(0), cap);
+  }
+  // 用作阻塞调用的超时参数，至少 1ms：cpr 等以 0 表示不超时
+  std::chrono::milliseconds timeout(const std::chrono::milliseconds cap) const {
+    return std::max(remaining(cap), std::chrono::milliseconds(1));
+  }
+
+  // 当前线程的截止时间与归属（如 "PlantUML@post-id"），未设置时不限时
+  static const Deadline& current();
+  static const std::string& current_owner();
+
+  // 在作用域内设置当前线程的截止时间，退出时恢复
+  class Scope;
+
+private:
+  static std::pair<Deadline, std::string>& current_slot();
+
+private:
+  std::optional<Clock::time_point> at_;
+};
+
+class Deadline::Scope final {
+public:
+  explicit Scope(const Deadline& deadline) : Scope(deadline, current_owner()) {}
+  Scope(const Deadline& deadline, std::string owner) : saved_(current_slot()) {
+    current_slot() = {deadline, std::move(owner)};
+  }
+  Scope(const Scope&) = delete;
+  Scope& operator=(const Scope&) = delete;
+  ~Scope() {
+    current_slot() = std::move(saved_);
+  }
+
+private:
+  std::pair<Deadline, std::string> saved_;
+};
+
+inline std::pair<Deadline, std::string>& Deadline::current_slot() {
+  thread_local std::pair<Deadline, std::string> slot;
+  return slot;
+}
+
+inline const Deadline& Deadline::current() {
+  return current_slot().first;
+}
+
+inline const std::string& Deadline::current_owner() {
+  return current_slot().second;
+}
+
+class TimeoutReport final {
+public:
+  static TimeoutReport& singleton() {
+    static TimeoutReport report;
+    return report;
+  }
+
+  TimeoutReport(const TimeoutReport&) = delete;
+  TimeoutReport& operator=(const TimeoutReport&) = delete;
+
+  void add(const std::string& owner, const std::string& item) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    items_.emplace_back(owner.empty() ? "unknown" : owner, item);
+  }
+  // 取出并清空，每项为 (归属, 条目)
+  std::vector<std::pair<std::string, std::string>> take() {
+    std::vector<std::pair<std::string, std::string>> items;
+    std::lock_guard<std::mutex> lock(mtx_);
+    items.swap(items_);
+    return items;
+  }
+
+private:
+  TimeoutReport() = default;
+
+private:
+  std::mutex mtx_;
+  std::vector<std::pair<std::string, std::string>> items_;
+};
+
+// 记录当前线程所属插件因超时而放弃的条目
+inline void report_timeout(const std::string& item) {
+  TimeoutReport::singleton().add(Deadline::current_owner(), item);
+}
+
+}  // namespace ling::utils
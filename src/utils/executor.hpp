@@ -23,7 +23,7 @@ public:
     task_queue_.reserve(capacity_);
     workers_.reserve(worker_num);
     for (unsigned int idx = 0; idx < worker_num_; idx++) {
-      workers_[idx] = std::thread([&, idx]() {
+      workers_.emplace_back([&, idx]() {
         unsigned int worker_id = idx;
         while (!done_) {
           AsyncTask t;
@@ -0,0 +1,145 @@
+#pragma once
+
+/*
+ * 打开的静态文件描述符缓存
+ *
+ * - 按路径缓存已打开的文件，每次取用时 stat 一次，inode/大小/修改时间变化（如重新构建）则重新打开
+ * - 使用中的文件由 shared_ptr 持有，被淘汰或替换后，最后一个引用释放时才 close
+ * - 超过容量时淘汰最久未用的
+ * - 文件内容的哈希（用作 ETag）随打开的文件缓存，文件变化后随重新打开重新计算
+ */
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "utils/hash.hpp"
+
+namespace ling::utils {
+
+// 文件的修改时间，纳秒
+inline int64_t mtime_ns_of(const struct stat& st) {
+#if defined(__APPLE__)
+  return static_cast<int64_t>(st.st_mtimespec.tv_sec) * 1000000000 + st.st_mtimespec.tv_nsec;
+#else
+  return static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+}
+
+struct OpenFile final {
+  int fd {-1};
+  size_t size {0};
+  ino_t ino {0};
+  // 修改时间，纳秒
+  int64_t mtime_ns {0};
+
+  OpenFile() = default;
+  OpenFile(const OpenFile&) = delete;
+  OpenFile& operator=(const OpenFile&) = delete;
+  ~OpenFile() {
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+
+  // 内容的 sha256，首次取用时计算，同一版本的文件只计算一次；读取失败时为空
+  [[nodiscard]] const std::string& content_hash() const {
+    std::call_once(hash_once_, [this]() {
+      hash_ = sha256_hex_of_fd(fd, size);
+    });
+    return hash_;
+  }
+
+private:
+  mutable std::once_flag hash_once_;
+  mutable std::string hash_;
+};
+using OpenFilePtr = std::shared_ptr<const OpenFile>;
+
+class FdCache final {
+public:
+  static FdCache& singleton() {
+    static FdCache cache;
+    return cache;
+  }
+
+  FdCache(const FdCache&) = delete;
+  FdCache& operator=(const FdCache&) = delete;
+
+  void capacity(const size_t capacity) {
+    std::lock_guard lock(mutex_);
+    capacity_ = capacity;
+  }
+  // 打开普通文件，不存在或不是普通文件时返回 nullptr
+  OpenFilePtr open(const std::filesystem::path& path);
+
+private:
+  FdCache() = default;
+
+  struct Entry {
+    OpenFilePtr file;
+    std::list<std::string>::iterator lru_it;
+  };
+
+private:
+  std::mutex mutex_;
+  size_t capacity_ {256};
+  std::unordered_map<std::string, Entry> entries_;
+  // 最近使用的在前
+  std::list<std::string> lru_;
+};
+
+inline OpenFilePtr FdCache::open(const std::filesystem::path& path) {
+  struct stat st {};
+  if (::stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) {
+    return nullptr;
+  }
+  const auto key = path.string();
+  {
+    std::lock_guard lock(mutex_);
+    if (const auto it = entries_.find(key); it != entries_.end()) {
+      const auto& file = it->second.file;
+      if (file->ino == st.st_ino && file->size == static_cast<size_t>(st.st_size) && file->mtime_ns == mtime_ns_of(st)) {
+        lru_.splice(lru_.begin(), lru_, it->second.lru_it);
+        return file;
+      }
+    }
+  }
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return nullptr;
+  }
+  auto file = std::make_shared<OpenFile>();
+  file->fd = fd;
+  // 以打开后的状态为准，避免 stat 与 open 之间文件被替换
+  if (::fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+    return nullptr;
+  }
+  file->size = st.st_size;
+  file->ino = st.st_ino;
+  file->mtime_ns = mtime_ns_of(st);
+  //
+  std::lock_guard lock(mutex_);
+  if (const auto it = entries_.find(key); it != entries_.end()) {
+    it->second.file = file;
+    lru_.splice(lru_.begin(), lru_, it->second.lru_it);
+    return file;
+  }
+  lru_.push_front(key);
+  entries_[key] = Entry{file, lru_.begin()};
+  while (entries_.size() > capacity_) {
+    entries_.erase(lru_.back());
+    lru_.pop_back();
+  }
+  return file;
+}
+
+}  // namespace ling::utils
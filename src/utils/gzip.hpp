@@ -0,0 +1,54 @@
+#pragma once
+
+/*
+ * gzip 格式（RFC 1952）的压缩与解压，结果可直接作为 Content-Encoding: gzip 的 body
+ */
+
+#include <zlib.h>
+
+#include <string>
+
+#include <absl/strings/string_view.h>
+
+namespace ling::utils {
+
+// 一次压缩整个输入，失败时返回 false
+inline bool gzip_compress(absl::string_view input, std::string* output, const int level = Z_DEFAULT_COMPRESSION) {
+  z_stream zs {};
+  // windowBits 加 16 输出 gzip 的头与尾，而不是 zlib 格式
+  if (deflateInit2(&zs, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+    return false;
+  }
+  // 输出不会超过 deflateBound，一次 deflate 即可完成
+  output->resize(deflateBound(&zs, input.size()));
+  zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+  zs.avail_in = input.size();
+  zs.next_out = reinterpret_cast<Bytef*>(output->data());
+  zs.avail_out = output->size();
+  const int ret = deflate(&zs, Z_FINISH);
+  output->resize(zs.total_out);
+  deflateEnd(&zs);
+  return ret == Z_STREAM_END;
+}
+
+inline bool gzip_decompress(absl::string_view input, std::string* output) {
+  z_stream zs {};
+  if (inflateInit2(&zs, 15 + 16) != Z_OK) {
+    return false;
+  }
+  zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+  zs.avail_in = input.size();
+  output->clear();
+  int ret;
+  do {
+    char out_buffer[16 * 1024];
+    zs.next_out = reinterpret_cast<Bytef*>(out_buffer);
+    zs.avail_out = sizeof(out_buffer);
+    ret = inflate(&zs, Z_NO_FLUSH);
+    output->append(out_buffer, sizeof(out_buffer) - zs.avail_out);
+  } while (ret == Z_OK);
+  inflateEnd(&zs);
+  return ret == Z_STREAM_END;
+}
+
+}  // namespace ling::utils
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+
+#include <absl/strings/string_view.h>
+#include <cryptopp/filters.h>
+#include <cryptopp/hex.h>
+#include <cryptopp/sha.h>
+
+namespace ling::utils {
+
+// 内容寻址用的稳定哈希，结果为小写十六进制串
+// 注意：std::hash/absl::Hash 的结果在不同进程、不同版本间不保证一致，不能用于落盘的缓存键
+inline std::string sha256_hex(absl::string_view content) {
+  CryptoPP::byte digest[CryptoPP::SHA256::DIGESTSIZE];
+  CryptoPP::SHA256().CalculateDigest(digest, reinterpret_cast<const CryptoPP::byte*>(content.data()), content.size());
+  std::string output;
+  CryptoPP::HexEncoder encoder{new CryptoPP::StringSink(output), false};
+  encoder.Put(digest, sizeof(digest));
+  encoder.MessageEnd();
+  return output;
+}
+
+// 文件 fd 中前 size 字节的 sha256，按块读取，不把整个文件读入内存；读取失败时返回空串
+inline std::string sha256_hex_of_fd(const int fd, const size_t size) {
+  CryptoPP::SHA256 hash;
+  std::string chunk(64 * 1024, '\0');
+  size_t offset = 0;
+  while (offset < size) {
+    const auto n = pread(fd, chunk.data(), std::min(chunk.size(), size - offset), static_cast<off_t>(offset));
+    if (n <= 0) {
+      return "";
+    }
+    hash.Update(reinterpret_cast<const CryptoPP::byte*>(chunk.data()), n);
+    offset += n;
+  }
+  CryptoPP::byte digest[CryptoPP::SHA256::DIGESTSIZE];
+  hash.Final(digest);
+  std::string output;
+  CryptoPP::HexEncoder encoder{new CryptoPP::StringSink(output), false};
+  encoder.Put(digest, sizeof(digest));
+  encoder.MessageEnd();
+  return output;
+}
+
+}  // namespace ling::utils
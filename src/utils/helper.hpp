@@ -3,6 +3,14 @@
 #include <vector>
 #include <filesystem>
 #include <fstream>
+#include <chrono>
+#include <thread>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
 namespace ling::utils {
 
@@ -47,6 +55,65 @@ static bool write_file(const std::filesystem::path& file_path, const std::string
   return true;
 }
 
+// 先写入同目录下的临时文件再 rename，读者要么看到旧内容，要么看到完整的新内容
+static bool write_file_atomic(const std::filesystem::path& file_path, const std::string& content) {
+  auto tmp_path = file_path;
+  tmp_path += ".tmp." + std::to_string(getpid()) + "." +
+              std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+  {
+    std::ofstream ofs{tmp_path, std::ios::binary | std::ios::trunc};
+    if (!ofs.is_open()) {
+      return false;
+    }
+    ofs.write(content.data(), static_cast<std::streamsize>(content.size()));
+    if (!ofs.flush()) {
+      ofs.close();
+      std::filesystem::remove(tmp_path);
+      return false;
+    }
+  }
+  std::error_code ec;
+  std::filesystem::rename(tmp_path, file_path, ec);
+  if (ec) {
+    std::filesystem::remove(tmp_path, ec);
+    return false;
+  }
+  return true;
+}
+
+// 轮询直到本机端口可以建立连接，用于确认辅助服务已就绪，而不是固定 sleep
+static bool wait_tcp_port_ready(const uint32_t port, const std::chrono::milliseconds timeout,
+                                const std::chrono::milliseconds interval = std::chrono::milliseconds(50)) {
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(static_cast<uint16_t>(port));
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+  while (true) {
+#if defined(__APPLE__)
+    const int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd >= 0) {
+      fcntl(fd, F_SETFD, FD_CLOEXEC);
+    }
+#else
+    // 同 pipe2，避免并发 fork 出的子进程继承
+    const int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+#endif
+    if (fd < 0) {
+      return false;
+    }
+    const bool connected = connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+    close(fd);
+    if (connected) {
+      return true;
+    }
+    if (std::chrono::steady_clock::now() >= deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(interval);
+  }
+}
+
 static std::string USER_AGENT = "Mozilla/5.0 (Macintosh; Intel Mac OS X 10_15_7) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/139.0.0.0 Safari/537.36";
 static std::string CONTENT_TYPE_JSON = "application/json";
 
@@ -0,0 +1,406 @@
+#pragma once
+
+/*
+ * 构建时代码高亮：按语言的简单词法规则切分代码块，输出带 hljs-* class 的 <span>，
+ * 样式沿用 highlight.js 主题的 class 命名，页面无需再加载、执行 highlight.js
+ *
+ * 只覆盖文章中常见的语言：cpp、python、go、bash、sql、toml、json，其他语言返回 false，由调用方按原样输出
+ */
+
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <absl/strings/ascii.h>
+#include <absl/strings/string_view.h>
+
+#include "utils/html_escape.hpp"
+
+namespace ling::utils {
+
+struct HighlightLang {
+  std::string name;
+  std::unordered_set<std::string> keywords;
+  std::unordered_set<std::string> literals;
+  std::unordered_set<std::string> built_ins;
+  std::vector<std::string> line_comments;
+  std::string block_comment_begin;
+  std::string block_comment_end;
+  std::string quotes {"\"'"};
+  bool triple_quotes {false};     // python 的 """ / '''
+  bool backtick_raw {false};      // go 的 `raw string`
+  bool preprocessor {false};      // cpp 的 # 开头的预处理行
+  bool variables {false};         // bash 的 $x、${x}
+  bool string_keys {false};       // json 中冒号前的字符串是键
+  bool bare_keys {false};         // toml 中行首 = 前的是键，[table] 是节
+  bool case_insensitive {false};  // sql 关键字不区分大小写
+};
+
+inline const HighlightLang* find_highlight_lang(absl::string_view lang_name) {
+  static const HighlightLang cpp = [] {
+    HighlightLang lang;
+    lang.name = "cpp";
+    lang.keywords = {"alignas", "alignof", "auto", "break", "case", "catch", "class", "const", "consteval", "constexpr",
+                     "constinit", "const_cast", "continue", "co_await", "co_return", "co_yield", "decltype", "default",
+                     "delete", "do", "dynamic_cast", "else", "enum", "explicit", "export", "extern", "final", "for",
+                     "friend", "goto", "if", "inline", "mutable", "namespace", "new", "noexcept", "operator",
+                     "override", "private", "protected", "public", "register", "reinterpret_cast", "requires",
+                     "return", "sizeof", "static", "static_assert", "static_cast", "struct", "switch", "template",
+                     "this", "thread_local", "throw", "try", "typedef", "typeid", "typename", "union", "using",
+                     "virtual", "volatile", "while", "bool", "char", "char8_t", "char16_t", "char32_t", "double",
+                     "float", "int", "long", "short", "signed", "unsigned", "void", "wchar_t", "concept"};
+    lang.literals = {"true", "false", "nullptr", "NULL"};
+    lang.built_ins = {"std", "string", "vector", "map", "set", "unordered_map", "unordered_set", "shared_ptr",
+                      "unique_ptr", "make_shared", "make_unique", "size_t", "int8_t", "int16_t", "int32_t", "int64_t",
+                      "uint8_t", "uint16_t", "uint32_t", "uint64_t", "printf", "cout", "cin", "cerr", "endl",
+                      "move", "forward", "array", "deque", "pair", "tuple", "optional", "atomic", "mutex", "thread"};
+    lang.line_comments = {"//"};
+    lang.block_comment_begin = "/*";
+    lang.block_comment_end = "*/";
+    lang.preprocessor = true;
+    return lang;
+  }();
+  static const HighlightLang python = [] {
+    HighlightLang lang;
+    lang.name = "python";
+    lang.keywords = {"and", "as", "assert", "async", "await", "break", "class", "continue", "def", "del", "elif",
+                     "else", "except", "finally", "for", "from", "global", "if", "import", "in", "is", "lambda",
+                     "nonlocal", "not", "or", "pass", "raise", "return", "try", "while", "with", "yield", "match",
+                     "case"};
+    lang.literals = {"True", "False", "None"};
+    lang.built_ins = {"print", "len", "range", "enumerate", "zip", "map", "filter", "sorted", "reversed", "list",
+                      "dict", "set", "tuple", "str", "int", "float", "bool", "bytes", "open", "isinstance", "super",
+                      "self", "min", "max", "sum", "abs", "any", "all", "type", "object", "Exception"};
+    lang.line_comments = {"#"};
+    lang.triple_quotes = true;
+    return lang;
+  }();
+  static const HighlightLang go = [] {
+    HighlightLang lang;
+    lang.name = "go";
+    lang.keywords = {"break", "case", "chan", "const", "continue", "default", "defer", "else", "fallthrough", "for",
+                     "func", "go", "goto", "if", "import", "interface", "map", "package", "range", "return",
+                     "select", "struct", "switch", "type", "var"};
+    lang.literals = {"true", "false", "nil", "iota"};
+    lang.built_ins = {"append", "cap", "close", "complex", "copy", "delete", "imag", "len", "make", "new", "panic",
+                      "print", "println", "real", "recover", "bool", "byte", "complex64", "complex128", "error",
+                      "float32", "float64", "int", "int8", "int16", "int32", "int64", "rune", "string", "uint",
+                      "uint8", "uint16", "uint32", "uint64", "uintptr", "any"};
+    lang.line_comments = {"//"};
+    lang.block_comment_begin = "/*";
+    lang.block_comment_end = "*/";
+    lang.backtick_raw = true;
+    return lang;
+  }();
+  static const HighlightLang bash = [] {
+    HighlightLang lang;
+    lang.name = "bash";
+    lang.keywords = {"if", "then", "else", "elif", "fi", "case", "esac", "for", "select", "while", "until", "do",
+                     "done", "in", "function", "time", "return", "local", "export", "declare", "readonly", "unset",
+                     "shift", "exit", "break", "continue", "source"};
+    lang.literals = {"true", "false"};
+    lang.built_ins = {"echo", "printf", "cd", "pwd", "read", "test", "eval", "exec", "set", "trap", "wait", "kill",
+                      "alias", "cat", "grep", "sed", "awk", "ls", "mkdir", "rm", "cp", "mv", "curl", "git", "make",
+                      "cmake", "sudo", "chmod", "find", "xargs", "tar"};
+    lang.line_comments = {"#"};
+    lang.variables = true;
+    return lang;
+  }();
+  static const HighlightLang sql = [] {
+    HighlightLang lang;
+    lang.name = "sql";
+    lang.keywords = {"select", "from", "where", "and", "or", "not", "insert", "into", "values", "update", "set",
+                     "delete", "create", "table", "index", "view", "drop", "alter", "add", "column", "primary", "key",
+                     "foreign", "references", "unique", "default", "join", "inner", "left", "right", "outer", "full",
+                     "cross", "on", "group", "by", "order", "having", "limit", "offset", "as", "distinct", "union",
+                     "all", "exists", "in", "between", "like", "is", "case", "when", "then", "else", "end", "with",
+                     "if", "asc", "desc", "begin", "commit", "rollback", "transaction", "pragma", "replace",
+                     "returning", "integer", "int", "bigint", "text", "varchar", "char", "real", "blob", "boolean",
+                     "timestamp", "date", "autoincrement", "conflict", "ignore", "trigger", "explain"};
+    lang.literals = {"null", "true", "false"};
+    lang.built_ins = {"count", "sum", "avg", "min", "max", "coalesce", "ifnull", "length", "lower", "upper",
+                      "substr", "now", "datetime", "strftime", "cast", "round", "abs"};
+    lang.line_comments = {"--"};
+    lang.block_comment_begin = "/*";
+    lang.block_comment_end = "*/";
+    lang.case_insensitive = true;
+    return lang;
+  }();
+  static const HighlightLang toml = [] {
+    HighlightLang lang;
+    lang.name = "toml";
+    lang.literals = {"true", "false", "inf", "nan"};
+    lang.line_comments = {"#"};
+    lang.triple_quotes = true;
+    lang.bare_keys = true;
+    return lang;
+  }();
+  static const HighlightLang json = [] {
+    HighlightLang lang;
+    lang.name = "json";
+    lang.literals = {"true", "false", "null"};
+    lang.quotes = "\"";
+    lang.string_keys = true;
+    return lang;
+  }();
+  const auto ln = absl::AsciiStrToLower(lang_name);
+  if (ln == "cpp" || ln == "c++" || ln == "cc" || ln == "cxx" || ln == "c" || ln == "h" || ln == "hpp") {
+    return &cpp;
+  }
+  if (ln == "python" || ln == "py" || ln == "python3") {
+    return &python;
+  }
+  if (ln == "go" || ln == "golang") {
+    return &go;
+  }
+  if (ln == "bash" || ln == "sh" || ln == "shell" || ln == "zsh") {
+    return &bash;
+  }
+  if (ln == "sql" || ln == "sqlite") {
+    return &sql;
+  }
+  if (ln == "toml") {
+    return &toml;
+  }
+  if (ln == "json") {
+    return &json;
+  }
+  return nullptr;
+}
+
+class Highlighter {
+public:
+  Highlighter(const HighlightLang& lang, absl::string_view code, std::string& out)
+      : lang_(lang), code_(code), out_(out) {}
+
+  void run();
+
+private:
+  static bool is_ident_start(const char c) {
+    return absl::ascii_isalpha(static_cast<unsigned char>(c)) || c == '_';
+  }
+  static bool is_ident_char(const char c) {
+    return absl::ascii_isalnum(static_cast<unsigned char>(c)) || c == '_';
+  }
+  bool at_line_start(size_t pos) const;
+  bool starts_with(const size_t pos, const absl::string_view prefix) const {
+    return !prefix.empty() && code_.substr(pos, prefix.size()) == prefix;
+  }
+  // 从 pos 开始找 end，返回 end 之后的位置，找不到时到结尾
+  size_t find_end(size_t pos, absl::string_view end) const;
+  size_t line_end(const size_t pos) const {
+    const auto eol = code_.find('\n', pos);
+    return eol == absl::string_view::npos ? code_.size() : eol;
+  }
+  size_t skip_string(size_t pos) const;
+  size_t skip_spaces(size_t pos) const;
+  size_t scan_number(size_t pos) const;
+
+  void emit(absl::string_view cls, size_t begin, size_t end);
+  void emit_plain(size_t begin, size_t end) {
+    html_escape(code_.substr(begin, end - begin), out_);
+  }
+
+private:
+  const HighlightLang& lang_;
+  absl::string_view code_;
+  std::string& out_;
+};
+
+inline bool Highlighter::at_line_start(const size_t pos) const {
+  for (size_t idx = pos; idx > 0; idx--) {
+    const char c = code_[idx - 1];
+    if (c == '\n') {
+      return true;
+    }
+    if (c != ' ' && c != '\t') {
+      return false;
+    }
+  }
+  return true;
+}
+
+inline size_t Highlighter::find_end(const size_t pos, const absl::string_view end) const {
+  const auto found = code_.find(end, pos);
+  return found == absl::string_view::npos ? code_.size() : found + end.size();
+}
+
+inline size_t Highlighter::skip_string(const size_t pos) const {
+  const char quote = code_[pos];
+  // bash 单引号内没有转义
+  const bool escapable = !(lang_.variables && quote == '\'');
+  size_t idx = pos + 1;
+  while (idx < code_.size()) {
+    const char c = code_[idx];
+    if (c == '\\' && escapable && idx + 1 < code_.size()) {
+      idx += 2;
+      continue;
+    }
+    idx++;
+    if (c == quote) {
+      break;
+    }
+    // 未闭合的普通字符串到行尾为止，bash 字符串可以跨行
+    if (c == '\n' && !lang_.variables) {
+      idx--;
+      break;
+    }
+  }
+  return idx;
+}
+
+inline size_t Highlighter::skip_spaces(size_t pos) const {
+  while (pos < code_.size() && (code_[pos] == ' ' || code_[pos] == '\t')) {
+    pos++;
+  }
+  return pos;
+}
+
+inline size_t Highlighter::scan_number(size_t pos) const {
+  while (pos < code_.size()) {
+    const char c = code_[pos];
+    if (is_ident_char(c) || c == '.' || c == '\'') {
+      pos++;
+      // 指数部分的符号，如 1e-9
+      if ((c == 'e' || c == 'E') && pos < code_.size() && (code_[pos] == '+' || code_[pos] == '-')) {
+        pos++;
+      }
+      continue;
+    }
+    break;
+  }
+  return pos;
+}
+
+inline void Highlighter::emit(const absl::string_view cls, const size_t begin, const size_t end) {
+  out_.append("<span class=\"hljs-").append(cls.data(), cls.size()).append("\">");
+  emit_plain(begin, end);
+  out_.append("</span>");
+}
+
+inline void Highlighter::run() {
+  size_t plain_begin = 0;
+  size_t pos = 0;
+  const auto flush_then_emit = [&](const absl::string_view cls, const size_t end) {
+    emit_plain(plain_begin, pos);
+    emit(cls, pos, end);
+    pos = plain_begin = end;
+  };
+  while (pos < code_.size()) {
+    const char c = code_[pos];
+    if (c == '\n' || c == ' ' || c == '\t') {
+      pos++;
+      continue;
+    }
+    const bool line_start = at_line_start(pos);
+    if (line_start && lang_.preprocessor && c == '#') {
+      flush_then_emit("meta", line_end(pos));
+      continue;
+    }
+    if (line_start && lang_.bare_keys) {
+      if (c == '[') {
+        flush_then_emit("section", line_end(pos));
+        continue;
+      }
+      size_t key_end = pos;
+      while (key_end < code_.size() && (is_ident_char(code_[key_end]) || code_[key_end] == '-' ||
+                                        code_[key_end] == '.' || code_[key_end] == '"')) {
+        key_end++;
+      }
+      if (key_end > pos && skip_spaces(key_end) < code_.size() && code_[skip_spaces(key_end)] == '=') {
+        flush_then_emit("attr", key_end);
+        continue;
+      }
+    }
+    if (starts_with(pos, lang_.block_comment_begin)) {
+      flush_then_emit("comment", find_end(pos + lang_.block_comment_begin.size(), lang_.block_comment_end));
+      continue;
+    }
+    bool is_comment = false;
+    for (const auto& prefix : lang_.line_comments) {
+      // bash 的 # 需在词首，如 ${#arr[@]}、$# 不是注释
+      if (starts_with(pos, prefix) && (!lang_.variables || pos == 0 || code_[pos - 1] == ' ' ||
+                                       code_[pos - 1] == '\t' || code_[pos - 1] == '\n')) {
+        is_comment = true;
+        break;
+      }
+    }
+    if (is_comment) {
+      flush_then_emit("comment", line_end(pos));
+      continue;
+    }
+    if (lang_.triple_quotes && (starts_with(pos, R"(""")") || starts_with(pos, "'''"))) {
+      flush_then_emit("string", find_end(pos + 3, code_.substr(pos, 3)));
+      continue;
+    }
+    if (lang_.backtick_raw && c == '`') {
+      flush_then_emit("string", find_end(pos + 1, "`"));
+      continue;
+    }
+    if (lang_.quotes.find(c) != std::string::npos) {
+      const auto end = skip_string(pos);
+      const auto next = skip_spaces(end);
+      flush_then_emit(lang_.string_keys && next < code_.size() && code_[next] == ':' ? "attr" : "string", end);
+      continue;
+    }
+    if (lang_.variables && c == '$' && pos + 1 < code_.size()) {
+      size_t end = pos + 1;
+      if (code_[end] == '{') {
+        end = find_end(end, "}");
+      } else if (is_ident_char(code_[end])) {
+        while (end < code_.size() && is_ident_char(code_[end])) {
+          end++;
+        }
+      } else if (absl::string_view("@*#?$!-").find(code_[end]) != absl::string_view::npos) {
+        end++;
+      }
+      if (end > pos + 1) {
+        flush_then_emit("variable", end);
+        continue;
+      }
+    }
+    const bool prev_ident = pos > 0 && (is_ident_char(code_[pos - 1]) || code_[pos - 1] == '.');
+    if (!prev_ident && (absl::ascii_isdigit(static_cast<unsigned char>(c)) ||
+                        (c == '.' && pos + 1 < code_.size() &&
+                         absl::ascii_isdigit(static_cast<unsigned char>(code_[pos + 1]))))) {
+      flush_then_emit("number", scan_number(pos));
+      continue;
+    }
+    if (is_ident_start(c) && !prev_ident) {
+      size_t end = pos;
+      while (end < code_.size() && is_ident_char(code_[end])) {
+        end++;
+      }
+      auto word = std::string(code_.substr(pos, end - pos));
+      if (lang_.case_insensitive) {
+        absl::AsciiStrToLower(&word);
+      }
+      if (lang_.keywords.count(word) > 0) {
+        flush_then_emit("keyword", end);
+      } else if (lang_.literals.count(word) > 0) {
+        flush_then_emit("literal", end);
+      } else if (lang_.built_ins.count(word) > 0) {
+        flush_then_emit("built_in", end);
+      } else if (!lang_.bare_keys && !lang_.string_keys && end < code_.size() && code_[end] == '(') {
+        flush_then_emit("title function_", end);
+      } else {
+        pos = end;
+      }
+      continue;
+    }
+    pos++;
+  }
+  emit_plain(plain_begin, code_.size());
+}
+
+// 不支持的语言返回 false，out 不变
+inline bool highlight_code(absl::string_view lang_name, absl::string_view code, std::string& out) {
+  const auto* lang = find_highlight_lang(lang_name);
+  if (lang == nullptr) {
+    return false;
+  }
+  Highlighter(*lang, code, out).run();
+  return true;
+}
+
+}  // namespace ling::utils
@@ -0,0 +1,154 @@
+#pragma once
+
+/*
+ * HTML/XML 转义，替代逐字符处理的 inja::htmlescape
+ *
+ * - 一次检查 16（SSE2）/ 32（AVX2）个字节，无需转义的连续片段整段拷贝
+ * - 结果追加到调用方提供的 buffer 中，便于复用内存、避免中间字符串
+ */
+
+#include <string>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include <absl/strings/string_view.h>
+
+namespace ling::utils {
+
+namespace escape_detail {
+
+// 与 inja::htmlescape 保持一致的转义结果
+inline absl::string_view entity_of(const char c) {
+  switch (c) {
+    case '&':
+      return "&amp;";
+    case '<':
+      return "&lt;";
+    case '>':
+      return "&gt;";
+    case '"':
+      return "&quot;";
+    case '\'':
+      return "&apos;";
+    default:
+      return {};
+  }
+}
+
+inline bool need_escape(const char c) {
+  return c == '&' || c == '<' || c == '>' || c == '"' || c == '\'';
+}
+
+#ifdef __AVX2__
+// 返回 32 字节中需要转义的字节位图
+inline uint32_t escape_mask32(const char* p) {
+  const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+  __m256i hit = _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('&'));
+  hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('<')));
+  hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('>')));
+  hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('"')));
+  hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\'')));
+  return static_cast<uint32_t>(_mm256_movemask_epi8(hit));
+}
+#endif
+
+#ifdef __SSE2__
+// 返回 16 字节中需要转义的字节位图
+inline uint32_t escape_mask16(const char* p) {
+  const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+  __m128i hit = _mm_cmpeq_epi8(chunk, _mm_set1_epi8('&'));
+  hit = _mm_or_si128(hit, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('<')));
+  hit = _mm_or_si128(hit, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('>')));
+  hit = _mm_or_si128(hit, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('"')));
+  hit = _mm_or_si128(hit, _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\'')));
+  return static_cast<uint32_t>(_mm_movemask_epi8(hit));
+}
+#endif
+
+// 按位图处理一个块：干净片段整段追加，命中位置追加实体
+inline void flush_block(const char* p, size_t block_size, uint32_t mask, std::string& out) {
+  size_t start = 0;
+  while (mask != 0) {
+    const auto pos = static_cast<size_t>(__builtin_ctz(mask));
+    out.append(p + start, pos - start);
+    const auto entity = entity_of(p[pos]);
+    out.append(entity.data(), entity.size());
+    start = pos + 1;
+    mask &= mask - 1;
+  }
+  out.append(p + start, block_size - start);
+}
+
+}  // namespace escape_detail
+
+// 将 in 转义后追加到 out 末尾
+inline void html_escape(absl::string_view in, std::string& out) {
+  using namespace escape_detail;
+  const char* p = in.data();
+  const size_t n = in.size();
+  size_t idx = 0;
+  // 预留少量余量，大多数文本只有零星需要转义的字符
+  out.reserve(out.size() + n + n / 8);
+#ifdef __AVX2__
+  while (idx + 32 <= n) {
+    const uint32_t mask = escape_mask32(p + idx);
+    if (mask == 0) {
+      out.append(p + idx, 32);
+    } else {
+      flush_block(p + idx, 32, mask, out);
+    }
+    idx += 32;
+  }
+#endif
+#ifdef __SSE2__
+  while (idx + 16 <= n) {
+    const uint32_t mask = escape_mask16(p + idx);
+    if (mask == 0) {
+      out.append(p + idx, 16);
+    } else {
+      flush_block(p + idx, 16, mask, out);
+    }
+    idx += 16;
+  }
+#endif
+  size_t clean_start = idx;
+  for (; idx < n; idx++) {
+    if (!need_escape(p[idx])) {
+      continue;
+    }
+    out.append(p + clean_start, idx - clean_start);
+    const auto entity = entity_of(p[idx]);
+    out.append(entity.data(), entity.size());
+    clean_start = idx + 1;
+  }
+  out.append(p + clean_start, n - clean_start);
+}
+
+inline std::string html_escape(absl::string_view in) {
+  std::string out;
+  html_escape(in, out);
+  return out;
+}
+
+// 原地转义，无需转义时不产生任何拷贝
+inline void html_escape_inplace(std::string& s) {
+  size_t idx = 0;
+  while (idx < s.size() && !escape_detail::need_escape(s[idx])) {
+    idx++;
+  }
+  if (idx == s.size()) {
+    return;
+  }
+  std::string out;
+  out.reserve(s.size() + s.size() / 8);
+  out.append(s.data(), idx);
+  html_escape(absl::string_view(s).substr(idx), out);
+  s.swap(out);
+}
+
+}  // namespace ling::utils
@@ -0,0 +1,364 @@
+#pragma once
+
+/*
+ * 链式、引用计数的字节缓冲，参考 brpc IOBuf
+ *
+ * - IOBlock：带引用计数的内存块，默认大小的块经线程本地的空闲链表复用；在其他线程释放的块放入共享链表，
+ *   由取块的线程（连接所在的事件循环）批量取回，避免请求处理线程囤积空闲块
+ * - IOBuf：若干 (块, 偏移, 长度) 引用组成的链，追加与切分只增减引用，不拷贝数据
+ * - 网络读直接写入 IOBlock，再以引用的方式挂到连接的 IOBuf 上；请求体切分出来后作为视图交给处理函数
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <new>
+#include <string>
+#include <string_view>
+
+namespace ling::utils {
+
+class IOBlock final {
+public:
+  // 加上块头不超过 16KB
+  static constexpr size_t DEFAULT_CAPACITY = 16 * 1024 - 32;
+  // 每个线程缓存的空闲块上限
+  static constexpr size_t POOL_LIMIT = 256;
+  // 共享链表的空闲块上限
+  static constexpr size_t SHARED_POOL_LIMIT = 1024;
+
+  // 引用计数为 1；capacity 不大于默认值时从线程本地的空闲链表中取
+  static IOBlock* acquire(size_t capacity = DEFAULT_CAPACITY);
+  // 由 data() 返回的指针找回所属的块，用于 libuv 的读回调
+  static IOBlock* from_data(char* data) {
+    return reinterpret_cast<IOBlock*>(data - offsetof(IOBlock, data_));
+  }
+
+  IOBlock(const IOBlock&) = delete;
+  IOBlock& operator=(const IOBlock&) = delete;
+
+  void ref() {
+    refs_.fetch_add(1, std::memory_order_relaxed);
+  }
+  void unref();
+
+  char* data() {
+    return data_;
+  }
+  [[nodiscard]] size_t capacity() const {
+    return capacity_;
+  }
+
+private:
+  explicit IOBlock(const size_t capacity) : capacity_(capacity) {}
+
+  struct Pool {
+    IOBlock* head {nullptr};
+    size_t size {0};
+    ~Pool() {
+      while (head != nullptr) {
+        auto* next = head->next_free_;
+        free(head);
+        head = next;
+      }
+    }
+  };
+  static Pool& pool() {
+    thread_local Pool p;
+    return p;
+  }
+
+  // 非取块线程释放的块，入栈为无锁 CAS，出栈一次取走整条链，不存在 ABA 问题
+  struct SharedPool {
+    std::atomic<IOBlock*> head {nullptr};
+    std::atomic_size_t size {0};
+    ~SharedPool() {
+      auto* block = head.exchange(nullptr, std::memory_order_acquire);
+      while (block != nullptr) {
+        auto* next = block->next_free_;
+        free(block);
+        block = next;
+      }
+    }
+  };
+  static SharedPool& shared_pool() {
+    static SharedPool p;
+    return p;
+  }
+
+private:
+  std::atomic_uint32_t refs_ {1};
+  uint32_t capacity_;
+  IOBlock* next_free_ {nullptr};
+  // 取块线程的空闲链表，只比较地址，不解引用
+  const Pool* owner_ {nullptr};
+  alignas(16) char data_[1];
+};
+
+inline IOBlock* IOBlock::acquire(const size_t capacity) {
+  auto& p = pool();
+  if (capacity <= DEFAULT_CAPACITY && p.head == nullptr) {
+    // 本线程的空闲链表为空时，取回其他线程释放的块
+    auto& shared = shared_pool();
+    if (shared.head.load(std::memory_order_relaxed) != nullptr) {
+      auto* block = shared.head.exchange(nullptr, std::memory_order_acquire);
+      size_t count = 0;
+      while (block != nullptr) {
+        auto* next = block->next_free_;
+        block->next_free_ = p.head;
+        p.head = block;
+        count++;
+        block = next;
+      }
+      p.size += count;
+      shared.size.fetch_sub(count, std::memory_order_relaxed);
+    }
+  }
+  if (capacity <= DEFAULT_CAPACITY && p.head != nullptr) {
+    auto* block = p.head;
+    p.head = block->next_free_;
+    p.size--;
+    block->refs_.store(1, std::memory_order_relaxed);
+    block->owner_ = &p;
+    return block;
+  }
+  const auto cap = std::max(capacity, DEFAULT_CAPACITY);
+  void* mem = malloc(offsetof(IOBlock, data_) + cap);
+  if (mem == nullptr) {
+    throw std::bad_alloc();
+  }
+  auto* block = new (mem) IOBlock(cap);
+  block->owner_ = &p;
+  return block;
+}
+
+inline void IOBlock::unref() {
+  if (refs_.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+    return;
+  }
+  if (capacity_ != DEFAULT_CAPACITY) {
+    free(this);
+    return;
+  }
+  auto& p = pool();
+  if (owner_ == &p) {
+    if (p.size < POOL_LIMIT) {
+      next_free_ = p.head;
+      p.head = this;
+      p.size++;
+      return;
+    }
+    free(this);
+    return;
+  }
+  // 在其他线程（如请求处理线程）释放的块放入共享链表，等取块的线程取回
+  auto& shared = shared_pool();
+  if (shared.size.fetch_add(1, std::memory_order_relaxed) >= SHARED_POOL_LIMIT) {
+    shared.size.fetch_sub(1, std::memory_order_relaxed);
+    free(this);
+    return;
+  }
+  next_free_ = shared.head.load(std::memory_order_relaxed);
+  while (!shared.head.compare_exchange_weak(next_free_, this, std::memory_order_release, std::memory_order_relaxed)) {
+  }
+}
+
+class IOBuf final {
+public:
+  IOBuf() = default;
+  IOBuf(const IOBuf&) = delete;
+  IOBuf& operator=(const IOBuf&) = delete;
+  IOBuf(IOBuf&& other) noexcept : refs_(std::move(other.refs_)), size_(other.size_) {
+    other.refs_.clear();
+    other.size_ = 0;
+  }
+  IOBuf& operator=(IOBuf&& other) noexcept {
+    if (this != &other) {
+      clear();
+      refs_.swap(other.refs_);
+      std::swap(size_, other.size_);
+    }
+    return *this;
+  }
+  ~IOBuf() {
+    clear();
+  }
+
+  [[nodiscard]] size_t size() const {
+    return size_;
+  }
+  [[nodiscard]] bool empty() const {
+    return size_ == 0;
+  }
+  // 分成了几段，1 段以内时 view() 无需拷贝
+  [[nodiscard]] size_t segments() const {
+    return refs_.size();
+  }
+
+  // 引用 block 中 [offset, offset + n) 的数据，与相邻的引用连续时合并
+  void append(IOBlock* block, size_t offset, size_t n);
+  // 拷贝追加，主要用于测试与小片段
+  void append(std::string_view s);
+  // 将开头的 n 个字节移到 out 的末尾（out 为空指针时丢弃），只移动引用
+  void cut(size_t n, IOBuf* out);
+  void pop_front(const size_t n) {
+    cut(n, nullptr);
+  }
+  void clear();
+
+  // 从 pos 开始查找，最多查看前 limit 个字节，未找到时返回 npos
+  [[nodiscard]] size_t find(std::string_view pattern, size_t pos = 0, size_t limit = std::string::npos) const;
+  // 将 [pos, pos + n) 拷贝追加到 out
+  void copy_to(std::string& out, size_t n, size_t pos = 0) const;
+  // 连续的只读视图；跨多个块时先合并为一个块（仅此一次拷贝），视图在 IOBuf 修改前有效
+  std::string_view view();
+
+private:
+  struct Ref {
+    IOBlock* block;
+    uint32_t offset;
+    uint32_t length;
+  };
+
+private:
+  std::deque<Ref> refs_;
+  size_t size_ {0};
+};
+
+inline void IOBuf::append(IOBlock* block, const size_t offset, const size_t n) {
+  if (n == 0) {
+    return;
+  }
+  size_ += n;
+  if (!refs_.empty()) {
+    auto& last = refs_.back();
+    if (last.block == block && last.offset + last.length == offset) {
+      last.length += n;
+      return;
+    }
+  }
+  block->ref();
+  refs_.push_back(Ref{block, static_cast<uint32_t>(offset), static_cast<uint32_t>(n)});
+}
+
+inline void IOBuf::append(std::string_view s) {
+  while (!s.empty()) {
+    auto* block = IOBlock::acquire();
+    const auto n = std::min(s.size(), block->capacity());
+    memcpy(block->data(), s.data(), n);
+    append(block, 0, n);
+    block->unref();
+    s.remove_prefix(n);
+  }
+}
+
+inline void IOBuf::cut(size_t n, IOBuf* out) {
+  n = std::min(n, size_);
+  size_ -= n;
+  while (n > 0) {
+    auto& front = refs_.front();
+    const auto taken = std::min<size_t>(n, front.length);
+    if (out != nullptr) {
+      out->append(front.block, front.offset, taken);
+    }
+    n -= taken;
+    if (taken == front.length) {
+      front.block->unref();
+      refs_.pop_front();
+    } else {
+      front.offset += taken;
+      front.length -= taken;
+    }
+  }
+}
+
+inline void IOBuf::clear() {
+  for (auto& ref : refs_) {
+    ref.block->unref();
+  }
+  refs_.clear();
+  size_ = 0;
+}
+
+inline size_t IOBuf::find(const std::string_view pattern, const size_t pos, const size_t limit) const {
+  const auto end = std::min(size_, limit);
+  if (pattern.empty() || pos >= end) {
+    return std::string::npos;
+  }
+  // 从第 seg_idx 段的 at 处开始逐字节比较，匹配可能跨越多段
+  const auto matches = [&](size_t seg_idx, size_t at, size_t abs_pos) {
+    for (const char c : pattern) {
+      while (at >= refs_[seg_idx].length) {
+        at -= refs_[seg_idx].length;
+        if (++seg_idx >= refs_.size()) {
+          return false;
+        }
+      }
+      if (abs_pos >= end || refs_[seg_idx].block->data()[refs_[seg_idx].offset + at] != c) {
+        return false;
+      }
+      at++;
+      abs_pos++;
+    }
+    return true;
+  };
+  size_t seg_begin = 0;
+  for (size_t idx = 0; idx < refs_.size() && seg_begin < end; seg_begin += refs_[idx].length, idx++) {
+    const auto& ref = refs_[idx];
+    const std::string_view seg {ref.block->data() + ref.offset, std::min<size_t>(ref.length, end - seg_begin)};
+    const size_t from = pos > seg_begin ? pos - seg_begin : 0;
+    if (from >= seg.size()) {
+      continue;
+    }
+    for (auto at = seg.find(pattern[0], from); at != std::string_view::npos; at = seg.find(pattern[0], at + 1)) {
+      if (matches(idx, at, seg_begin + at)) {
+        return seg_begin + at;
+      }
+    }
+  }
+  return std::string::npos;
+}
+
+inline void IOBuf::copy_to(std::string& out, size_t n, size_t pos) const {
+  n = std::min(n, pos < size_ ? size_ - pos : 0);
+  out.reserve(out.size() + n);
+  for (const auto& ref : refs_) {
+    if (n == 0) {
+      break;
+    }
+    if (pos >= ref.length) {
+      pos -= ref.length;
+      continue;
+    }
+    const auto taken = std::min<size_t>(n, ref.length - pos);
+    out.append(ref.block->data() + ref.offset + pos, taken);
+    n -= taken;
+    pos = 0;
+  }
+}
+
+inline std::string_view IOBuf::view() {
+  if (refs_.empty()) {
+    return {};
+  }
+  if (refs_.size() > 1) {
+    auto* block = IOBlock::acquire(size_);
+    size_t copied = 0;
+    for (const auto& ref : refs_) {
+      memcpy(block->data() + copied, ref.block->data() + ref.offset, ref.length);
+      copied += ref.length;
+    }
+    const auto total = size_;
+    clear();
+    append(block, 0, total);
+    block->unref();
+  }
+  const auto& ref = refs_.front();
+  return {ref.block->data() + ref.offset, ref.length};
+}
+
+}  // namespace ling::utils
@@ -0,0 +1,58 @@
+#pragma once
+
+/*
+ * 无锁的多生产者单消费者队列（Vyukov 侵入式链表的非侵入版本）
+ *
+ * - push 可在任意线程调用，只有一次 exchange，不会阻塞
+ * - pop 只能由唯一的消费者线程调用；生产者 push 到一半时可能暂时取不到，稍后再取即可
+ */
+
+#include <atomic>
+#include <utility>
+
+namespace ling::utils {
+
+template <typename T>
+class MpscQueue final {
+public:
+  MpscQueue() : head_(new Node()), tail_(head_.load(std::memory_order_relaxed)) {}
+  MpscQueue(const MpscQueue&) = delete;
+  MpscQueue& operator=(const MpscQueue&) = delete;
+  ~MpscQueue() {
+    T item;
+    while (pop(item)) {}
+    delete tail_;
+  }
+
+  void push(T item) {
+    auto* node = new Node(std::move(item));
+    auto* prev = head_.exchange(node, std::memory_order_acq_rel);
+    prev->next.store(node, std::memory_order_release);
+  }
+
+  bool pop(T& item) {
+    auto* next = tail_->next.load(std::memory_order_acquire);
+    if (next == nullptr) {
+      return false;
+    }
+    item = std::move(next->item);
+    delete tail_;
+    tail_ = next;
+    return true;
+  }
+
+private:
+  struct Node {
+    Node() = default;
+    explicit Node(T v) : item(std::move(v)) {}
+    std::atomic<Node*> next {nullptr};
+    T item {};
+  };
+
+private:
+  // 生产者追加到 head_，消费者从 tail_ 取；tail_ 总是指向一个已取出（或初始）的哨兵节点
+  std::atomic<Node*> head_;
+  Node* tail_;
+};
+
+}  // namespace ling::utils
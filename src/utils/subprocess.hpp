@@ -0,0 +1,264 @@
+#pragma once
+
+/*
+ * 通过 stdin/stdout 管道与子进程交互，用于常驻的渲染 worker 等场景
+ *
+ * - 子进程的 stderr 继承自当前进程，便于排查问题
+ * - 写入已退出的子进程时返回 false，而不是被 SIGPIPE 杀死
+ * - run_shell：带超时的 system()，超时后杀掉整个进程组
+ */
+
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <spdlog/spdlog.h>
+
+namespace ling::utils {
+
+class Subprocess {
+public:
+  Subprocess() = default;
+  Subprocess(const Subprocess&) = delete;
+  Subprocess& operator=(const Subprocess&) = delete;
+  ~Subprocess() {
+    stop();
+  }
+
+  bool start(const std::vector<std::string>& argv);
+  // 写入全部数据，子进程已退出时返回 false
+  bool write_all(const std::string& data);
+  // 读取一行（不含 '\n'），超时或子进程关闭 stdout 时返回 false
+  bool read_line(std::string& line, std::chrono::milliseconds timeout);
+  void close_stdin();
+  // 立即杀掉子进程，阻塞在读写管道上的调用会随之返回；描述符仍由 stop 回收
+  void kill_now() const {
+    if (running()) {
+      kill(pid_, SIGKILL);
+    }
+  }
+  // 先关闭 stdin 等待子进程自行退出，超过 grace 后依次发送 SIGTERM、SIGKILL
+  void stop(std::chrono::milliseconds grace = std::chrono::seconds(3));
+
+  bool running() const {
+    return pid_ > 0;
+  }
+  pid_t pid() const {
+    return pid_;
+  }
+
+private:
+  bool wait_exit(std::chrono::milliseconds timeout);
+
+private:
+  pid_t pid_ {-1};
+  int stdin_fd_ {-1};
+  int stdout_fd_ {-1};
+  std::string read_buf_;
+};
+
+// 创建两端都带 FD_CLOEXEC 的管道。插件会并发 fork，Linux 上由 pipe2 原子完成，其他线程 fork 出的子进程不会继承管道端
+static bool cloexec_pipe(int fds[2]) {
+#if defined(__APPLE__)
+  // macOS 没有 pipe2，只能创建后再设置，与其他线程的 fork 之间仍有窗口
+  if (pipe(fds) != 0) {
+    return false;
+  }
+  for (const int fd : {fds[0], fds[1]}) {
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+  }
+  return true;
+#else
+  return pipe2(fds, O_CLOEXEC) == 0;
+#endif
+}
+
+inline bool Subprocess::start(const std::vector<std::string>& argv) {
+  if (running() || argv.empty()) {
+    return false;
+  }
+  // 子进程退出后继续写管道会触发 SIGPIPE，其默认行为是终止整个进程
+  std::signal(SIGPIPE, SIG_IGN);
+  int in_pipe[2];
+  int out_pipe[2];
+  if (!cloexec_pipe(in_pipe)) {
+    spdlog::error("failure to create pipe: {}", strerror(errno));
+    return false;
+  }
+  if (!cloexec_pipe(out_pipe)) {
+    spdlog::error("failure to create pipe: {}", strerror(errno));
+    close(in_pipe[0]);
+    close(in_pipe[1]);
+    return false;
+  }
+  std::vector<char*> args;
+  args.reserve(argv.size() + 1);
+  for (const auto& arg : argv) {
+    args.push_back(const_cast<char*>(arg.c_str()));
+  }
+  args.push_back(nullptr);
+  const pid_t pid = fork();
+  if (pid < 0) {
+    spdlog::error("failure to fork: {}", strerror(errno));
+    for (const int fd : {in_pipe[0], in_pipe[1], out_pipe[0], out_pipe[1]}) {
+      close(fd);
+    }
+    return false;
+  }
+  if (pid == 0) {
+    // 子进程：dup2 得到的描述符不带 O_CLOEXEC，其余管道端在 exec 时自动关闭
+    dup2(in_pipe[0], STDIN_FILENO);
+    dup2(out_pipe[1], STDOUT_FILENO);
+    std::signal(SIGPIPE, SIG_DFL);
+    execvp(args[0], args.data());
+    _exit(127);
+  }
+  close(in_pipe[0]);
+  close(out_pipe[1]);
+  pid_ = pid;
+  stdin_fd_ = in_pipe[1];
+  stdout_fd_ = out_pipe[0];
+  read_buf_.clear();
+  return true;
+}
+
+inline bool Subprocess::write_all(const std::string& data) {
+  size_t written = 0;
+  while (written < data.size()) {
+    if (stdin_fd_ < 0) {
+      return false;
+    }
+    const auto n = write(stdin_fd_, data.data() + written, data.size() - written);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    written += n;
+  }
+  return true;
+}
+
+inline bool Subprocess::read_line(std::string& line, const std::chrono::milliseconds timeout) {
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+  size_t scanned = 0;
+  while (true) {
+    if (const auto pos = read_buf_.find('\n', scanned); pos != std::string::npos) {
+      line.assign(read_buf_, 0, pos);
+      read_buf_.erase(0, pos + 1);
+      return true;
+    }
+    scanned = read_buf_.size();
+    if (stdout_fd_ < 0) {
+      return false;
+    }
+    const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+    if (left.count() <= 0) {
+      return false;
+    }
+    pollfd pfd {stdout_fd_, POLLIN, 0};
+    const int ready = poll(&pfd, 1, static_cast<int>(left.count()));
+    if (ready < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ready <= 0) {
+      return false;
+    }
+    char buf[64 * 1024];
+    const auto n = read(stdout_fd_, buf, sizeof(buf));
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    read_buf_.append(buf, n);
+  }
+}
+
+inline void Subprocess::close_stdin() {
+  if (stdin_fd_ >= 0) {
+    close(stdin_fd_);
+    stdin_fd_ = -1;
+  }
+}
+
+inline bool Subprocess::wait_exit(const std::chrono::milliseconds timeout) {
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+  while (true) {
+    int status = 0;
+    const pid_t r = waitpid(pid_, &status, WNOHANG);
+    if (r == pid_ || (r < 0 && errno == ECHILD)) {
+      return true;
+    }
+    if (std::chrono::steady_clock::now() >= deadline) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+}
+
+inline void Subprocess::stop(const std::chrono::milliseconds grace) {
+  if (!running()) {
+    return;
+  }
+  close_stdin();
+  if (!wait_exit(grace)) {
+    kill(pid_, SIGTERM);
+    if (!wait_exit(grace)) {
+      kill(pid_, SIGKILL);
+      wait_exit(std::chrono::seconds(1));
+    }
+  }
+  if (stdout_fd_ >= 0) {
+    close(stdout_fd_);
+    stdout_fd_ = -1;
+  }
+  pid_ = -1;
+}
+
+// 以 /bin/sh -c 执行命令，返回退出码；超时（timeout 为 0 表示不限时）或启动失败时返回 -1。
+// 子进程自成进程组，超时后连同其派生的进程（如 npm exec 拉起的 node）一起杀掉
+inline int run_shell(const std::string& cmd, const std::chrono::milliseconds timeout) {
+  const pid_t pid = fork();
+  if (pid < 0) {
+    spdlog::error("failure to fork: {}", strerror(errno));
+    return -1;
+  }
+  if (pid == 0) {
+    setpgid(0, 0);
+    execl("/bin/sh", "sh", "-c", cmd.c_str(), static_cast<char*>(nullptr));
+    _exit(127);
+  }
+  // 父子进程都设置一次，避免超时发生在子进程 setpgid 之前
+  setpgid(pid, pid);
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+  while (true) {
+    int status = 0;
+    const pid_t r = waitpid(pid, &status, WNOHANG);
+    if (r == pid) {
+      return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    }
+    if (r < 0 && errno != EINTR) {
+      return -1;
+    }
+    if (timeout.count() > 0 && std::chrono::steady_clock::now() >= deadline) {
+      spdlog::warn("command timeout after {}ms, killed: {}", timeout.count(), cmd);
+      kill(-pid, SIGKILL);
+      waitpid(pid, &status, 0);
+      return -1;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+}
+
+}  // namespace ling::utils
@@ -36,6 +36,19 @@ static std::string convert(const time_point<std::chrono::system_clock> tp) {
   return format2date(at);
 }
 
+// HTTP 日期（IMF-fixdate），如 Sun, 06 Nov 1994 08:49:37 GMT
+static std::string HTTP_DATE_FORMAT = "%a, %d %b %Y %H:%M:%S GMT";
+
+static std::string format_http_date(const absl::Time tp) {
+  return FormatTime(HTTP_DATE_FORMAT, tp, absl::UTCTimeZone());
+}
+
+// 只接受 IMF-fixdate，过时的 RFC 850、asctime 格式返回 false
+static bool parse_http_date(const std::string& date, absl::Time* tp) {
+  std::string err;
+  return absl::ParseTime(HTTP_DATE_FORMAT, date, absl::UTCTimeZone(), tp, &err);
+}
+
 static std::string date_format_convert(const std::string& date) {
   std::vector<absl::string_view> date_parts;
   if (date.find('/') != std::string::npos) {
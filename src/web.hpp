@@ -12,6 +12,7 @@
 #include "service/http/base_app.hpp"
 #include "service/http/handler.hpp"
 #include "service/http/router.hpp"
+#include "service/http/static_site.hpp"
 
 #include "storage/local_sqlite.h"
 #include "storage/hn_hnsw.hpp"
@@ -21,6 +22,7 @@
 #include "utils/ollama.hpp"
 #include "utils//time.hpp"
 #include "utils/executor.hpp"
+#include "utils/task_scheduler.hpp"
 
 DEFINE_string(host, "127.0.0.1", "server host to listen");
 DEFINE_uint32(port, 8000, "server port to listen");
@@ -72,6 +74,15 @@ static void simple_echo_handler(const HttpRequest& req, const HttpResponsePtr& r
   resp->with_header(header::ContentType, content_type::JSON);
 }
 
+// /tool/server/stats/
+// 各 loop 的连接与流量统计
+static void server_stats_handler(const HttpRequest& req, const HttpResponsePtr& resp, const DoneCallback& cb) {
+  DoneCallbackGuard guard{cb, resp}; // guard
+  resp->with_body(server::loop_stats().dump(2));
+  resp->with_code(HttpStatusCode::OK);
+  resp->with_header(header::ContentType, content_type::JSON);
+}
+
 // /tool/base64
 static void base64_handler(const HttpRequest& req, const HttpResponsePtr& resp, const DoneCallback& cb) {
   DoneCallbackGuard guard{cb, resp};
@@ -314,6 +325,7 @@ private:
   bool prepare() override;
   std::pair<std::string, int> host_port() override;
   std::unique_ptr<Router> router() override;
+  server::ServerOptions server_options() override;
   //
   bool init_db() const;
   bool load_hn_index() const;
@@ -350,8 +362,19 @@ inline bool WebApp::prepare() {
   current_path(absolute(dist_dir));
   spdlog::info("change working dir from {} to {}", origin_wd.string(), current_path().string());
   //
+  if (const auto& server_conf = conf_ptr_->server_conf; server_conf.static_cache) {
+    if (!StaticSite::singleton().load(current_path(), server_conf.static_cache_max_file_kb * 1024)) {
+      spdlog::error("failure to load static site");
+      return false;
+    }
+    if (const std::chrono::seconds period {server_conf.static_cache_refresh_sec}; period.count() > 0) {
+      utils::TaskScheduler::singleton().schedule([]() { StaticSite::singleton().refresh(); }, period, period);
+    }
+  }
+  //
   router_ptr_->add_routes({
       {{HTTP_METHOD::GET, "/tool/echo/"}, simple_echo_handler},
+      {{HTTP_METHOD::GET, "/tool/server/stats/"}, server_stats_handler},
       {{HTTP_METHOD::POST, "/tool/base64/"}, base64_handler},
       {{HTTP_METHOD::POST, "/tool/rss/register"}, rss_register_handler},
 #ifdef ENABLE_HN_SEARCH
@@ -377,6 +400,14 @@ inline std::pair<std::string, int> WebApp::host_port() {
   return std::make_pair(FLAGS_host, FLAGS_port);
 }
 
+inline server::ServerOptions WebApp::server_options() {
+  server::ServerOptions options;
+  options.threads = conf_ptr_->server_conf.threads;
+  options.keep_alive_timeout_ms = conf_ptr_->server_conf.keep_alive_timeout_sec * 1000;
+  options.max_keep_alive_requests = conf_ptr_->server_conf.max_keep_alive_requests;
+  return options;
+}
+
 inline std::unique_ptr<Router> WebApp::router() {
   return std::unique_ptr<Router>(router_ptr_.release());
 }
@@ -0,0 +1,97 @@
+#include <filesystem>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "utils/artifact_cache.hpp"
+
+using namespace ling::utils;
+
+namespace {
+
+std::filesystem::path fresh_cache_dir(const std::string& name) {
+  const auto dir = std::filesystem::temp_directory_path() / name;
+  std::filesystem::remove_all(dir);
+  return dir;
+}
+
+}  // namespace
+
+TEST(ArtifactCacheTest, make_key) {
+  const auto key = ArtifactCache::make_key("PlantUML", "1.2025.1", "A -> B");
+  EXPECT_EQ(key.size(), 64);
+  EXPECT_EQ(key, ArtifactCache::make_key("PlantUML", "1.2025.1", "A -> B"));
+  EXPECT_NE(key, ArtifactCache::make_key("PlantUML", "1.2025.2", "A -> B"));
+  EXPECT_NE(key, ArtifactCache::make_key("Mermaid", "1.2025.1", "A -> B"));
+  // 字段边界不同，拼接后相同的输入不能得到同一个键
+  EXPECT_NE(ArtifactCache::make_key("ab", "c", ""), ArtifactCache::make_key("a", "bc", ""));
+}
+
+TEST(ArtifactCacheTest, get_put_publish) {
+  const auto dir = fresh_cache_dir("artifact_cache_test_get_put");
+  auto& cache = ArtifactCache::singleton();
+  cache.configure(dir, 0);
+  cache.report();
+  const auto key = ArtifactCache::make_key("Test", "v1", "input");
+  std::string data;
+  EXPECT_FALSE(cache.get("Test", key, data));
+  ASSERT_TRUE(cache.put("Test", key, "<svg/>"));
+  ASSERT_TRUE(cache.get("Test", key, data));
+  EXPECT_EQ(data, "<svg/>");
+  //
+  const auto dest = dir / "public" / (key + ".svg");
+  ASSERT_TRUE(cache.publish("Test", key, dest));
+  EXPECT_EQ(read_file_all(dest), "<svg/>");
+  EXPECT_FALSE(cache.publish("Test", ArtifactCache::make_key("Test", "v1", "other"), dir / "public" / "other.svg"));
+  //
+  const auto st = cache.stats()["Test"];
+  EXPECT_EQ(st.hits, 2);
+  EXPECT_EQ(st.misses, 2);
+  EXPECT_EQ(st.writes, 1);
+  cache.report();
+  EXPECT_TRUE(cache.stats().empty());
+  std::filesystem::remove_all(dir);
+}
+
+TEST(ArtifactCacheTest, put_file_and_overwrite) {
+  const auto dir = fresh_cache_dir("artifact_cache_test_put_file");
+  auto& cache = ArtifactCache::singleton();
+  cache.configure(dir, 0);
+  const auto src = dir / "work" / "post.pdf";
+  create_directories(src.parent_path());
+  ASSERT_TRUE(write_file_atomic(src, "%PDF-new"));
+  ASSERT_TRUE(cache.put_file("Test", "post", src));
+  EXPECT_FALSE(exists(src));
+  // dest 不以缓存键命名时需覆盖已有的旧文件
+  const auto dest = dir / "public" / "post.pdf";
+  create_directories(dest.parent_path());
+  ASSERT_TRUE(write_file_atomic(dest, "%PDF-old"));
+  ASSERT_TRUE(cache.publish("Test", "post", dest, true));
+  EXPECT_EQ(read_file_all(dest), "%PDF-new");
+  cache.report();
+  std::filesystem::remove_all(dir);
+}
+
+TEST(ArtifactCacheTest, evict_least_recently_used) {
+  const auto dir = fresh_cache_dir("artifact_cache_test_evict");
+  auto& cache = ArtifactCache::singleton();
+  cache.configure(dir, 250);
+  const std::string payload(100, 'x');
+  const auto now = std::filesystem::file_time_type::clock::now();
+  for (int idx = 0; idx < 3; idx++) {
+    const auto key = std::to_string(idx);
+    ASSERT_TRUE(cache.put("Test", key, payload));
+    std::filesystem::last_write_time(cache.path_of("Test", key), now - std::chrono::hours(3 - idx));
+  }
+  // 访问最旧的 0，淘汰时应跳过它而淘汰 1
+  std::string data;
+  ASSERT_TRUE(cache.get("Test", "0", data));
+  EXPECT_EQ(cache.evict(), 1);
+  EXPECT_TRUE(exists(cache.path_of("Test", "0")));
+  EXPECT_FALSE(exists(cache.path_of("Test", "1")));
+  EXPECT_TRUE(exists(cache.path_of("Test", "2")));
+  EXPECT_EQ(cache.stats()["Test"].evictions, 1);
+  cache.report();
+  cache.configure(".artifact_cache", 512ull << 20);
+  std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,175 @@
+/*
+ * Markdown 解析/渲染吞吐基准
+ *
+ * 对 demo/blog/posts 语料以及若干合成输入，分别测量 Markdown::parse_str 与 Markdown::to_html 的
+ * 吞吐（MB/s）和每 KB 输入的内存分配次数。
+ *
+ * 示例：./markdown_bench --corpus_dir=../../demo/blog/posts --rounds=20
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <fmt/core.h>
+#include <gflags/gflags.h>
+#include <spdlog/spdlog.h>
+
+#include "parser/markdown.h"
+#include "utils/strings.hpp"
+
+DEFINE_string(corpus_dir, "../../demo/blog/posts", "markdown corpus directory");
+DEFINE_uint32(rounds, 10, "rounds per input");
+
+// 统计分配次数：只替换本基准程序的全局 operator new
+static std::atomic_uint64_t alloc_cnt{0};
+
+void* operator new(size_t size) {
+  alloc_cnt.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(size == 0 ? 1 : size)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  std::free(p);
+}
+
+namespace ling::bench {
+
+using std::chrono::steady_clock;
+
+struct BenchInput {
+  std::string name;
+  std::vector<std::string> docs;
+  size_t total_bytes = 0;
+};
+
+struct BenchResult {
+  double parse_mb_per_sec = 0;
+  double render_mb_per_sec = 0;
+  double parse_allocs_per_kb = 0;
+  double render_allocs_per_kb = 0;
+  size_t failed = 0;
+};
+
+static BenchInput load_corpus(const std::filesystem::path& dir) {
+  BenchInput input{"corpus"};
+  if (!exists(dir)) {
+    spdlog::warn("corpus dir not exists: {}", dir.string());
+    return input;
+  }
+  for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+    if (!entry.is_regular_file() || entry.path().extension() != ".md") {
+      continue;
+    }
+    input.docs.emplace_back(utils::read_file_all(entry.path()));
+    input.total_bytes += input.docs.back().size();
+  }
+  return input;
+}
+
+static BenchInput make_input(const std::string& name, std::string doc) {
+  BenchInput input{name};
+  input.total_bytes = doc.size();
+  input.docs.emplace_back(std::move(doc));
+  return input;
+}
+
+static std::vector<BenchInput> synthetic_inputs() {
+  std::vector<BenchInput> inputs;
+  std::string paragraphs;
+  std::string table = "| Name | Type | Desc |\n| :--- | :---: | ---: |\n";
+  std::string lists;
+  std::string code = "```cpp\n";
+  std::string html_code = "```html\n";
+  for (int idx = 0; idx < 2000; idx++) {
+    paragraphs += fmt::format(
+        "这是第 {} 段，包含 **粗体**、*斜体*、~~删除线~~、`inline <code>`、[链接](https://example.com/{}) "
+        "以及 $x^{}$ 公式[^{}]。\n\n",
+        idx, idx, idx % 10, idx % 50);
+    table += fmt::format("| row{} | `int` | value {} & more |\n", idx, idx);
+    lists += fmt::format("- item {}\n  - child {}\n    - grandchild {}\n", idx, idx, idx);
+    code += fmt::format("for (int i = 0; i < {}; i++) {{ v.push_back(i << 1); }}\n", idx);
+    html_code += fmt::format("<div class=\"row\" data-id='{}'>a &amp; b</div>\n", idx);
+  }
+  code += "```\n";
+  html_code += "```\n";
+  inputs.emplace_back(make_input("paragraphs", paragraphs));
+  inputs.emplace_back(make_input("table", table));
+  inputs.emplace_back(make_input("nested_list", lists));
+  inputs.emplace_back(make_input("codeblock", code));
+  inputs.emplace_back(make_input("html_codeblock", html_code));
+  return inputs;
+}
+
+static BenchResult run(const BenchInput& input, const uint32_t rounds) {
+  BenchResult result;
+  std::chrono::nanoseconds parse_cost{0};
+  std::chrono::nanoseconds render_cost{0};
+  uint64_t parse_allocs = 0;
+  uint64_t render_allocs = 0;
+  size_t html_bytes = 0;
+  for (uint32_t r = 0; r < rounds; r++) {
+    for (const auto& doc : input.docs) {
+      Markdown md;
+      auto alloc_start = alloc_cnt.load();
+      auto start = steady_clock::now();
+      const bool ok = md.parse_str(doc);
+      parse_cost += steady_clock::now() - start;
+      parse_allocs += alloc_cnt.load() - alloc_start;
+      if (!ok) {
+        result.failed++;
+        continue;
+      }
+      alloc_start = alloc_cnt.load();
+      start = steady_clock::now();
+      html_bytes += md.to_html().size();
+      render_cost += steady_clock::now() - start;
+      render_allocs += alloc_cnt.load() - alloc_start;
+    }
+  }
+  const double total_mb = static_cast<double>(input.total_bytes) * rounds / (1024 * 1024);
+  const double total_kb = static_cast<double>(input.total_bytes) * rounds / 1024;
+  result.parse_mb_per_sec = total_mb / std::chrono::duration<double>(parse_cost).count();
+  result.render_mb_per_sec = total_mb / std::chrono::duration<double>(render_cost).count();
+  result.parse_allocs_per_kb = static_cast<double>(parse_allocs) / total_kb;
+  result.render_allocs_per_kb = static_cast<double>(render_allocs) / total_kb;
+  spdlog::debug("{} rendered {} bytes", input.name, html_bytes);
+  return result;
+}
+
+}  // namespace ling::bench
+
+int main(int argc, char** argv) {
+  using namespace ling::bench;
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  spdlog::set_level(spdlog::level::err);  // 解析告警不计入耗时
+  //
+  std::vector<BenchInput> inputs;
+  inputs.emplace_back(load_corpus(FLAGS_corpus_dir));
+  for (auto& input : synthetic_inputs()) {
+    inputs.emplace_back(std::move(input));
+  }
+  fmt::print("{:<16}{:>8}{:>10}{:>14}{:>15}{:>14}{:>17}{:>8}\n", "input", "docs", "KB", "parse MB/s", "parse alloc/KB",
+             "render MB/s", "render alloc/KB", "failed");
+  for (const auto& input : inputs) {
+    if (input.docs.empty()) {
+      continue;
+    }
+    const auto r = run(input, FLAGS_rounds);
+    fmt::print("{:<16}{:>8}{:>10.1f}{:>14.2f}{:>15.1f}{:>14.2f}{:>17.1f}{:>8}\n", input.name, input.docs.size(),
+               input.total_bytes / 1024.0, r.parse_mb_per_sec, r.parse_allocs_per_kb, r.render_mb_per_sec,
+               r.render_allocs_per_kb, r.failed);
+  }
+  return 0;
+}
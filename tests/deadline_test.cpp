@@ -0,0 +1,63 @@
+#include <chrono>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "utils/deadline.hpp"
+#include "utils/subprocess.hpp"
+
+using namespace ling::utils;
+using namespace std::chrono_literals;
+
+TEST(DeadlineTest, unlimited_and_earliest) {
+  const Deadline unlimited;
+  EXPECT_TRUE(unlimited.unlimited());
+  EXPECT_FALSE(unlimited.expired());
+  EXPECT_EQ(unlimited.remaining(5s), 5s);
+  EXPECT_TRUE(Deadline::after(0ms).unlimited());
+  //
+  const auto soon = Deadline::after(50ms);
+  const auto later = Deadline::after(1h);
+  EXPECT_LE(Deadline::earliest(soon, later).remaining(1h), 50ms);
+  EXPECT_LE(Deadline::earliest(unlimited, soon).remaining(1h), 50ms);
+  EXPECT_LE(Deadline::earliest(later, unlimited).remaining(2h), 1h);
+  std::this_thread::sleep_for(60ms);
+  EXPECT_TRUE(soon.expired());
+  EXPECT_EQ(soon.remaining(5s), 0ms);
+  // 用作超时参数时不能是 0
+  EXPECT_EQ(soon.timeout(5s), 1ms);
+}
+
+TEST(DeadlineTest, scope_is_per_thread_and_restored) {
+  EXPECT_TRUE(Deadline::current().unlimited());
+  {
+    Deadline::Scope outer(Deadline::after(1h), "Outer@doc");
+    EXPECT_FALSE(Deadline::current().unlimited());
+    {
+      Deadline::Scope inner(Deadline::after(0ms));
+      EXPECT_TRUE(Deadline::current().unlimited());
+      EXPECT_EQ(Deadline::current_owner(), "Outer@doc");
+    }
+    EXPECT_FALSE(Deadline::current().unlimited());
+    std::thread([] {
+      EXPECT_TRUE(Deadline::current().unlimited());
+      EXPECT_TRUE(Deadline::current_owner().empty());
+    }).join();
+    report_timeout("diagram a.svg");
+  }
+  EXPECT_TRUE(Deadline::current().unlimited());
+  const auto items = TimeoutReport::singleton().take();
+  ASSERT_EQ(items.size(), 1);
+  EXPECT_EQ(items[0].first, "Outer@doc");
+  EXPECT_EQ(items[0].second, "diagram a.svg");
+  EXPECT_TRUE(TimeoutReport::singleton().take().empty());
+}
+
+TEST(DeadlineTest, run_shell_kills_on_timeout) {
+  EXPECT_EQ(run_shell("exit 3", 0ms), 3);
+  EXPECT_EQ(run_shell("true", 1s), 0);
+  const auto start = std::chrono::steady_clock::now();
+  // 子 shell 派生的 sleep 也应随进程组一起被杀掉
+  EXPECT_EQ(run_shell("sleep 5 | cat", 100ms), -1);
+  EXPECT_LT(std::chrono::steady_clock::now() - start, 2s);
+}
@@ -0,0 +1,124 @@
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "service/http/encoding.hpp"
+
+using namespace ling::http;
+
+TEST(EncodingTest, accept_encoding_q) {
+  EXPECT_EQ(accept_encoding_q("gzip, deflate, br", "gzip"), 1);
+  EXPECT_EQ(accept_encoding_q("deflate, GZIP;q=0.5", "gzip"), 0.5);
+  EXPECT_EQ(accept_encoding_q("gzip;q=0, *", "gzip"), 0);
+  EXPECT_EQ(accept_encoding_q("br, *;q=0.1", "gzip"), 0.1);
+  EXPECT_EQ(accept_encoding_q("br", "gzip"), 0);
+  EXPECT_EQ(accept_encoding_q("", "gzip"), 0);
+  //
+  HttpRequest req;
+  EXPECT_FALSE(accepts_gzip(req));
+  req.headers[header::AcceptEncoding] = "gzip;q=0";
+  EXPECT_FALSE(accepts_gzip(req));
+  req.headers[header::AcceptEncoding] = "br, gzip";
+  EXPECT_TRUE(accepts_gzip(req));
+}
+
+TEST(EncodingTest, compressible_type) {
+  EXPECT_TRUE(is_compressible_type("application/json"));
+  EXPECT_TRUE(is_compressible_type("text/html; charset=utf-8"));
+  EXPECT_FALSE(is_compressible_type("image/png"));
+  EXPECT_FALSE(is_compressible_type("application/octet-stream"));
+}
+
+TEST(EncodingTest, negotiate_dynamic_response) {
+  std::string json = "[";
+  for (int idx = 0; idx < 200; idx++) {
+    json += "{\"id\": " + std::to_string(idx) + "},";
+  }
+  json += "{}]";
+  // 客户端不接受 gzip 时原样返回，但仍带上 Vary
+  HttpResponse plain;
+  plain.with_header(header::ContentType, content_type::JSON);
+  plain.with_body(json);
+  plain.negotiate_encoding(false);
+  char* buf = nullptr;
+  size_t size = 0;
+  plain.generate(&buf, &size);
+  std::string out(buf, size);
+  free(buf);
+  EXPECT_NE(out.find("Vary: Accept-Encoding\r\n"), std::string::npos);
+  EXPECT_EQ(out.find("Content-Encoding"), std::string::npos);
+  EXPECT_EQ(out.substr(out.size() - json.size()), json);
+  //
+  HttpResponse gzipped;
+  gzipped.with_header(header::ContentType, content_type::JSON);
+  gzipped.with_body(json);
+  gzipped.negotiate_encoding(true);
+  size = 0;
+  gzipped.generate(&buf, &size);
+  out.assign(buf, size);
+  free(buf);
+  EXPECT_NE(out.find("Content-Encoding: gzip\r\n"), std::string::npos);
+  std::string body;
+  ASSERT_TRUE(ling::utils::gzip_decompress(out.substr(out.find("\r\n\r\n") + 4), &body));
+  EXPECT_EQ(body, json);
+  // 太小的、带有 ETag 的不压缩
+  HttpResponse small;
+  small.with_header(header::ContentType, content_type::JSON);
+  small.with_body("{}");
+  small.negotiate_encoding(true);
+  size = 0;
+  small.generate(&buf, &size);
+  out.assign(buf, size);
+  free(buf);
+  EXPECT_EQ(out.find("Content-Encoding"), std::string::npos);
+  EXPECT_EQ(out.find("Vary"), std::string::npos);
+  HttpResponse tagged;
+  tagged.with_header(header::ContentType, content_type::JSON);
+  tagged.with_header(header::ETag, "\"x\"");
+  tagged.with_body(json);
+  tagged.negotiate_encoding(true);
+  size = 0;
+  tagged.generate(&buf, &size);
+  out.assign(buf, size);
+  free(buf);
+  EXPECT_EQ(out.find("Content-Encoding"), std::string::npos);
+}
+
+TEST(EncodingTest, compression_cache) {
+  auto& cache = CompressionCache::singleton();
+  int reads = 0;
+  const std::string content(100 * 1024, 'a');
+  const auto read = [&](std::string* out) {
+    reads++;
+    *out = content;
+    return true;
+  };
+  Compressed first;
+  ASSERT_TRUE(cache.gzip("\"a\"", read, &first));
+  ASSERT_NE(first.body, nullptr);
+  EXPECT_NE(first.etag, "\"a\"");
+  Compressed second;
+  ASSERT_TRUE(cache.gzip("\"a\"", read, &second));
+  EXPECT_EQ(second.body, first.body);
+  EXPECT_EQ(reads, 1);
+  // 没有变小的也记录下来
+  const auto read_tiny = [&](std::string* out) {
+    reads++;
+    *out = "\x01\x02";
+    return true;
+  };
+  Compressed incompressible;
+  ASSERT_TRUE(cache.gzip("\"b\"", read_tiny, &incompressible));
+  ASSERT_TRUE(cache.gzip("\"b\"", read_tiny, &incompressible));
+  EXPECT_EQ(incompressible.body, nullptr);
+  EXPECT_EQ(reads, 2);
+  // 读取失败不记录
+  EXPECT_FALSE(cache.gzip("\"c\"", [](std::string*) { return false; }, &incompressible));
+  // 超过容量时淘汰最久未用的 a
+  cache.capacity(first.body->size());
+  ASSERT_TRUE(cache.gzip("\"b\"", read_tiny, &incompressible));
+  EXPECT_EQ(reads, 2);
+  ASSERT_TRUE(cache.gzip("\"a\"", read, &second));
+  EXPECT_EQ(reads, 3);
+  cache.capacity(64 * 1024 * 1024);
+}
@@ -0,0 +1,63 @@
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "utils/fd_cache.hpp"
+
+using namespace ling::utils;
+
+namespace {
+
+std::filesystem::path write_file(const std::filesystem::path& path, const std::string& content) {
+  std::ofstream(path, std::ios::binary | std::ios::trunc) << content;
+  return path;
+}
+
+}  // namespace
+
+TEST(FdCacheTest, reuse_and_reopen_on_change) {
+  const auto dir = std::filesystem::temp_directory_path() / "fd_cache_test_reuse";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  auto& cache = FdCache::singleton();
+  const auto path = write_file(dir / "a.txt", "hello");
+  const auto file = cache.open(path);
+  ASSERT_NE(file, nullptr);
+  EXPECT_EQ(file->size, 5);
+  EXPECT_EQ(cache.open(path), file);
+  // 重新构建时文件被替换，需重新打开；旧的描述符在引用释放前仍可读
+  const auto tmp = write_file(dir / "a.txt.tmp", "hello world");
+  std::filesystem::rename(tmp, path);
+  const auto reopened = cache.open(path);
+  ASSERT_NE(reopened, nullptr);
+  EXPECT_NE(reopened, file);
+  EXPECT_EQ(reopened->size, 11);
+  EXPECT_EQ(file->content_hash(), sha256_hex("hello"));
+  EXPECT_EQ(reopened->content_hash(), sha256_hex("hello world"));
+  char buf[5];
+  EXPECT_EQ(pread(file->fd, buf, sizeof(buf), 0), 5);
+  EXPECT_EQ(std::string(buf, 5), "hello");
+  //
+  EXPECT_EQ(cache.open(dir / "missing.txt"), nullptr);
+  EXPECT_EQ(cache.open(dir), nullptr);
+  std::filesystem::remove_all(dir);
+}
+
+TEST(FdCacheTest, evict_least_recently_used) {
+  const auto dir = std::filesystem::temp_directory_path() / "fd_cache_test_evict";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  auto& cache = FdCache::singleton();
+  cache.capacity(2);
+  const auto a = cache.open(write_file(dir / "a", "a"));
+  const auto b = cache.open(write_file(dir / "b", "b"));
+  EXPECT_EQ(cache.open(dir / "a"), a);
+  // 淘汰最久未用的 b
+  cache.open(write_file(dir / "c", "c"));
+  EXPECT_EQ(cache.open(dir / "a"), a);
+  EXPECT_NE(cache.open(dir / "b"), b);
+  cache.capacity(256);
+  std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,29 @@
+/*
+ * Markdown::parse_str 的 libFuzzer 入口
+ *
+ * 构建：ENABLE_FUZZ=1 cmake ...（仅 clang）
+ * 运行：./markdown_fuzzer -timeout=2 -max_len=65536 corpus/ ../../demo/blog/posts
+ *
+ * 未捕获的异常（如 lines.at() 越界）、ASan/UBSan 报告的内存错误以及超时都会被 libFuzzer 当作 crash 记录下来。
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <spdlog/spdlog.h>
+
+#include "parser/markdown.h"
+
+extern "C" int LLVMFuzzerInitialize(int* argc, char*** argv) {
+  spdlog::set_level(spdlog::level::off);
+  return 0;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+  ling::Markdown md;
+  if (md.parse_str(std::string(reinterpret_cast<const char*>(data), size))) {
+    md.to_html();
+  }
+  return 0;
+}
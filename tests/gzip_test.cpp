@@ -0,0 +1,34 @@
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "utils/gzip.hpp"
+
+using namespace ling::utils;
+
+TEST(GzipTest, round_trip) {
+  std::string input;
+  for (int idx = 0; idx < 2000; idx++) {
+    input += "{\"id\": " + std::to_string(idx) + ", \"title\": \"hello world\"},\n";
+  }
+  std::string compressed;
+  ASSERT_TRUE(gzip_compress(input, &compressed));
+  EXPECT_LT(compressed.size(), input.size() / 4);
+  // gzip 魔数
+  ASSERT_GE(compressed.size(), 2);
+  EXPECT_EQ(static_cast<unsigned char>(compressed[0]), 0x1f);
+  EXPECT_EQ(static_cast<unsigned char>(compressed[1]), 0x8b);
+  std::string output;
+  ASSERT_TRUE(gzip_decompress(compressed, &output));
+  EXPECT_EQ(output, input);
+}
+
+TEST(GzipTest, empty_and_invalid) {
+  std::string compressed;
+  ASSERT_TRUE(gzip_compress("", &compressed));
+  std::string output = "stale";
+  ASSERT_TRUE(gzip_decompress(compressed, &output));
+  EXPECT_EQ(output, "");
+  EXPECT_FALSE(gzip_decompress("not gzip", &output));
+  EXPECT_FALSE(gzip_decompress(compressed.substr(0, compressed.size() - 4), &output));
+}
@@ -0,0 +1,37 @@
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <filesystem>
+
+#include <gtest/gtest.h>
+
+#include "utils/hash.hpp"
+#include "utils/helper.hpp"
+#include "utils/strings.hpp"
+
+TEST(HashTest, sha256_hex) {
+  EXPECT_EQ(ling::utils::sha256_hex(""), "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+  EXPECT_EQ(ling::utils::sha256_hex("abc"), "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+}
+
+TEST(HashTest, sha256_hex_of_fd) {
+  const auto fp = std::filesystem::temp_directory_path() / "sha256_hex_of_fd_test.bin";
+  const std::string content(200 * 1024 + 7, 'x');
+  ASSERT_TRUE(ling::utils::write_file_atomic(fp, content));
+  const int fd = open(fp.c_str(), O_RDONLY);
+  ASSERT_GE(fd, 0);
+  EXPECT_EQ(ling::utils::sha256_hex_of_fd(fd, content.size()), ling::utils::sha256_hex(content));
+  EXPECT_EQ(ling::utils::sha256_hex_of_fd(fd, 3), ling::utils::sha256_hex("xxx"));
+  // 文件比声明的短
+  EXPECT_EQ(ling::utils::sha256_hex_of_fd(fd, content.size() + 1), "");
+  close(fd);
+  std::filesystem::remove(fp);
+}
+
+TEST(HashTest, write_file_atomic) {
+  const auto fp = std::filesystem::temp_directory_path() / "write_file_atomic_test.txt";
+  ASSERT_TRUE(ling::utils::write_file_atomic(fp, "old"));
+  ASSERT_TRUE(ling::utils::write_file_atomic(fp, "new content"));
+  EXPECT_EQ(ling::utils::read_file_all(fp), "new content");
+  std::filesystem::remove(fp);
+}
@@ -0,0 +1,60 @@
+#include <filesystem>
+#include <memory>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "plugin/highlight.hpp"
+#include "utils/artifact_cache.hpp"
+
+using namespace ling;
+
+namespace {
+
+std::string render(plugin::Highlight& highlight, const std::string& md_content, inja::json* render_vars) {
+  const auto md_ptr = std::make_shared<Markdown>();
+  EXPECT_TRUE(md_ptr->parse_str(md_content));
+  EXPECT_TRUE(highlight.run(md_ptr));
+  *render_vars = md_ptr->render_vars();
+  return md_ptr->to_html();
+}
+
+}  // namespace
+
+TEST(HighlightTest, build_mode_falls_back_to_client_for_unsupported_languages) {
+  const auto cache_dir = std::filesystem::temp_directory_path() / "highlight_test_cache";
+  std::filesystem::remove_all(cache_dir);
+  utils::ArtifactCache::singleton().configure(cache_dir, 0);
+  auto ctx = std::make_shared<Context>();
+  plugin::Highlight highlight;
+  ASSERT_TRUE(highlight.init(ctx));
+  // 脚本只登记在按需注入的位置，由模板按页面的 client_highlight 变量决定是否输出
+  auto& render_ctx = ctx->with_render_ctx();
+  EXPECT_TRUE(render_ctx[to_string(FeInjectPos::PLUGIN_AFTER_FOOTER_PARTS)].empty());
+  ASSERT_EQ(render_ctx[to_string(FeInjectPos::PLUGIN_CLIENT_HIGHLIGHT_PARTS)].size(), 1);
+  EXPECT_EQ(render_ctx[to_string(FeInjectPos::PLUGIN_CLIENT_HIGHLIGHT_PARTS)][0], plugin::HIGHLIGHT_JS);
+  // 构建时支持的语言直接输出高亮结果，页面不加载 highlight.js
+  inja::json render_vars;
+  auto html = render(highlight, "```cpp\nint a = 1;\n```\n\n```text\nplain\n```\n", &render_vars);
+  EXPECT_NE(html.find(R"(<code class="hljs language-cpp" data-highlighted="yes">)"), std::string::npos);
+  EXPECT_NE(html.find(R"(<span class="hljs-keyword">int</span>)"), std::string::npos);
+  EXPECT_FALSE(render_vars.contains("client_highlight"));
+  // 不支持的语言仍由 highlight.js 高亮，正文（也用于 RSS）中不含脚本
+  html = render(highlight, "```java\nclass A {}\n```\n\n```cpp\nint a = 1;\n```\n\n```javascript\nlet a;\n```\n",
+                &render_vars);
+  EXPECT_NE(html.find(R"(<pre class="language-java"><code>class A {}</code></pre>)"), std::string::npos);
+  EXPECT_NE(html.find(R"(<pre class="language-javascript"><code>let a;</code></pre>)"), std::string::npos);
+  EXPECT_NE(html.find(R"(data-highlighted="yes")"), std::string::npos);
+  EXPECT_EQ(html.find("<script"), std::string::npos);
+  EXPECT_EQ(render_vars["client_highlight"], true);
+  std::filesystem::remove_all(cache_dir);
+}
+
+TEST(HighlightTest, needs_client_highlight) {
+  EXPECT_TRUE(plugin::needs_client_highlight("java"));
+  EXPECT_TRUE(plugin::needs_client_highlight("PHP"));
+  EXPECT_FALSE(plugin::needs_client_highlight(""));
+  EXPECT_FALSE(plugin::needs_client_highlight("text"));
+  EXPECT_FALSE(plugin::needs_client_highlight("plantuml-svg"));
+  EXPECT_FALSE(plugin::needs_client_highlight("mermaid"));
+}
@@ -0,0 +1,70 @@
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "utils/highlighter.hpp"
+
+using ling::utils::highlight_code;
+
+static std::string hl(const std::string& lang, const std::string& code) {
+  std::string out;
+  EXPECT_TRUE(highlight_code(lang, code, out));
+  return out;
+}
+
+TEST(HighlighterTest, unsupported_language) {
+  std::string out;
+  EXPECT_FALSE(highlight_code("brainfuck", "+-<>", out));
+  EXPECT_TRUE(out.empty());
+}
+
+TEST(HighlighterTest, cpp) {
+  EXPECT_EQ(hl("cpp", "#include <vector>\nint x = 42; // answer"),
+            R"(<span class="hljs-meta">#include &lt;vector&gt;</span>)"
+            "\n"
+            R"(<span class="hljs-keyword">int</span> x = <span class="hljs-number">42</span>; )"
+            R"(<span class="hljs-comment">// answer</span>)");
+  EXPECT_EQ(hl("C++", R"(foo("a\"b");)"),
+            R"(<span class="hljs-title function_">foo</span>()"
+            R"(<span class="hljs-string">&quot;a\&quot;b&quot;</span>);)");
+  // 标识符中间的数字、关键字前缀都不能被切出来
+  EXPECT_EQ(hl("cpp", "x1 intx"), "x1 intx");
+}
+
+TEST(HighlighterTest, python) {
+  EXPECT_EQ(hl("python", "def f():\n    return None  # done\n'''doc\nstring'''"),
+            R"(<span class="hljs-keyword">def</span> <span class="hljs-title function_">f</span>():)"
+            "\n    "
+            R"(<span class="hljs-keyword">return</span> <span class="hljs-literal">None</span>  )"
+            R"(<span class="hljs-comment"># done</span>)"
+            "\n"
+            R"(<span class="hljs-string">&apos;&apos;&apos;doc)"
+            "\n"
+            R"(string&apos;&apos;&apos;</span>)");
+}
+
+TEST(HighlighterTest, bash) {
+  EXPECT_EQ(hl("sh", "echo ${#arr[@]} $HOME # c"),
+            R"(<span class="hljs-built_in">echo</span> <span class="hljs-variable">${#arr[@]}</span> )"
+            R"(<span class="hljs-variable">$HOME</span> <span class="hljs-comment"># c</span>)");
+}
+
+TEST(HighlighterTest, sql_case_insensitive) {
+  EXPECT_EQ(hl("sql", "SELECT count(*) FROM t"),
+            R"(<span class="hljs-keyword">SELECT</span> <span class="hljs-built_in">count</span>(*) )"
+            R"(<span class="hljs-keyword">FROM</span> t)");
+}
+
+TEST(HighlighterTest, toml_and_json) {
+  EXPECT_EQ(hl("toml", "[server]\nport = 8080"),
+            R"(<span class="hljs-section">[server]</span>)"
+            "\n"
+            R"(<span class="hljs-attr">port</span> = <span class="hljs-number">8080</span>)");
+  EXPECT_EQ(hl("json", R"({"a": "b", "c": true})"),
+            R"({<span class="hljs-attr">&quot;a&quot;</span>: <span class="hljs-string">&quot;b&quot;</span>, )"
+            R"(<span class="hljs-attr">&quot;c&quot;</span>: <span class="hljs-literal">true</span>})");
+}
+
+TEST(HighlighterTest, go_raw_string) {
+  EXPECT_EQ(hl("go", "s := `a\nb`"), "s := <span class=\"hljs-string\">`a\nb`</span>");
+}
@@ -0,0 +1,36 @@
+#include <gtest/gtest.h>
+
+#include <inja/inja.hpp>
+
+#include "utils/html_escape.hpp"
+
+TEST(HtmlEscapeTest, escape) {
+  EXPECT_EQ(ling::utils::html_escape(""), "");
+  EXPECT_EQ(ling::utils::html_escape("plain text"), "plain text");
+  EXPECT_EQ(ling::utils::html_escape("<a href=\"x\">'&'</a>"),
+            "&lt;a href=&quot;x&quot;&gt;&apos;&amp;&apos;&lt;/a&gt;");
+}
+
+TEST(HtmlEscapeTest, same_as_inja) {
+  // 覆盖 32/16 字节块的边界以及尾部的逐字节处理
+  const std::string pattern = "std::vector<int> v; if (a && b) { s = \"x\"; c = 'y'; } // 中文注释 ";
+  std::string input;
+  for (size_t len = 0; len < 200; len++) {
+    input.push_back(pattern[len % pattern.size()]);
+    EXPECT_EQ(ling::utils::html_escape(input), inja::htmlescape(input));
+  }
+}
+
+TEST(HtmlEscapeTest, append_to_buffer) {
+  std::string buf = "<code>";
+  ling::utils::html_escape("a<b", buf);
+  buf.append("</code>");
+  EXPECT_EQ(buf, "<code>a&lt;b</code>");
+  //
+  std::string s = "no need to escape";
+  ling::utils::html_escape_inplace(s);
+  EXPECT_EQ(s, "no need to escape");
+  s = "x > y";
+  ling::utils::html_escape_inplace(s);
+  EXPECT_EQ(s, "x &gt; y");
+}
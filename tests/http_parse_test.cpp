@@ -0,0 +1,101 @@
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "service/http/protocol.hpp"
+
+using namespace ling::http;
+using ling::ParseStatus;
+using ling::utils::IOBuf;
+
+TEST(HttpParseTest, pipelined_requests) {
+  // 一次读到两个流水线请求，第一个解析完后剩下的字节留给下一个
+  IOBuf buf;
+  buf.append("POST /a HTTP/1.1\r\nContent-Length: 5\r\n\r\nhelloGET /b HTTP/1.1\r\nHost: x\r\n\r\n");
+  HttpRequest first;
+  ASSERT_EQ(first.parse(buf), ParseStatus::COMPLETE);
+  EXPECT_EQ(first.action, "POST");
+  EXPECT_EQ(first.raw_q, "/a");
+  EXPECT_EQ(first.body, "hello");
+  HttpRequest second;
+  ASSERT_EQ(second.parse(buf), ParseStatus::COMPLETE);
+  EXPECT_EQ(second.action, "GET");
+  EXPECT_EQ(second.raw_q, "/b");
+  EXPECT_TRUE(second.body.empty());
+  EXPECT_TRUE(buf.empty());
+}
+
+TEST(HttpParseTest, body_across_segments) {
+  // 请求头与请求体分几次读到，请求体跨越多段
+  IOBuf buf;
+  HttpRequest req;
+  buf.append("POST /echo HTTP/1.1\r\nContent-");
+  EXPECT_EQ(req.parse(buf), ParseStatus::CONTINUE);
+  buf.append("Length: 10\r\n\r\n0123");
+  EXPECT_EQ(req.parse(buf), ParseStatus::CONTINUE);
+  buf.append("45");
+  EXPECT_EQ(req.parse(buf), ParseStatus::CONTINUE);
+  buf.append("6789GET");
+  ASSERT_EQ(req.parse(buf), ParseStatus::COMPLETE);
+  EXPECT_EQ(req.body, "0123456789");
+  EXPECT_EQ(buf.view(), "GET");
+}
+
+TEST(HttpParseTest, content_length) {
+  // 数据不足 Content-Length 时等待，负数与 Transfer-Encoding 不接受
+  IOBuf buf;
+  HttpRequest cut;
+  buf.append("POST / HTTP/1.1\r\nContent-Length: 8\r\n\r\nabc");
+  EXPECT_EQ(cut.parse(buf), ParseStatus::CONTINUE);
+  EXPECT_TRUE(cut.body.empty());
+  EXPECT_EQ(buf.view(), "abc");
+  //
+  IOBuf negative;
+  negative.append("POST / HTTP/1.1\r\nContent-Length: -1\r\n\r\n");
+  HttpRequest req;
+  EXPECT_EQ(req.parse(negative), ParseStatus::INVALID);
+  IOBuf chunked;
+  chunked.append("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n");
+  HttpRequest chunked_req;
+  EXPECT_EQ(chunked_req.parse(chunked), ParseStatus::INVALID);
+}
+
+TEST(HttpParseTest, keep_alive) {
+  const auto keep_alive = [](const std::string& raw) {
+    IOBuf buf;
+    buf.append(raw);
+    HttpRequest req;
+    EXPECT_EQ(req.parse(buf), ParseStatus::COMPLETE);
+    return req.keep_alive;
+  };
+  // HTTP/1.1 默认保持，HTTP/1.0 需显式声明
+  EXPECT_TRUE(keep_alive("GET / HTTP/1.1\r\n\r\n"));
+  EXPECT_FALSE(keep_alive("GET / HTTP/1.1\r\nConnection: close\r\n\r\n"));
+  EXPECT_FALSE(keep_alive("GET / HTTP/1.1\r\nConnection: Close\r\n\r\n"));
+  EXPECT_FALSE(keep_alive("GET / HTTP/1.0\r\n\r\n"));
+  EXPECT_TRUE(keep_alive("GET / HTTP/1.0\r\nConnection: Keep-Alive\r\n\r\n"));
+  EXPECT_FALSE(keep_alive("GET / HTTP/1.0\r\nConnection: close\r\n\r\n"));
+}
+
+TEST(HttpParseTest, header_names_ignore_case) {
+  // HTTP/2 网关与 curl 等常发小写的请求头名
+  IOBuf buf;
+  buf.append("GET /a.js HTTP/1.1\r\nhost: x\r\nconnection: close\r\naccept-encoding: gzip\r\n"
+             "if-none-match: \"abc\"\r\nrange: bytes=0-9\r\nif-range: \"abc\"\r\ncontent-length: 2\r\n\r\nok");
+  HttpRequest req;
+  ASSERT_EQ(req.parse(buf), ParseStatus::COMPLETE);
+  EXPECT_FALSE(req.keep_alive);
+  EXPECT_EQ(req.body, "ok");
+  EXPECT_TRUE(accepts_gzip(req));
+  EXPECT_TRUE(not_modified(req, "\"abc\"", absl::UnixEpoch()));
+  ByteRanges ranges;
+  EXPECT_EQ(request_range(req, "\"abc\"", absl::UnixEpoch(), 100, &ranges), RangeStatus::PARTIAL);
+  // 查找时同样不区分大小写，原始写法保留
+  EXPECT_EQ(req.headers.at("HOST"), "x");
+  EXPECT_EQ(req.headers.find(header::IfNoneMatch)->first, "if-none-match");
+  //
+  IOBuf mixed;
+  mixed.append("GET / HTTP/1.1\r\nTRANSFER-ENCODING: chunked\r\n\r\n");
+  HttpRequest chunked;
+  EXPECT_EQ(chunked.parse(mixed), ParseStatus::INVALID);
+}
@@ -0,0 +1,96 @@
+#include <future>
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#include "utils/iobuf.hpp"
+
+using namespace ling::utils;
+
+TEST(IOBufTest, append_cut_and_view) {
+  IOBuf buf;
+  // 模拟网络读：数据直接写入块中，再以引用的方式挂到 IOBuf 上
+  auto* block = IOBlock::acquire();
+  memcpy(block->data(), "GET / HTTP/1.1\r\n", 16);
+  buf.append(block, 0, 16);
+  memcpy(block->data() + 16, "Host: a\r\n\r\n", 11);
+  buf.append(block, 16, 11);
+  block->unref();
+  EXPECT_EQ(buf.size(), 27);
+  EXPECT_EQ(buf.segments(), 1);
+  buf.append("body");
+  EXPECT_EQ(buf.segments(), 2);
+  //
+  IOBuf head;
+  buf.cut(27, &head);
+  EXPECT_EQ(head.view(), "GET / HTTP/1.1\r\nHost: a\r\n\r\n");
+  EXPECT_EQ(buf.view(), "body");
+  buf.pop_front(100);
+  EXPECT_TRUE(buf.empty());
+}
+
+TEST(IOBufTest, find_across_segments) {
+  IOBuf buf;
+  buf.append("GET / HTTP/1.1\r");
+  buf.append("\n");
+  buf.append("Host: a\r\n\r");
+  buf.append("\nrest");
+  EXPECT_EQ(buf.segments(), 4);
+  EXPECT_EQ(buf.find("\r\n"), 14);
+  EXPECT_EQ(buf.find("\r\n\r\n"), 23);
+  EXPECT_EQ(buf.find("\r\n\r\n", 0, 26), std::string::npos);
+  EXPECT_EQ(buf.find("\r\n", 15), 23);
+  EXPECT_EQ(buf.find("nope"), std::string::npos);
+  std::string head;
+  buf.copy_to(head, 9, 16);
+  EXPECT_EQ(head, "Host: a\r\n");
+}
+
+TEST(IOBufTest, view_merges_once) {
+  IOBuf buf;
+  const std::string big(IOBlock::DEFAULT_CAPACITY * 3 + 7, 'x');
+  buf.append(big);
+  EXPECT_EQ(buf.segments(), 4);
+  const auto v = buf.view();
+  EXPECT_EQ(buf.segments(), 1);
+  EXPECT_EQ(v, big);
+  // 再次获取视图不会拷贝
+  EXPECT_EQ(buf.view().data(), v.data());
+  IOBuf moved = std::move(buf);
+  EXPECT_TRUE(buf.empty());
+  EXPECT_EQ(moved.size(), big.size());
+}
+
+TEST(IOBufTest, shared_block_outlives_source) {
+  IOBuf body;
+  {
+    IOBuf buf;
+    buf.append("headerbody");
+    buf.pop_front(6);
+    buf.cut(4, &body);
+  }
+  EXPECT_EQ(body.view(), "body");
+}
+
+TEST(IOBufTest, block_returns_to_acquiring_thread) {
+  // 事件循环线程取块，请求处理线程释放，块应回到事件循环线程复用
+  std::thread loop([] {
+    auto* block = IOBlock::acquire();
+    std::promise<void> released;
+    std::promise<void> done;
+    // 释放线程在取回之前保持存活，块若留在它的空闲链表里就无法复用
+    std::thread worker([&, block] {
+      block->unref();
+      released.set_value();
+      done.get_future().wait();
+    });
+    released.get_future().wait();
+    auto* again = IOBlock::acquire();
+    EXPECT_EQ(again, block);
+    again->unref();
+    done.set_value();
+    worker.join();
+  });
+  loop.join();
+}
@@ -1,3 +1,6 @@
+#include <string>
+#include <vector>
+
 #include <gtest/gtest.h>
 #include "parser/markdown.h"
 
@@ -51,4 +54,41 @@ TEST(MarkdownTest, parse_html_element) {
   std::cout << "element cnt: " << md_ptr->elements().size() << std::endl;
   auto* html_element_ptr = reinterpret_cast<ling::HtmlElement*>(md_ptr->elements()[0].get());
   std::cout << html_element_ptr->to_html() << std::endl;
-}
\ No newline at end of file
+}
+
+// 越界的回归用例：以下输入曾因 lines.at() 越界抛出 out_of_range，或读取空行的 [0]
+TEST(MarkdownTest, truncated_input) {
+  const std::vector<std::string> inputs = {
+      "",
+      "\n\n",
+      "---",
+      "---\ntitle: unterminated",
+      "| a | b |",
+      "| a | b |\n",
+      "| a | b |\n| --- | --- |",
+      "| a | b |\n| --- | --- |\n| 1 | 2 |",
+      "- a\n  - b",
+      "- a\n  - b\n    - c",
+      "1. a\n   1. b",
+      "1. a\n   - b",
+  };
+  for (const auto& input : inputs) {
+    ling::Markdown md;
+    bool status = false;
+    EXPECT_NO_THROW(status = md.parse_str(input)) << input;
+    if (status) {
+      EXPECT_NO_THROW(md.to_html()) << input;
+    }
+  }
+  // 没有结束标记的元信息视为解析失败
+  ling::Markdown md;
+  EXPECT_FALSE(md.parse_str("---\ntitle: unterminated"));
+}
+
+// 块解析不能改写原始行，body_part() 需原样返回正文
+TEST(MarkdownTest, body_part_unchanged) {
+  const std::string body = "> quote 1\n> quote 2\n\n```cpp\nint a;\n```\n\n- a\n- b\n  - c\n\n1. x\n2. y";
+  ling::Markdown md;
+  ASSERT_TRUE(md.parse_str("---\ntitle: t\n---\n" + body));
+  EXPECT_EQ(md.body_part(), body);
+}
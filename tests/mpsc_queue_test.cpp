@@ -0,0 +1,69 @@
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "utils/mpsc_queue.hpp"
+
+using namespace ling::utils;
+
+TEST(MpscQueueTest, fifo_single_producer) {
+  MpscQueue<std::string> queue;
+  std::string item;
+  EXPECT_FALSE(queue.pop(item));
+  queue.push("a");
+  queue.push("b");
+  ASSERT_TRUE(queue.pop(item));
+  EXPECT_EQ(item, "a");
+  queue.push("c");
+  ASSERT_TRUE(queue.pop(item));
+  EXPECT_EQ(item, "b");
+  ASSERT_TRUE(queue.pop(item));
+  EXPECT_EQ(item, "c");
+  EXPECT_FALSE(queue.pop(item));
+}
+
+TEST(MpscQueueTest, concurrent_producers_keep_per_producer_order) {
+  constexpr int producers = 4;
+  constexpr int per_producer = 20000;
+  MpscQueue<std::pair<int, int>> queue;
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; p++) {
+    threads.emplace_back([&queue, p]() {
+      for (int idx = 0; idx < per_producer; idx++) {
+        queue.push({p, idx});
+      }
+    });
+  }
+  // 同一生产者的元素按 push 的顺序取出
+  std::vector<int> next(producers, 0);
+  int received = 0;
+  while (received < producers * per_producer) {
+    std::pair<int, int> item;
+    if (!queue.pop(item)) {
+      std::this_thread::yield();
+      continue;
+    }
+    ASSERT_EQ(item.second, next[item.first]);
+    next[item.first]++;
+    received++;
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  std::pair<int, int> item;
+  EXPECT_FALSE(queue.pop(item));
+}
+
+TEST(MpscQueueTest, destructor_releases_pending_items) {
+  auto shared = std::make_shared<int>(1);
+  {
+    MpscQueue<std::shared_ptr<int>> queue;
+    queue.push(shared);
+    queue.push(shared);
+    EXPECT_EQ(shared.use_count(), 3);
+  }
+  EXPECT_EQ(shared.use_count(), 1);
+}
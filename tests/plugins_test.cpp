@@ -0,0 +1,202 @@
+#include "plugin/plugins.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace ::ling;
+using namespace ::ling::plugin;
+
+namespace {
+
+class Recorder {
+public:
+  void record(const std::string& event) {
+    std::lock_guard<std::mutex> lock(mtx_);
+    events_.push_back(event);
+  }
+
+  std::vector<std::string> events() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return events_;
+  }
+
+private:
+  std::mutex mtx_;
+  std::vector<std::string> events_;
+};
+
+class FakePlugin final : public Plugin {
+public:
+  FakePlugin(std::string name, Recorder& recorder, const Resources consumes, const Resources produces)
+      : name_(std::move(name)), recorder_(recorder), consumes_(consumes), produces_(produces) {}
+
+  bool run(const MarkdownPtr& md_ptr) override {
+    recorder_.record(name_ + ":start");
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    recorder_.record(name_ + ":end");
+    return true;
+  }
+  Resources consumes() const override {
+    return consumes_;
+  }
+  Resources produces() const override {
+    return produces_;
+  }
+
+private:
+  std::string name_;
+  Recorder& recorder_;
+  Resources consumes_;
+  Resources produces_;
+};
+
+// 等待另一个插件也开始运行，只有两者并发执行时才会成功
+class RendezvousPlugin final : public Plugin {
+public:
+  RendezvousPlugin(std::atomic_uint32_t& arrived, const Resources consumes) : arrived_(arrived), consumes_(consumes) {}
+
+  bool run(const MarkdownPtr& md_ptr) override {
+    arrived_++;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (arrived_ < 2) {
+      if (std::chrono::steady_clock::now() > deadline) {
+        return false;
+      }
+      std::this_thread::yield();
+    }
+    return true;
+  }
+  Resources consumes() const override {
+    return consumes_;
+  }
+
+private:
+  std::atomic_uint32_t& arrived_;
+  Resources consumes_;
+};
+
+// 逐个处理条目，截止时间到达后放弃剩余条目并上报
+class BudgetAwarePlugin final : public Plugin {
+public:
+  BudgetAwarePlugin(const uint32_t items, const std::chrono::milliseconds cost, const Resources consumes = RES_NONE,
+                    const Resources produces = RES_NONE)
+      : items_(items), cost_(cost), consumes_(consumes), produces_(produces) {}
+
+  bool run(const MarkdownPtr& md_ptr) override {
+    for (uint32_t idx = 0; idx < items_; idx++) {
+      if (utils::Deadline::current().expired()) {
+        utils::report_timeout("item " + std::to_string(idx));
+        continue;
+      }
+      std::this_thread::sleep_for(cost_);
+      done_++;
+    }
+    return true;
+  }
+  Resources consumes() const override {
+    return consumes_;
+  }
+  Resources produces() const override {
+    return produces_;
+  }
+  uint32_t done() const {
+    return done_;
+  }
+
+private:
+  uint32_t items_;
+  std::chrono::milliseconds cost_;
+  Resources consumes_;
+  Resources produces_;
+  std::atomic_uint32_t done_ {0};
+};
+
+size_t index_of(const std::vector<std::string>& events, const std::string& event) {
+  return std::find(events.begin(), events.end(), event) - events.begin();
+}
+
+}  // namespace
+
+TEST(PluginsTest, producer_runs_before_consumer) {
+  Recorder recorder;
+  Plugins plugins;
+  // 配置顺序与依赖顺序相反
+  plugins.add("Uploader", std::make_shared<FakePlugin>("Uploader", recorder, RES_IMAGE, RES_IMAGE));
+  plugins.add("Diagram", std::make_shared<FakePlugin>("Diagram", recorder, RES_CODE_BLOCK, RES_IMAGE));
+  EXPECT_TRUE(plugins.build_graph());
+  EXPECT_TRUE(plugins.run(std::make_shared<Markdown>()));
+  const auto events = recorder.events();
+  ASSERT_EQ(events.size(), 4);
+  EXPECT_LT(index_of(events, "Diagram:end"), index_of(events, "Uploader:start"));
+}
+
+TEST(PluginsTest, independent_plugins_run_concurrently) {
+  std::atomic_uint32_t arrived{0};
+  Plugins plugins;
+  plugins.add("Diagram", std::make_shared<RendezvousPlugin>(arrived, RES_CODE_BLOCK));
+  plugins.add("Math", std::make_shared<RendezvousPlugin>(arrived, RES_LATEX));
+  EXPECT_TRUE(plugins.build_graph());
+  EXPECT_TRUE(plugins.run(std::make_shared<Markdown>()));
+}
+
+TEST(PluginsTest, cycle_fallback_to_configured_order) {
+  Recorder recorder;
+  Plugins plugins;
+  plugins.add("A", std::make_shared<FakePlugin>("A", recorder, RES_HTML, RES_IMAGE));
+  plugins.add("B", std::make_shared<FakePlugin>("B", recorder, RES_IMAGE, RES_LATEX));
+  plugins.add("C", std::make_shared<FakePlugin>("C", recorder, RES_LATEX, RES_HTML));
+  EXPECT_FALSE(plugins.add("A", std::make_shared<FakePlugin>("A", recorder, RES_NONE, RES_NONE)));
+  EXPECT_FALSE(plugins.build_graph());
+  EXPECT_TRUE(plugins.run(std::make_shared<Markdown>()));
+  const std::vector<std::string> expected = {"A:start", "A:end", "B:start", "B:end", "C:start", "C:end"};
+  EXPECT_EQ(recorder.events(), expected);
+}
+
+TEST(PluginsTest, plugin_budget_bounds_each_plugin) {
+  utils::TimeoutReport::singleton().take();
+  Plugins plugins;
+  auto slow = std::make_shared<BudgetAwarePlugin>(10, std::chrono::milliseconds(30));
+  auto fast = std::make_shared<BudgetAwarePlugin>(2, std::chrono::milliseconds(1));
+  plugins.add("Slow", slow);
+  plugins.add("Fast", fast);
+  Plugins::Budget budget;
+  budget.per_plugin = std::chrono::milliseconds(10000);
+  budget.overrides["Slow"] = std::chrono::milliseconds(100);
+  plugins.set_budget(budget);
+  EXPECT_TRUE(plugins.build_graph());
+  const auto start = std::chrono::steady_clock::now();
+  EXPECT_TRUE(plugins.run(std::make_shared<Markdown>()));
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(250));
+  EXPECT_LT(slow->done(), 10);
+  EXPECT_EQ(fast->done(), 2);
+  const auto timed_out = utils::TimeoutReport::singleton().take();
+  EXPECT_EQ(timed_out.size(), 10 - slow->done());
+  for (const auto& [owner, item] : timed_out) {
+    EXPECT_EQ(owner.substr(0, 5), "Slow@");
+  }
+}
+
+TEST(PluginsTest, document_budget_skips_remaining_plugins) {
+  utils::TimeoutReport::singleton().take();
+  Plugins plugins;
+  // 存在依赖关系，Second 在 First 之后执行
+  auto first = std::make_shared<BudgetAwarePlugin>(5, std::chrono::milliseconds(30), RES_CODE_BLOCK, RES_IMAGE);
+  auto second = std::make_shared<BudgetAwarePlugin>(1, std::chrono::milliseconds(1), RES_IMAGE, RES_IMAGE);
+  plugins.add("First", first);
+  plugins.add("Second", second);
+  EXPECT_TRUE(plugins.build_graph());
+  Plugins::Budget budget;
+  budget.per_document = std::chrono::milliseconds(50);
+  plugins.set_budget(budget);
+  EXPECT_TRUE(plugins.run(std::make_shared<Markdown>()));
+  EXPECT_EQ(second->done(), 0);
+  const auto timed_out = utils::TimeoutReport::singleton().take();
+  ASSERT_FALSE(timed_out.empty());
+  EXPECT_EQ(timed_out.back().first.substr(0, 7), "Second@");
+}
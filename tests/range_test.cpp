@@ -0,0 +1,139 @@
+#include <memory>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "service/http/protocol.hpp"
+
+using namespace ling::http;
+
+namespace {
+
+// 生成响应头，并依次拼上各段引用的内存
+std::string render(HttpResponse& resp) {
+  char* buf = nullptr;
+  size_t size = 0;
+  resp.generate(&buf, &size);
+  std::string out(buf, size);
+  free(buf);
+  for (const auto& ref : resp.body_refs()) {
+    out.append(*ref.memory, ref.offset, ref.length);
+  }
+  return out;
+}
+
+}  // namespace
+
+TEST(RangeTest, parse_range) {
+  ByteRanges ranges;
+  EXPECT_EQ(parse_range("bytes=0-99", 1000, &ranges), RangeStatus::PARTIAL);
+  ASSERT_EQ(ranges.size(), 1);
+  EXPECT_EQ(ranges[0].offset, 0);
+  EXPECT_EQ(ranges[0].length, 100);
+  // 省略终点、最后 n 个字节、终点超出长度时截断
+  EXPECT_EQ(parse_range("bytes=900-", 1000, &ranges), RangeStatus::PARTIAL);
+  EXPECT_EQ(ranges[0].offset, 900);
+  EXPECT_EQ(ranges[0].length, 100);
+  EXPECT_EQ(parse_range("bytes=-50", 1000, &ranges), RangeStatus::PARTIAL);
+  EXPECT_EQ(ranges[0].offset, 950);
+  EXPECT_EQ(ranges[0].length, 50);
+  EXPECT_EQ(parse_range("bytes=-5000", 1000, &ranges), RangeStatus::PARTIAL);
+  EXPECT_EQ(ranges[0].offset, 0);
+  EXPECT_EQ(ranges[0].length, 1000);
+  EXPECT_EQ(parse_range("bytes=990-2000", 1000, &ranges), RangeStatus::PARTIAL);
+  EXPECT_EQ(ranges[0].length, 10);
+  // 多段按起点排序，重叠或相邻的合并，超出长度的段丢弃
+  EXPECT_EQ(parse_range("bytes=500-599, 0-9, 5-19, 20-29, 2000-", 1000, &ranges), RangeStatus::PARTIAL);
+  ASSERT_EQ(ranges.size(), 2);
+  EXPECT_EQ(ranges[0].offset, 0);
+  EXPECT_EQ(ranges[0].length, 30);
+  EXPECT_EQ(ranges[1].offset, 500);
+  EXPECT_EQ(ranges[1].length, 100);
+  // 都超出长度时为 416
+  EXPECT_EQ(parse_range("bytes=1000-", 1000, &ranges), RangeStatus::UNSATISFIABLE);
+  EXPECT_EQ(parse_range("bytes=-0", 1000, &ranges), RangeStatus::UNSATISFIABLE);
+  EXPECT_EQ(parse_range("bytes=0-", 0, &ranges), RangeStatus::UNSATISFIABLE);
+  // 格式不对的整个忽略
+  EXPECT_EQ(parse_range("items=0-9", 1000, &ranges), RangeStatus::WHOLE);
+  EXPECT_EQ(parse_range("bytes=9-0", 1000, &ranges), RangeStatus::WHOLE);
+  EXPECT_EQ(parse_range("bytes=0-9,x", 1000, &ranges), RangeStatus::WHOLE);
+  EXPECT_EQ(parse_range("bytes=-", 1000, &ranges), RangeStatus::WHOLE);
+  EXPECT_EQ(parse_range("bytes=+1-2", 1000, &ranges), RangeStatus::WHOLE);
+  EXPECT_TRUE(ranges.empty());
+  std::string many = "bytes=0-0";
+  for (size_t idx = 1; idx <= RANGE_MAX_COUNT; idx++) {
+    many += "," + std::to_string(idx * 2) + "-" + std::to_string(idx * 2);
+  }
+  EXPECT_EQ(parse_range(many, 1000, &ranges), RangeStatus::WHOLE);
+}
+
+TEST(RangeTest, if_range) {
+  const std::string etag = "\"abc\"";
+  const absl::Time last_modified = absl::FromUnixSeconds(784111777) + absl::Milliseconds(300);
+  HttpRequest req;
+  req.action = "GET";
+  ByteRanges ranges;
+  EXPECT_EQ(request_range(req, etag, last_modified, 100, &ranges), RangeStatus::WHOLE);
+  req.headers[header::Range] = "bytes=0-9";
+  EXPECT_EQ(request_range(req, etag, last_modified, 100, &ranges), RangeStatus::PARTIAL);
+  // If-Range 中的 ETag 用强比较，日期须与修改时间一致
+  req.headers[header::IfRange] = etag;
+  EXPECT_EQ(request_range(req, etag, last_modified, 100, &ranges), RangeStatus::PARTIAL);
+  req.headers[header::IfRange] = "W/" + etag;
+  EXPECT_EQ(request_range(req, etag, last_modified, 100, &ranges), RangeStatus::WHOLE);
+  req.headers[header::IfRange] = "\"old\"";
+  EXPECT_EQ(request_range(req, etag, last_modified, 100, &ranges), RangeStatus::WHOLE);
+  req.headers[header::IfRange] = "Sun, 06 Nov 1994 08:49:37 GMT";
+  EXPECT_EQ(request_range(req, etag, last_modified, 100, &ranges), RangeStatus::PARTIAL);
+  req.headers[header::IfRange] = "Sun, 06 Nov 1994 08:49:36 GMT";
+  EXPECT_EQ(request_range(req, etag, last_modified, 100, &ranges), RangeStatus::WHOLE);
+  // 只有 GET 处理 Range
+  req.headers.erase(header::IfRange);
+  req.action = "POST";
+  EXPECT_EQ(request_range(req, etag, last_modified, 100, &ranges), RangeStatus::WHOLE);
+}
+
+TEST(RangeTest, partial_response) {
+  const auto content = std::make_shared<const std::string>("0123456789abcdefghij");
+  const auto append = [](HttpResponse& resp, const std::shared_ptr<const std::string>& memory) {
+    return [&resp, memory](const size_t offset, const size_t length) {
+      return resp.with_memory(memory, offset, length);
+    };
+  };
+  HttpResponse single;
+  single.with_header(header::ContentType, content_type::PLAIN);
+  ASSERT_TRUE(single.with_ranges({{10, 5}}, content->size(), append(single, content)));
+  auto out = render(single);
+  EXPECT_EQ(out.find("HTTP/1.1 206 Partial Content\r\n"), 0);
+  EXPECT_NE(out.find("Content-Range: bytes 10-14/20\r\n"), std::string::npos);
+  EXPECT_NE(out.find("Content-Type: text/plain\r\n"), std::string::npos);
+  EXPECT_NE(out.find("Content-Length: 5\r\n"), std::string::npos);
+  EXPECT_EQ(out.substr(out.size() - 5), "abcde");
+  //
+  HttpResponse multi;
+  multi.with_header(header::ContentType, content_type::PLAIN);
+  ASSERT_TRUE(multi.with_ranges({{0, 2}, {18, 2}}, content->size(), append(multi, content)));
+  // 分隔行与结尾共用一块内存，原内容按引用
+  ASSERT_EQ(multi.body_refs().size(), 5);
+  EXPECT_EQ(multi.body_refs()[1].memory, content);
+  EXPECT_EQ(multi.body_refs()[0].memory, multi.body_refs()[4].memory);
+  out = render(multi);
+  const auto type_pos = out.find("Content-Type: multipart/byteranges; boundary=");
+  ASSERT_NE(type_pos, std::string::npos);
+  const auto boundary_pos = type_pos + std::string("Content-Type: multipart/byteranges; boundary=").size();
+  const auto boundary = out.substr(boundary_pos, out.find("\r\n", boundary_pos) - boundary_pos);
+  const auto body = out.substr(out.find("\r\n\r\n") + 4);
+  EXPECT_EQ(body, "\r\n--" + boundary + "\r\nContent-Type: text/plain\r\nContent-Range: bytes 0-1/20\r\n\r\n01" +
+                  "\r\n--" + boundary + "\r\nContent-Type: text/plain\r\nContent-Range: bytes 18-19/20\r\n\r\nij" +
+                  "\r\n--" + boundary + "--\r\n");
+  EXPECT_NE(out.find("Content-Length: " + std::to_string(body.size()) + "\r\n"), std::string::npos);
+  //
+  HttpResponse unsatisfiable;
+  unsatisfiable.with_header(header::ContentType, content_type::PLAIN);
+  unsatisfiable.with_unsatisfiable_range(content->size());
+  out = render(unsatisfiable);
+  EXPECT_EQ(out.find("HTTP/1.1 416 Range Not Satisfiable\r\n"), 0);
+  EXPECT_NE(out.find("Content-Range: bytes */20\r\n"), std::string::npos);
+  EXPECT_EQ(out.find("Content-Type"), std::string::npos);
+  EXPECT_NE(out.find("Content-Length: 0\r\n"), std::string::npos);
+}
@@ -0,0 +1,100 @@
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "service/http/static_site.hpp"
+
+using namespace ling::http;
+
+namespace {
+
+void write_file(const std::filesystem::path& path, const std::string& content) {
+  std::ofstream(path, std::ios::binary | std::ios::trunc) << content;
+}
+
+}  // namespace
+
+TEST(StaticSiteTest, load_and_refresh) {
+  const auto dir = std::filesystem::temp_directory_path() / "static_site_test";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir / "css");
+  write_file(dir / "index.html", "<html></html>");
+  write_file(dir / "app.js", "console.log(1)");
+  write_file(dir / "app.js.gz", "gzipped");
+  write_file(dir / "css" / "main.css", "body{}");
+  std::string style;
+  for (int idx = 0; idx < 200; idx++) {
+    style += ".c" + std::to_string(idx) + " { color: red; }\n";
+  }
+  write_file(dir / "css" / "style.css", style);
+  write_file(dir / "big.bin", std::string(64 * 1024, 'x'));
+  //
+  auto& site = StaticSite::singleton();
+  ASSERT_TRUE(site.load(dir, 32 * 1024));
+  ASSERT_TRUE(site.enabled());
+  const auto index = site.find("/index.html");
+  ASSERT_NE(index, nullptr);
+  EXPECT_EQ(*index->body, "<html></html>");
+  EXPECT_EQ(index->gzip_body, nullptr);
+  EXPECT_NE(index->headers->find("Content-Type: text/html\r\n"), std::string::npos);
+  EXPECT_NE(index->headers->find("Accept-Ranges: bytes\r\n"), std::string::npos);
+  EXPECT_EQ(index->content_type, "text/html");
+  EXPECT_NE(index->headers->find("ETag: " + index->etag + "\r\n"), std::string::npos);
+  EXPECT_NE(index->headers->find("Last-Modified: " + ling::utils::format_http_date(index->last_modified) + "\r\n"),
+            std::string::npos);
+  // 预压缩版本与 .gz 文件本身共用内存
+  const auto js = site.find("/app.js");
+  ASSERT_NE(js, nullptr);
+  ASSERT_NE(js->gzip_body, nullptr);
+  EXPECT_EQ(js->gzip_body, site.find("/app.js.gz")->body);
+  EXPECT_NE(js->gzip_headers->find("Content-Encoding: gzip\r\n"), std::string::npos);
+  EXPECT_NE(js->gzip_headers->find("ETag: " + js->gzip_etag + "\r\n"), std::string::npos);
+  EXPECT_NE(js->gzip_etag, js->etag);
+  EXPECT_NE(js->headers->find("Vary: Accept-Encoding\r\n"), std::string::npos);
+  ASSERT_NE(site.find("/css/main.css"), nullptr);
+  // 小文件不压缩，没有 .gz 文件的大文本文件加载时压缩
+  EXPECT_EQ(site.find("/css/main.css")->gzip_body, nullptr);
+  const auto css = site.find("/css/style.css");
+  ASSERT_NE(css, nullptr);
+  ASSERT_NE(css->gzip_body, nullptr);
+  std::string decompressed;
+  ASSERT_TRUE(ling::utils::gzip_decompress(*css->gzip_body, &decompressed));
+  EXPECT_EQ(decompressed, style);
+  ASSERT_NE(site.find("/big.bin"), nullptr);
+  EXPECT_TRUE(site.find("/big.bin")->on_disk);
+  EXPECT_EQ(site.find("/missing.html"), nullptr);
+  EXPECT_EQ(site.find("/css"), nullptr);
+  // 没有变化时不重新加载；重新构建后替换整张表，旧的条目仍可用
+  EXPECT_FALSE(site.refresh());
+  write_file(dir / "index.html", "<html>v2</html>");
+  write_file(dir / "new.html", "new");
+  EXPECT_TRUE(site.refresh());
+  EXPECT_EQ(*site.find("/index.html")->body, "<html>v2</html>");
+  EXPECT_NE(site.find("/index.html")->etag, index->etag);
+  EXPECT_NE(site.find("/new.html"), nullptr);
+  EXPECT_EQ(*index->body, "<html></html>");
+  std::filesystem::remove_all(dir);
+}
+
+TEST(StaticSiteTest, conditional_request) {
+  const std::string etag = strong_etag(ling::utils::sha256_hex("hello"));
+  const absl::Time last_modified = absl::FromUnixSeconds(784111777) + absl::Milliseconds(300);
+  HttpRequest req;
+  EXPECT_FALSE(not_modified(req, etag, last_modified));
+  req.headers[header::IfNoneMatch] = "\"other\", W/" + etag;
+  EXPECT_TRUE(not_modified(req, etag, last_modified));
+  req.headers[header::IfNoneMatch] = "*";
+  EXPECT_TRUE(not_modified(req, etag, last_modified));
+  // If-None-Match 不匹配时不再看 If-Modified-Since
+  req.headers[header::IfNoneMatch] = "\"other\"";
+  req.headers[header::IfModifiedSince] = "Sun, 06 Nov 1994 08:49:37 GMT";
+  EXPECT_FALSE(not_modified(req, etag, last_modified));
+  req.headers.erase(header::IfNoneMatch);
+  EXPECT_TRUE(not_modified(req, etag, last_modified));
+  req.headers[header::IfModifiedSince] = "Sun, 06 Nov 1994 08:49:36 GMT";
+  EXPECT_FALSE(not_modified(req, etag, last_modified));
+  req.headers[header::IfModifiedSince] = "yesterday";
+  EXPECT_FALSE(not_modified(req, etag, last_modified));
+}
@@ -29,4 +29,14 @@ TEST(TimeTest, test_file_time) {
   EXPECT_EQ(ling::utils::convert(last_write_time), ling::utils::format2date(absl::Now()));
   //
   std::filesystem::remove(temp_file);
-}
\ No newline at end of file
+}
+
+TEST(TimeTest, http_date) {
+  const absl::Time tp = absl::FromUnixSeconds(784111777);
+  EXPECT_EQ(ling::utils::format_http_date(tp), "Sun, 06 Nov 1994 08:49:37 GMT");
+  absl::Time parsed;
+  ASSERT_TRUE(ling::utils::parse_http_date("Sun, 06 Nov 1994 08:49:37 GMT", &parsed));
+  EXPECT_EQ(parsed, tp);
+  EXPECT_FALSE(ling::utils::parse_http_date("Sunday, 06-Nov-94 08:49:37 GMT", &parsed));
+  EXPECT_FALSE(ling::utils::parse_http_date("", &parsed));
+}
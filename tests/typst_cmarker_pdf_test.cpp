@@ -0,0 +1,42 @@
+#include <filesystem>
+#include <memory>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "plugin/typst_cmarker_pdf.hpp"
+#include "utils/strings.hpp"
+
+using namespace ling::plugin;
+
+TEST(TypstCmarkerPdfTest, reset_workspace) {
+  const auto workspace = std::filesystem::temp_directory_path() / "typst_workspace_test" / "post-1";
+  std::filesystem::remove_all(workspace.parent_path());
+  // 上一次被中断的构建留下的工作目录
+  std::filesystem::create_directories(workspace);
+  ASSERT_TRUE(ling::utils::write_file(workspace / "tmp_post.md", "stale post"));
+  ASSERT_TRUE(ling::utils::write_file(workspace / "post-1.pdf", "stale pdf"));
+  //
+  ASSERT_TRUE(reset_workspace(workspace, {{"md2pdf.typ", "wrapper"}, {"tmp_post.md", "new post"}}));
+  EXPECT_EQ(ling::utils::read_file_all(workspace / "md2pdf.typ"), "wrapper");
+  EXPECT_EQ(ling::utils::read_file_all(workspace / "tmp_post.md"), "new post");
+  EXPECT_FALSE(std::filesystem::exists(workspace / "post-1.pdf"));
+  // 再次准备同一篇文章
+  ASSERT_TRUE(reset_workspace(workspace, {{"tmp_post.md", "newer post"}}));
+  EXPECT_EQ(ling::utils::read_file_all(workspace / "tmp_post.md"), "newer post");
+  std::filesystem::remove_all(workspace.parent_path());
+}
+
+TEST(TypstCmarkerPdfTest, skip_post_without_id) {
+  // 没有 id 的文章若以 id 命名工作目录，会是 tmp_typst_build 本身，清理时会删掉其他任务的目录
+  const std::filesystem::path other_job = "tmp_typst_build/job-0";
+  std::filesystem::create_directories(other_job);
+  ASSERT_TRUE(ling::utils::write_file(other_job / "tmp_post.md", "other post"));
+  const auto md_ptr = std::make_shared<ling::Markdown>();
+  ASSERT_TRUE(md_ptr->parse_str("# no id\n\nbody\n"));
+  ASSERT_TRUE(md_ptr->metadata().id.empty());
+  TypstCmarkerPdf plugin;
+  EXPECT_TRUE(plugin.run(md_ptr));
+  EXPECT_EQ(ling::utils::read_file_all(other_job / "tmp_post.md"), "other post");
+  std::filesystem::remove_all(other_job.parent_path());
+}
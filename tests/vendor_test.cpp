@@ -0,0 +1,31 @@
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "plugin/vendor.hpp"
+
+using namespace ling::plugin;
+
+TEST(VendorTest, extract_urls) {
+  const std::string snippet =
+      R"(<link rel="stylesheet" href="https://unpkg.com/gitalk/dist/gitalk.css">)"
+      R"(<script src="https://cdn.jsdelivr.net/npm/katex@0.16.9/dist/katex.min.js" crossorigin="anonymous"></script>)"
+      R"(<style>@import url("https://fontsapi.zeoseven.com/1/main/result.css");</style>)"
+      R"(<a href="https://github.com/">github</a><script src="/static/app.js"></script>)";
+  const std::vector<std::string> expected = {"https://cdn.jsdelivr.net/npm/katex@0.16.9/dist/katex.min.js",
+                                             "https://unpkg.com/gitalk/dist/gitalk.css",
+                                             "https://fontsapi.zeoseven.com/1/main/result.css"};
+  EXPECT_EQ(Vendor::extract_urls(snippet), expected);
+}
+
+TEST(VendorTest, resolve_url) {
+  const std::string base = "https://cdn.jsdelivr.net/npm/katex@0.16.9/dist/katex.min.css?v=1";
+  EXPECT_EQ(Vendor::resolve_url(base, "fonts/KaTeX_Main-Regular.woff2"),
+            "https://cdn.jsdelivr.net/npm/katex@0.16.9/dist/fonts/KaTeX_Main-Regular.woff2");
+  EXPECT_EQ(Vendor::resolve_url(base, "../LICENSE"), "https://cdn.jsdelivr.net/npm/katex@0.16.9/LICENSE");
+  EXPECT_EQ(Vendor::resolve_url(base, "./a.woff"), "https://cdn.jsdelivr.net/npm/katex@0.16.9/dist/a.woff");
+  EXPECT_EQ(Vendor::resolve_url(base, "/x.woff"), "https://cdn.jsdelivr.net/x.woff");
+  EXPECT_EQ(Vendor::resolve_url(base, "//fonts.example.com/y.woff"), "https://fonts.example.com/y.woff");
+  EXPECT_EQ(Vendor::resolve_url(base, "http://a.com/z.ttf"), "http://a.com/z.ttf");
+}